@@ -6,6 +6,8 @@
 #include <cassert>
 #include <unordered_map>
 
+struct view_frustum; // collision_detection.h
+
 class actor
 {
 public:
@@ -21,6 +23,12 @@ public:
 	const DirectX::XMFLOAT4& rotation() const { return _rotation; };
 	const DirectX::XMFLOAT4X4& transform() const { return _composed_transform; };
 	const DirectX::XMFLOAT4& scale() const { return _scale; };
+
+	// UNIT.99 Aj[V̍XV(V[PT[i߁Apƃ{[s)B
+	// main_scenejob_system̃[J[XbhSAN^[ɌĂԂ̂ŁAȊȌԂȂ
+	virtual void animate(float delta_time) {}
+	// UNIT.99 Aj[VLODIԁBmain_sceneanimate̒Oɓ[J[XbhĂ
+	virtual void select_animation_lod(const DirectX::XMFLOAT4& eye_position, const view_frustum& eye_view_frustum) {}
 protected:
 	DirectX::XMFLOAT4 _scale = { 1, 1, 1, 1 };
 	DirectX::XMFLOAT4 _position = { 0, 0, 0, 1 };
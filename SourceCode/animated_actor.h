@@ -0,0 +1,93 @@
+#pragma once
+
+// UNIT.99
+#include <memory>
+#include <initializer_list>
+#include <directxmath.h>
+
+#include "actor.h"
+#include "geometric_substance.h"
+#include "animation_graph.h"
+#include "collision_detection.h"
+
+// XLbṼfAj[VOtœAN^[(avatarAbossAbuddy)ɋʂ̕B
+// hNXanimation_transitionŃV[PT[i߁Aanimation_stateōĐXe[g(Nbv̈ʒu)Ԃ
+class animated_actor : public actor
+{
+public:
+	animated_actor(const char* name) : actor(name) {}
+
+	void animate(float delta_time) override
+	{
+		animation_transition(delta_time);
+		// V[PT[I񂾃NbṽXe[gփNXtF[hAOt̎Ԃ͖t[i߂(Ԃi߂邾Ȃ̂ň)
+		_animation_graph.transition(animation_state(), _cross_fade_duration);
+		_animation_graph.update(model->compressed_animation_clips, delta_time);
+		_pose_outdated = true;
+		// p̓{[s]t[(Aj[VLODupdate_intervalt[1)AʊOȂȂB
+		// ʊỎe͍Ōɍp̂܂ܕ`BWCg₢킹Ƃ́A̎_̃Ot̎Ԃō
+		if (_skinning_palette.visible)
+		{
+			if (_skinning_palette.evaluation_due())
+			{
+				evaluate_pose();
+			}
+			else
+			{
+				++_skinning_palette.frame_index; // p͓łAO2̕]̕Ԃ̓t[Ƃɐi
+			}
+		}
+		model->update_skinning_palette(keyframe(), _skinning_palette);
+	}
+	void select_animation_lod(const DirectX::XMFLOAT4& eye_position, const view_frustum& eye_view_frustum) override
+	{
+		DirectX::XMFLOAT3 bounding_box[2];
+		model->transform_bounding_box(transform(), bounding_box);
+		model->select_animation_lod(transform(), eye_position, !intersect_frustum_aabb(eye_view_frustum, bounding_box), _skinning_palette);
+	}
+	virtual void animation_transition(float delta_time) = 0;
+
+	const animation::keyframe* keyframe() const
+	{
+		// L[t[͎g킸Ap͏ɃOt(build_animation_graphňxĂ)
+		return _animation_graph.keyframe();
+	}
+
+protected:
+	std::shared_ptr<geometric_substance> model;
+	// eA{`Akp[eBN̊epXœ{[sg
+	geometric_substance::skinning_palette _skinning_palette;
+	// Nbv̏ɃNbv1̃Xe[g
+	animation_graph _animation_graph;
+	float _cross_fade_duration = 0.15f;
+
+	virtual size_t animation_state() const = 0;
+	// modelǂݍ񂾌ɌĂԁBNbv̏ɃXe[g([v̓V[PT[[vNbvƑ)A
+	// ŏanimatȇOɕ`悳Ă悢悤A擪̎pĂ
+	template<class T>
+	void build_animation_graph(std::initializer_list<T> looping_clips)
+	{
+		_animation_graph.add_clip_states(model->compressed_animation_clips.size(), looping_clips);
+		evaluate_pose();
+	}
+	// WCg̖₢킹pBanimateŎpȂƂ͍̎ԂōĂԂ
+	const animation::keyframe* posed_keyframe()
+	{
+		if (_pose_outdated)
+		{
+			evaluate_pose();
+		}
+		return keyframe();
+	}
+
+private:
+	bool _pose_outdated = false; // ŌɎpŃOt̎Ԃi߂
+	// Ot̍̎ԂŎpBpςƂframe_indexi߂̂ŁAʊOŎpȂԂ
+	// cast_shadow{[s蒼Ȃ
+	void evaluate_pose()
+	{
+		_animation_graph.evaluate(model->compressed_animation_clips, *model);
+		_pose_outdated = false;
+		++_skinning_palette.frame_index;
+	}
+};
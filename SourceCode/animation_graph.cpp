@@ -0,0 +1,226 @@
+#include "misc.h"
+#include "animation_graph.h"
+
+#include <algorithm>
+#include <cmath>
+
+// animation_sequencerƓAkeyframe_count / sampling_ratebŏI[([vȂ擪ɖ߂)Ƃ
+template<class C>
+inline float clip_length(const C& animation_clip)
+{
+	return animation_clip.sampling_rate > 0 ? keyframe_count(animation_clip) / animation_clip.sampling_rate : 0.0f;
+}
+
+size_t animation_graph::add_clip(size_t clip_index, bool loop, float speed)
+{
+	node clip;
+	clip.clip_index = clip_index;
+	clip.loop = loop;
+	clip.speed = speed;
+	_nodes.push_back(clip);
+	return _nodes.size() - 1;
+}
+size_t animation_graph::add_blend(const std::vector<size_t>& children)
+{
+	_ASSERT_EXPR(children.size() > 0, L"A blend node needs at least one child.");
+	node blend;
+	blend.children = children;
+	blend.weights.assign(children.size(), 0.0f);
+	blend.weights.at(0) = 1.0f;
+	// 擪̎q͏o͂ɒڍA2Ԗڈȍ~̎q1Ԃ̎pɍĂo͂ɍ
+	for (size_t child_slot = 0; child_slot < children.size(); ++child_slot)
+	{
+		_ASSERT_EXPR(children.at(child_slot) < _nodes.size(), L"Children must be added before their parent.");
+		blend.required_pose_count = std::max(blend.required_pose_count, _nodes.at(children.at(child_slot)).required_pose_count + (child_slot > 0 ? 1 : 0));
+	}
+	_nodes.push_back(blend);
+	return _nodes.size() - 1;
+}
+void animation_graph::set_weight(size_t blend_node_index, size_t child_slot, float weight)
+{
+	_nodes.at(blend_node_index).weights.at(child_slot) = std::max(weight, 0.0f);
+}
+size_t animation_graph::add_state(size_t root_node_index)
+{
+	_states.push_back(root_node_index);
+	// ڂ茳̃Xe[g͒Ԃ̎p1gč̂ŁA̐ŗv镪𑫂v[ɗpӂ
+	const size_t pose_count{ FIRST_FREE_POSE + 1 + _nodes.at(root_node_index).required_pose_count };
+	if (_pose_pool.size() < pose_count)
+	{
+		_pose_pool.resize(pose_count);
+	}
+	return _states.size() - 1;
+}
+
+void animation_graph::restart(size_t node_index)
+{
+	node& node{ _nodes.at(node_index) };
+	node.time = 0.0f;
+	for (size_t child_index : node.children)
+	{
+		restart(child_index);
+	}
+}
+void animation_graph::transition(size_t state_index, float fade_duration)
+{
+	_ASSERT_EXPR(state_index < _states.size(), L"'state_index' is out of range.");
+	if (state_index == _state)
+	{
+		return;
+	}
+	if (_evaluated && fade_duration > 0.0f)
+	{
+		if (fading())
+		{
+			// ڂ茳ƈڂ̗葱ƒiĂ̂ŁA̎p~߂Ĉڂ茳ɂ
+			_pose_pool.at(SNAPSHOT_POSE) = _pose_pool.at(OUTPUT_POSE);
+			_source_is_snapshot = true;
+		}
+		else
+		{
+			_source_state = _state;
+			_source_is_snapshot = false;
+		}
+		_fade_time = 0.0f;
+		_fade_duration = fade_duration;
+	}
+	else
+	{
+		_fade_time = _fade_duration = 0.0f;
+	}
+	_state = state_index;
+	restart(_states.at(_state));
+}
+
+template<class C>
+bool animation_graph::update_node(const std::vector<C>& animation_clips, size_t node_index, float delta_time)
+{
+	node& node{ _nodes.at(node_index) };
+	if (node.children.empty())
+	{
+		const float length{ clip_length(animation_clips.at(node.clip_index)) };
+		if (node.updated_count != _update_count)
+		{
+			node.updated_count = _update_count;
+			node.time += delta_time * node.speed;
+			if (node.loop && length > 0.0f)
+			{
+				node.time = std::fmod(node.time, length);
+			}
+			else
+			{
+				node.time = std::min(node.time, length);
+			}
+		}
+		return !node.loop && node.time >= length;
+	}
+	bool has_ended{ true };
+	for (size_t child_slot = 0; child_slot < node.children.size(); ++child_slot)
+	{
+		// d݂̂ȂqԂ͐i߁Ad݂tƂɈʑȂ悤ɂ
+		const bool child_has_ended{ update_node(animation_clips, node.children.at(child_slot), delta_time) };
+		if (node.weights.at(child_slot) > 0.0f)
+		{
+			has_ended = has_ended && child_has_ended;
+		}
+	}
+	return has_ended;
+}
+template<class C>
+bool animation_graph::update_clips(const std::vector<C>& animation_clips, float delta_time)
+{
+	if (_states.empty())
+	{
+		return false;
+	}
+	++_update_count;
+	if (fading())
+	{
+		_fade_time += delta_time;
+		if (!_source_is_snapshot)
+		{
+			update_node(animation_clips, _states.at(_source_state), delta_time);
+		}
+	}
+	return update_node(animation_clips, _states.at(_state), delta_time);
+}
+bool animation_graph::update(const std::vector<animation>& animation_clips, float delta_time)
+{
+	return update_clips(animation_clips, delta_time);
+}
+bool animation_graph::update(const std::vector<compressed_animation>& animation_clips, float delta_time)
+{
+	return update_clips(animation_clips, delta_time);
+}
+
+template<class C>
+void animation_graph::evaluate_node(const std::vector<C>& animation_clips, size_t node_index, pose_soa& pose, size_t free_pose_index)
+{
+	const node& node{ _nodes.at(node_index) };
+	if (node.children.empty())
+	{
+		animation_clips.at(node.clip_index).sample(node.time, _sample);
+		pose.assign(_sample);
+		return;
+	}
+	// d݂̂qA܂ł̏d݂̍vƂ̔1(N̉dς2̃uhŋ߂)
+	float total_weight{ 0.0f };
+	for (size_t child_slot = 0; child_slot < node.children.size(); ++child_slot)
+	{
+		const float weight{ node.weights.at(child_slot) };
+		if (weight <= 0.0f)
+		{
+			continue;
+		}
+		if (total_weight == 0.0f)
+		{
+			evaluate_node(animation_clips, node.children.at(child_slot), pose, free_pose_index);
+		}
+		else
+		{
+			pose_soa& child_pose{ _pose_pool.at(free_pose_index) };
+			evaluate_node(animation_clips, node.children.at(child_slot), child_pose, free_pose_index + 1);
+			const pose_soa* poses[2]{ &pose, &child_pose };
+			geometric_substance::blend_animations(poses, weight / (total_weight + weight), pose);
+		}
+		total_weight += weight;
+	}
+	if (total_weight == 0.0f)
+	{
+		evaluate_node(animation_clips, node.children.at(0), pose, free_pose_index);
+	}
+}
+template<class C>
+const animation::keyframe* animation_graph::evaluate_clips(const std::vector<C>& animation_clips, const geometric_substance& substance)
+{
+	if (_states.empty() || animation_clips.empty())
+	{
+		return nullptr;
+	}
+	pose_soa& pose{ _pose_pool.at(OUTPUT_POSE) };
+	evaluate_node(animation_clips, _states.at(_state), pose, FIRST_FREE_POSE);
+	if (fading())
+	{
+		const pose_soa* source_pose{ &_pose_pool.at(SNAPSHOT_POSE) };
+		if (!_source_is_snapshot)
+		{
+			pose_soa& state_pose{ _pose_pool.at(FIRST_FREE_POSE) };
+			evaluate_node(animation_clips, _states.at(_source_state), state_pose, FIRST_FREE_POSE + 1);
+			source_pose = &state_pose;
+		}
+		const pose_soa* poses[2]{ source_pose, &pose };
+		geometric_substance::blend_animations(poses, _fade_time / _fade_duration, pose);
+	}
+	substance.update_animation(pose);
+	pose.store(_keyframe);
+	_evaluated = true;
+	return &_keyframe;
+}
+const animation::keyframe* animation_graph::evaluate(const std::vector<animation>& animation_clips, const geometric_substance& substance)
+{
+	return evaluate_clips(animation_clips, substance);
+}
+const animation::keyframe* animation_graph::evaluate(const std::vector<compressed_animation>& animation_clips, const geometric_substance& substance)
+{
+	return evaluate_clips(animation_clips, substance);
+}
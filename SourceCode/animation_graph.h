@@ -0,0 +1,99 @@
+#pragma once
+
+// UNIT.99
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "geometric_substance.h"
+
+// NbvAÑuhAXe[gƎԂw肵NXtF[hȂyʂ̃Aj[VOtB
+// m[hadd_clipAadd_blendŎqɍ(q͐eOɕԂ̂ŏzȂ)Aadd_stateŃXe[g̍Ƃēo^B
+// Ԃ̎padd_statêƂɕKvȐpӂpose_soãv[̂ŁAŏevaluateŊep
+// m[h̑傫ɂ́Aid˂Otłt[̃mۂ͋NȂB
+class animation_graph
+{
+public:
+	// clip_index̃NbvĐm[hÄʒuԂ
+	size_t add_clip(size_t clip_index, bool loop, float speed = 1.0f);
+	// childrend݂ōm[hÄʒuԂBd݂̏l͐擪̎q1Ac肪0
+	size_t add_blend(const std::vector<size_t>& children);
+	// add_blendōm[hchild_slotԖڂ̎q̏d݁Bd݂̍vŊĎĝōv1łȂĂ悢
+	void set_weight(size_t blend_node_index, size_t child_slot, float weight);
+	// root_node_indexƂXe[gÄʒuԂBŏɍXe[gĐn߂
+	size_t add_state(size_t root_node_index);
+	// clip_count̃Nbv1ĐXe[gNbv̏ɍ(Xe[g̈ʒu == Nbv̈ʒu)B
+	// looping_clipsɊ܂܂Nbv(Nbv̈ʒu\񋓒l)[v
+	template<class T>
+	void add_clip_states(size_t clip_count, std::initializer_list<T> looping_clips)
+	{
+		for (size_t clip_index = 0; clip_index < clip_count; ++clip_index)
+		{
+			const bool loop{ std::find(looping_clips.begin(), looping_clips.end(), static_cast<T>(clip_index)) != looping_clips.end() };
+			add_state(add_clip(clip_index, loop));
+		}
+	}
+
+	// state_index̃Xe[gfade_durationbĈڂB̃Xe[gƓȂ牽ȂB
+	// ڂ̃Nbv͐擪ĐBNXtF[h̓rŌĂ񂾏ꍇ́A̎_̎p~߂܂܈ڂ茳ɂ
+	void transition(size_t state_index, float fade_duration);
+	size_t state() const { return _state; }
+	bool fading() const { return _fade_time < _fade_duration; }
+
+	// ̃Xe[gƁANXtF[hȂڂ茳̃Xe[g̎Ԃi߂B
+	// ̃Xe[g̏d݂̂Nbvׂă[vȂNbvŁAI[ɒBĂtrueԂ(animation_sequencer::tictacƓ)
+	bool update(const std::vector<animation>& animation_clips, float delta_time);
+	bool update(const std::vector<compressed_animation>& animation_clips, float delta_time);
+	// păO[oϊ܂ŋ߁ArenderAcast_shadowAjointɓnL[t[ԂB
+	// ԂL[t[͂̃OtAevaluate܂ŗL
+	const animation::keyframe* evaluate(const std::vector<animation>& animation_clips, const geometric_substance& substance);
+	const animation::keyframe* evaluate(const std::vector<compressed_animation>& animation_clips, const geometric_substance& substance);
+	// ŌevaluatepB܂xĂłȂnullptr
+	const animation::keyframe* keyframe() const { return _evaluated ? &_keyframe : nullptr; }
+
+private:
+	struct node
+	{
+		// Nbṽm[h
+		size_t clip_index{ 0 };
+		bool loop{ false };
+		float speed{ 1.0f };
+		float time{ 0.0f };
+		uint64_t updated_count{ 0 }; // update2i߂Ȃ(̃Xe[gQƂm[h)
+		// uh̃m[h(childrenȂNbṽm[h)
+		std::vector<size_t> children;
+		std::vector<float> weights;
+		// ̃m[h]̂ɏo͂̑ɗvv[̎p̐
+		size_t required_pose_count{ 0 };
+	};
+	std::vector<node> _nodes;
+	std::vector<size_t> _states; // Xe[gƂ̍̃m[h
+
+	size_t _state{ 0 };
+	size_t _source_state{ 0 }; // NXtF[ḧڂ茳B_source_is_snapshotȂgȂ
+	bool _source_is_snapshot{ false };
+	float _fade_time{ 0.0f };
+	float _fade_duration{ 0.0f };
+	uint64_t _update_count{ 0 };
+
+	// [0]:óA[1]:NXtF[h̓rŎ~߂pA[2]ȍ~:Ԃ̎p
+	static const size_t OUTPUT_POSE{ 0 };
+	static const size_t SNAPSHOT_POSE{ 1 };
+	static const size_t FIRST_FREE_POSE{ 2 };
+	std::vector<pose_soa> _pose_pool;
+	animation::keyframe _sample; // Nbvop(pose_soaɈڂO)
+	animation::keyframe _keyframe;
+	bool _evaluated{ false };
+
+	template<class C>
+	bool update_clips(const std::vector<C>& animation_clips, float delta_time);
+	template<class C>
+	bool update_node(const std::vector<C>& animation_clips, size_t node_index, float delta_time);
+	template<class C>
+	const animation::keyframe* evaluate_clips(const std::vector<C>& animation_clips, const geometric_substance& substance);
+	// node_index̎pposeɍBԂ̎pɂ_pose_poolfree_pose_indexԖڈȍ~g
+	template<class C>
+	void evaluate_node(const std::vector<C>& animation_clips, size_t node_index, pose_soa& pose, size_t free_pose_index);
+	void restart(size_t node_index);
+};
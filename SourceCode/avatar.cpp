@@ -12,11 +12,16 @@
 using namespace DirectX;
 class main_scene;
 
-avatar::avatar(const char* name, ID3D11Device* device, const DirectX::XMFLOAT4& initial_position) : actor(name)
+avatar::avatar(const char* name, ID3D11Device* device, const DirectX::XMFLOAT4& initial_position) : animated_actor(name)
 {
 
 	respawn(initial_position);
 	model = geometric_substance::_emplace(device, ".\\resources\\nico.fbx");
+	// UNIT.99 ił͖[2i̍(wA̐Ȃ)]Ȃ
+	model->mask_lod_bones([](const skeleton::bone&, size_t height) { return height >= 2; });
+	_root_joint = model->resolve_joint("NIC:full_body", "NIC:Root_M_BK");
+	_magic_wand_sphere_joint = model->resolve_joint("NIC:magic_wand", "NIC:wand2_BK");
+	build_animation_graph({ animation_clip::idle, animation_clip::run });
 	event::_bind("@thumb_state_l", [&](const arguments& args) {
 		using namespace DirectX;
 
@@ -193,6 +198,7 @@ void avatar::update(float delta_time)
 	_velocity.z = _linear_speed * _forward.z;
 	_velocity.y -= 9.8f * delta_time;
 
+	_previous_position = _position;
 	_position.x += _velocity.x * delta_time;
 	_position.y += _velocity.y * delta_time;
 	_position.z += _velocity.z * delta_time;
@@ -208,7 +214,8 @@ void avatar::audio_transition(float delta_time)
 {
 	if (_state == state::run)
 	{
-		if (_current_location == "collision_road_mtl")
+		static const int32_t collision_road_mtl{ string_table::intern("collision_road_mtl") };
+		if (_current_location == collision_road_mtl)
 		{
 			_audios[0]->play();
 			_audios[0]->volume(0.2f);
@@ -277,7 +284,7 @@ void avatar::animation_transition(float delta_time)
 		break;
 	}
 
-	if (animation_sequencer.tictac(model->animation_clips, delta_time))
+	if (animation_sequencer.tictac(model->compressed_animation_clips, delta_time))
 	{
 		// Aj[V̍ĐȈ
 		switch (animation_sequencer.clip())
@@ -332,54 +339,49 @@ void avatar::render(ID3D11DeviceContext* immediate_context, ID3D11PixelShader* r
 				shader_resources.material_data.emissive.w = 50.0f;
 			}
 			return 0;
-		});
+		}, &_skinning_palette);
 }
 
 void avatar::collide_with(const collision_mesh* collision_mesh, DirectX::XMFLOAT4X4 transform)
 {
-	XMFLOAT4 intersection;
-	std::string mesh;
-	std::string material;
-	
-	const float raycast_step_back = 1.0f;
 	const float raycast_step_up = 1.5f;
 	const float collision_radius = 0.5f;
 
-	XMFLOAT4 ray_direction = { _forward.x, 0.0f, _forward.z, 0.0f };
-	XMFLOAT4 ray_position = {
-		_position.x - raycast_step_back * ray_direction.x,
-		_position.y + raycast_step_up,
-		_position.z - raycast_step_back * ray_direction.z,
-		1.0f
-	};
+	// Öʒu猻݈ʒu܂ŋ𐅕ɑ|AǂɐڐGʒu܂ŉ߂
+	XMFLOAT4 sweep_position = { _previous_position.x, _position.y + raycast_step_up, _previous_position.z, 1.0f };
+	XMFLOAT4 sweep_displacement = { _position.x - _previous_position.x, 0.0f, _position.z - _previous_position.z, 0.0f };
 
-	if ((_velocity.x * _velocity.x + _velocity.z * _velocity.z > 0.0f) && collision_mesh->raycast(ray_position, ray_direction, transform, intersection, mesh, material, false))
+	::collision_mesh::sweep_hit wall;
+	if ((sweep_displacement.x * sweep_displacement.x + sweep_displacement.z * sweep_displacement.z > 0.0f) && collision_mesh->sweep_sphere(sweep_position, collision_radius, sweep_displacement, transform, wall))
 	{
-		float distance = sqrtf((_position.x - intersection.x) * (_position.x - intersection.x) + (_position.z - intersection.z) * (_position.z - intersection.z));
-		if (distance < collision_radius)
+		_position.x = sweep_position.x + wall.time * sweep_displacement.x;
+		_position.z = sweep_position.z + wall.time * sweep_displacement.z;
+		if (wall.time == 0.0f)
 		{
-			_position.x -= (collision_radius - distance) * ray_direction.x;
-			_position.z -= (collision_radius - distance) * ray_direction.z;
-
-			_velocity.x = 0;
-			_velocity.z = 0;
-			_state = state::idle;
-
+			// Oǂɂ߂荞łꍇ́Ȁɗ܂炸ǂ̖@̌ɉo
+			const float extra_space = 0.01f;
+			_position.x += wall.normal.x * extra_space;
+			_position.z += wall.normal.z * extra_space;
 		}
+
+		_velocity.x = 0;
+		_velocity.z = 0;
+		_state = state::idle;
 	}
 
 	const float raycast_lift_up = 1.75f;
-	if (collision_mesh->raycast({ _position.x, _position.y + raycast_lift_up, _position.z, 1 }, { 0, -1, 0, 0 }, transform, intersection, mesh, material))
+	::collision_mesh::raycast_hit ground;
+	if (collision_mesh->raycast({ _position.x, _position.y + raycast_lift_up, _position.z, 1 }, { 0, -1, 0, 0 }, transform, ground))
 	{
-		_current_location = material;
+		_current_location = ground.material_id;
 
 		//[x0傫 
-		if (intersection.y - _position.y > 0)
+		if (ground.closest_point.y - _position.y > 0)
 		{
 
-			_position.x = intersection.x;
-			_position.y = intersection.y;
-			_position.z = intersection.z;
+			_position.x = ground.closest_point.x;
+			_position.y = ground.closest_point.y;
+			_position.z = ground.closest_point.z;
 			_position.w = 1;
 
 			if (_velocity.y < 0)
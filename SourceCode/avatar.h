@@ -8,21 +8,21 @@
 #include "actor.h"
 #include "audio.h"
 
-#include "geometric_substance.h"
+#include "animated_actor.h"
 #include "collision_mesh.h"
 
-class avatar : public actor
+class avatar : public animated_actor
 {
 public:
 	avatar(const char* name, ID3D11Device* device, const DirectX::XMFLOAT4& initial_position);
 	~avatar() = default;
 	void update(float delta_time);
 	void render(ID3D11DeviceContext* immediate_context, ID3D11PixelShader* replacement_pixel_shader = NULL);
-	void cast_shadow(ID3D11DeviceContext* immediate_context)
+	void cast_shadow(ID3D11DeviceContext* immediate_context, UINT instance_count = 4)
 	{
-		model->cast_shadow(immediate_context, transform(), keyframe());
+		model->cast_shadow(immediate_context, transform(), keyframe(), nullptr, instance_count, &_skinning_palette);
 	}
-	void animation_transition(float delta_time);
+	void animation_transition(float delta_time) override;
 	void audio_transition(float delta_time);
 	void collide_with(const collision_mesh* collision_mesh, DirectX::XMFLOAT4X4 transform);
 
@@ -32,6 +32,7 @@ public:
 		_state = state::jump_fall;
 		_scale = { 1.0f, 1.0f, 1.0f, 1.0f };
 		_position = location;
+		_previous_position = location; // UNIT.99
 		_velocity = { 0.0f, 0.0f, 0.0f, 0.0f };
 		_rotation = { 0, DirectX::XMConvertToRadians(180.0f), 0, 1 };
 		_forward = { 0, 0, -1, 0 };
@@ -39,32 +40,26 @@ public:
 		_compose_transform();
 	}
 	
-	DirectX::XMFLOAT4 root_joint() const
+	DirectX::XMFLOAT4 root_joint()
 	{
-		return model->joint("NIC:full_body", "NIC:Root_M_BK", transform(), keyframe());
+		return model->joint(_root_joint, transform(), posed_keyframe());
 	}
 
-	DirectX::XMFLOAT4 magic_wand_sphere_joint() const
+	DirectX::XMFLOAT4 magic_wand_sphere_joint()
 	{
-		return model->joint("NIC:magic_wand", "NIC:wand2_BK", transform(), keyframe());
+		return model->joint(_magic_wand_sphere_joint, transform(), posed_keyframe());
 	}
 	enum class state { idle, run, run_stop, attack, jump_rise, jump_fall, landing, damaged, magic, death, respawn };
 	state tell_state() const { return _state; }
 
-	std::shared_ptr<geometric_substance> model;
-
-	const animation::keyframe* keyframe() const
-	{
-		return animation_sequencer.keyframe(model->animation_clips);
-	}
-
 
 	enum class animation_clip { idle, run, run_b, run_e, jump_fall, landing, jump_rise, attack, death };
 	animation_sequencer<animation_clip> animation_sequencer = { animation_clip::idle };
 
 	int heart_point() const { return _heart_point; }
 	bool invincible() const { return _invincible_time > 0; }
-	std::string current_location() const { return _current_location; }
+	// ̃}eAstring_tableŃC^[ID
+	int32_t current_location() const { return _current_location; }
 
 	const DirectX::XMFLOAT4& velocity() const { return _velocity; };
 
@@ -76,6 +71,7 @@ private:
 
 	DirectX::XMFLOAT4 _forward = { 0, 0, -1, 0 };
 	DirectX::XMFLOAT4 _velocity = { 0, 0, 0, 0 };
+	DirectX::XMFLOAT4 _previous_position = { 0, 0, 0, 1 }; // UNIT.99 OupdateœÖʒu(ǂ̑|̎n_)
 
 	float _max_linear_speed = 10;
 	float _max_turning_speed = 360; 
@@ -88,9 +84,12 @@ private:
 	int _heart_point = _max_heart_point;
 	
 	float _invincible_time = 0;
-	std::string _current_location;
+	int32_t _current_location = string_table::INVALID_ID;
 	std::shared_ptr<audio> _audios[8];
 
-public:
-	const std::string& current_location() { return _current_location; }
+	// UNIT.99 RXgN^ňxO狁߂
+	geometric_substance::joint_handle _root_joint;
+	geometric_substance::joint_handle _magic_wand_sphere_joint;
+	// UNIT.99 animation_clip̒l̂܂܃Xe[g̈ʒu
+	size_t animation_state() const override { return static_cast<size_t>(animation_sequencer.clip()); }
 };
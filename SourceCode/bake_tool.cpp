@@ -0,0 +1,151 @@
+// UNIT.99
+// geometric_substancẽLbV(.cereal/.substance)D3DȂŏĂR}hCc[B
+// bake_tool.vcxprojAVOID_CREATE_COM_OBJECTS`ărhB
+//
+// bake_tool [IvV] model.fbx [[IvV] model.fbx ...]
+//   --triangulate             Op`ɕēǂݍ
+//   --sampling-rate <rate>    Aj[ṼTvO[g(0:FBX̊l)
+//   --animation <file>        ǉ̃Aj[Vt@C(w)
+//   --compact                 vertex_format::compactŏĂ(UVHALF_TEXCOORD_LIMIT𒴂FBXcompact_float_texcoordɂȂ)
+//   --force                   LbVLłĂ
+// IvV͒FBXɂKpBšĂяoƓwŏĂȂƁAsɕsvƂĎ̂ĂB
+// FBXƂɕʃXbhœǂݍ(FbxManagerFBXƂɍ̂ŋLȂ)B
+#include "misc.h"
+#include "geometric_substance.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <vector>
+
+struct bake_job
+{
+	std::string fbx_filename;
+	std::vector<std::string> animation_filenames;
+	bool triangulate{ false };
+	float sampling_rate{ 0 };
+	geometric_substance::vertex_format vertex_format{ geometric_substance::vertex_format::standard };
+	bool force{ false };
+};
+
+struct bake_result
+{
+	bool baked{ false }; // falseȂLȃLbVAǂݍ񂾂
+	float seconds{ 0 };
+	size_t mesh_count{ 0 };
+	size_t animation_count{ 0 };
+	vertex_cache_statistics vertex_cache_statistics[2];
+};
+
+bake_result bake(const bake_job& job)
+{
+	std::filesystem::path cereal_filename(job.fbx_filename);
+	cereal_filename.replace_extension("cereal");
+	std::filesystem::path substance_filename(job.fbx_filename);
+	substance_filename.replace_extension("substance");
+	if (job.force)
+	{
+		std::error_code error_code;
+		std::filesystem::remove(cereal_filename, error_code);
+		std::filesystem::remove(substance_filename, error_code);
+	}
+	std::error_code error_code;
+	const std::filesystem::file_time_type last_write_time{ std::filesystem::last_write_time(substance_filename, error_code) };
+
+	bake_result result;
+	benchmark stopwatch;
+	stopwatch.begin();
+	geometric_substance substance(nullptr, job.fbx_filename.c_str(), job.animation_filenames, job.triangulate, job.sampling_rate, true/*avoid_create_com_objects*/, job.vertex_format, true/*require_vertex_format*/);
+	result.seconds = stopwatch.end();
+
+	// LbVLꍇ.substanceȂ
+	result.baked = !std::filesystem::exists(substance_filename) || std::filesystem::last_write_time(substance_filename, error_code) != last_write_time;
+	result.mesh_count = substance.meshes.size();
+	result.animation_count = substance.animation_clips.size();
+	result.vertex_cache_statistics[0] = substance.baked_vertex_cache_statistics[0];
+	result.vertex_cache_statistics[1] = substance.baked_vertex_cache_statistics[1];
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<bake_job> jobs;
+	bake_job job;
+	for (int arg_index = 1; arg_index < argc; ++arg_index)
+	{
+		const std::string arg{ argv[arg_index] };
+		if (arg == "--triangulate")
+		{
+			job.triangulate = true;
+		}
+		else if (arg == "--compact")
+		{
+			job.vertex_format = geometric_substance::vertex_format::compact;
+		}
+		else if (arg == "--force")
+		{
+			job.force = true;
+		}
+		else if ((arg == "--sampling-rate" || arg == "--animation") && arg_index + 1 < argc)
+		{
+			const char* value{ argv[++arg_index] };
+			if (arg == "--sampling-rate")
+			{
+				job.sampling_rate = static_cast<float>(atof(value));
+			}
+			else
+			{
+				job.animation_filenames.push_back(value);
+			}
+		}
+		else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0)
+		{
+			fprintf(stderr, "unknown option: %s\n", arg.c_str());
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			job.fbx_filename = arg;
+			jobs.push_back(job);
+			job = {};
+		}
+	}
+	if (jobs.empty())
+	{
+		fprintf(stderr, "usage: bake_tool [--triangulate] [--sampling-rate <rate>] [--animation <file>]... [--compact] [--force] model.fbx ...\n");
+		return EXIT_FAILURE;
+	}
+
+	int exit_code{ EXIT_SUCCESS };
+	for (const bake_job& job : jobs)
+	{
+		if (!std::filesystem::exists(job.fbx_filename))
+		{
+			fprintf(stderr, "%s: not found\n", job.fbx_filename.c_str());
+			exit_code = EXIT_FAILURE;
+		}
+	}
+	if (exit_code != EXIT_SUCCESS)
+	{
+		return exit_code;
+	}
+
+	benchmark stopwatch;
+	stopwatch.begin();
+	std::vector<std::future<bake_result>> futures;
+	for (const bake_job& job : jobs)
+	{
+		futures.emplace_back(std::async(std::launch::async, bake, std::cref(job)));
+	}
+	// ʂ̓R}hC̏ɏo͂
+	for (size_t job_index = 0; job_index < jobs.size(); ++job_index)
+	{
+		const bake_result result{ futures.at(job_index).get() };
+		printf("%s: %s in %.2fs, %zu meshes, %zu animations, ACMR %.3f->%.3f\n", jobs.at(job_index).fbx_filename.c_str(),
+			result.baked ? "baked" : "up to date", result.seconds, result.mesh_count, result.animation_count,
+			result.vertex_cache_statistics[0].acmr(), result.vertex_cache_statistics[1].acmr());
+	}
+	printf("%zu files in %.2fs\n", jobs.size(), stopwatch.end());
+	return exit_code;
+}
@@ -0,0 +1,183 @@
+#include "bounding_volume_hierarchy.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace DirectX;
+
+inline void grow(XMFLOAT3 bounding_box[2], const XMFLOAT3& point)
+{
+	bounding_box[0].x = std::min<float>(bounding_box[0].x, point.x);
+	bounding_box[0].y = std::min<float>(bounding_box[0].y, point.y);
+	bounding_box[0].z = std::min<float>(bounding_box[0].z, point.z);
+	bounding_box[1].x = std::max<float>(bounding_box[1].x, point.x);
+	bounding_box[1].y = std::max<float>(bounding_box[1].y, point.y);
+	bounding_box[1].z = std::max<float>(bounding_box[1].z, point.z);
+}
+inline float surface_area(const XMFLOAT3 bounding_box[2])
+{
+	const float dx{ bounding_box[1].x - bounding_box[0].x };
+	const float dy{ bounding_box[1].y - bounding_box[0].y };
+	const float dz{ bounding_box[1].z - bounding_box[0].z };
+	return dx < 0 ? 0 : 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+inline float component(const XMFLOAT3& v, int axis)
+{
+	return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+void bounding_volume_hierarchy::build(const XMFLOAT3* positions, const uint32_t* indices, size_t index_count)
+{
+	const uint32_t triangle_count{ static_cast<uint32_t>(index_count / 3) };
+
+	nodes.clear();
+	triangle_indices.resize(triangle_count);
+	std::iota(triangle_indices.begin(), triangle_indices.end(), 0);
+	if (triangle_count == 0)
+	{
+		return;
+	}
+
+	// Op`ƂAABBƏdSOvZĂ
+	std::vector<XMFLOAT3> centroids(triangle_count);
+	std::vector<XMFLOAT3> triangle_bounding_boxes(triangle_count * 2LL);
+	for (uint32_t triangle_index = 0; triangle_index < triangle_count; ++triangle_index)
+	{
+		XMFLOAT3* bounding_box{ &triangle_bounding_boxes.at(triangle_index * 2LL) };
+		bounding_box[0] = bounding_box[1] = positions[indices[triangle_index * 3]];
+		grow(bounding_box, positions[indices[triangle_index * 3 + 1]]);
+		grow(bounding_box, positions[indices[triangle_index * 3 + 2]]);
+		centroids.at(triangle_index) = {
+			(bounding_box[0].x + bounding_box[1].x) * 0.5f,
+			(bounding_box[0].y + bounding_box[1].y) * 0.5f,
+			(bounding_box[0].z + bounding_box[1].z) * 0.5f };
+	}
+
+	nodes.reserve(triangle_count * 2LL);
+	subdivide(centroids, triangle_bounding_boxes, 0, triangle_count, 0);
+	nodes.shrink_to_fit();
+}
+
+uint32_t bounding_volume_hierarchy::subdivide(const std::vector<XMFLOAT3>& centroids, const std::vector<XMFLOAT3>& triangle_bounding_boxes, uint32_t first, uint32_t count, uint32_t depth)
+{
+	const uint32_t node_index{ static_cast<uint32_t>(nodes.size()) };
+	nodes.emplace_back();
+
+	XMFLOAT3 bounding_box[2]{ { +FLT_MAX, +FLT_MAX, +FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	XMFLOAT3 centroid_bounding_box[2]{ { +FLT_MAX, +FLT_MAX, +FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const uint32_t triangle_index{ triangle_indices.at(i) };
+		grow(bounding_box, triangle_bounding_boxes.at(triangle_index * 2LL));
+		grow(bounding_box, triangle_bounding_boxes.at(triangle_index * 2LL + 1));
+		grow(centroid_bounding_box, centroids.at(triangle_index));
+	}
+	nodes.at(node_index).bounding_box[0] = bounding_box[0];
+	nodes.at(node_index).bounding_box[1] = bounding_box[1];
+
+	if (count <= MAX_LEAF_TRIANGLES || depth + 1 >= MAX_DEPTH)
+	{
+		nodes.at(node_index).offset = first;
+		nodes.at(node_index).triangle_count = count;
+		return node_index;
+	}
+
+	// rɂSAH]BRXg 1() + (q̕\ʐ / e̕\ʐ * q̎Op`)
+	struct bin
+	{
+		XMFLOAT3 bounding_box[2]{ { +FLT_MAX, +FLT_MAX, +FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+		uint32_t count{ 0 };
+	};
+	const float parent_area{ surface_area(bounding_box) };
+	float best_cost{ FLT_MAX };
+	int best_axis{ -1 };
+	uint32_t best_split{ 0 };
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float min{ component(centroid_bounding_box[0], axis) };
+		const float extent{ component(centroid_bounding_box[1], axis) - min };
+		if (extent <= 0.0f)
+		{
+			continue;
+		}
+		const float scale{ BIN_COUNT / extent };
+
+		bin bins[BIN_COUNT];
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			const uint32_t triangle_index{ triangle_indices.at(i) };
+			const uint32_t bin_index{ std::min<uint32_t>(BIN_COUNT - 1, static_cast<uint32_t>((component(centroids.at(triangle_index), axis) - min) * scale)) };
+			bins[bin_index].count++;
+			grow(bins[bin_index].bounding_box, triangle_bounding_boxes.at(triangle_index * 2LL));
+			grow(bins[bin_index].bounding_box, triangle_bounding_boxes.at(triangle_index * 2LL + 1));
+		}
+
+		// Eݐς\ʐςƎOp`
+		float left_areas[BIN_COUNT - 1]{};
+		uint32_t left_counts[BIN_COUNT - 1]{};
+		bin accumulation;
+		for (uint32_t i = 0; i < BIN_COUNT - 1; ++i)
+		{
+			if (bins[i].count > 0)
+			{
+				accumulation.count += bins[i].count;
+				grow(accumulation.bounding_box, bins[i].bounding_box[0]);
+				grow(accumulation.bounding_box, bins[i].bounding_box[1]);
+			}
+			left_areas[i] = surface_area(accumulation.bounding_box);
+			left_counts[i] = accumulation.count;
+		}
+		accumulation = {};
+		for (uint32_t i = BIN_COUNT - 1; i > 0; --i)
+		{
+			if (bins[i].count > 0)
+			{
+				accumulation.count += bins[i].count;
+				grow(accumulation.bounding_box, bins[i].bounding_box[0]);
+				grow(accumulation.bounding_box, bins[i].bounding_box[1]);
+			}
+
+			const uint32_t left_count{ left_counts[i - 1] };
+			if (left_count == 0 || accumulation.count == 0)
+			{
+				continue;
+			}
+			const float cost{ 1.0f + (left_areas[i - 1] * left_count + surface_area(accumulation.bounding_box) * accumulation.count) / parent_area };
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_split = i;
+			}
+		}
+	}
+
+	if (best_axis < 0)
+	{
+		// dSׂďdȂĂꍇ͕łȂ
+		nodes.at(node_index).offset = first;
+		nodes.at(node_index).triangle_count = count;
+		return node_index;
+	}
+
+	const float min{ component(centroid_bounding_box[0], best_axis) };
+	const float scale{ BIN_COUNT / (component(centroid_bounding_box[1], best_axis) - min) };
+	uint32_t middle{ static_cast<uint32_t>(std::partition(triangle_indices.begin() + first, triangle_indices.begin() + first + count, [&](uint32_t triangle_index) {
+		return std::min<uint32_t>(BIN_COUNT - 1, static_cast<uint32_t>((component(centroids.at(triangle_index), best_axis) - min) * scale)) < best_split;
+		}) - triangle_indices.begin()) };
+	if (middle == first || middle == first + count)
+	{
+		// _̌덷ŕБɕ΂ꍇ͏dS̒lŕ
+		middle = first + count / 2;
+		std::nth_element(triangle_indices.begin() + first, triangle_indices.begin() + middle, triangle_indices.begin() + first + count, [&](uint32_t a, uint32_t b) {
+			return component(centroids.at(a), best_axis) < component(centroids.at(b), best_axis);
+			});
+	}
+
+	// 1Ԗڂ̎q͒ɔzuA2Ԗڂ̎q̃CfbNXL^
+	subdivide(centroids, triangle_bounding_boxes, first, middle - first, depth + 1);
+	const uint32_t second_child{ subdivide(centroids, triangle_bounding_boxes, middle, first + count - middle, depth + 1) };
+	nodes.at(node_index).offset = second_child;
+	nodes.at(node_index).triangle_count = 0;
+	return node_index;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+// UNIT.99
+#include <directxmath.h>
+#include <vector>
+#include <cstdint>
+
+#include "collision_detection.h"
+
+// Op`Wɑ΂BVH(Bounding Volume Hierarchy)
+// SAH(Surface Area Heuristic)ō\zA[D揇̔zɕRB
+// m[h1Ԗڂ̎q͏ɒ̗vfɒu邽߁A2Ԗڂ̎q̃CfbNXێ΂悢B
+class bounding_volume_hierarchy
+{
+public:
+	struct node
+	{
+		DirectX::XMFLOAT3 bounding_box[2]{};
+		uint32_t offset{ 0 }; // t:triangle_indices̍ŏ̈ʒuAm[h:2Ԗڂ̎q̃CfbNX
+		uint32_t triangle_count{ 0 }; // 0̏ꍇ͓m[h
+
+		bool is_leaf() const { return triangle_count > 0; }
+
+		template<class T>
+		void serialize(T& archive)
+		{
+			archive(bounding_box, offset, triangle_count);
+		}
+	};
+	std::vector<node> nodes;
+
+	// t̕яɕׂOp`ԍ(̃CfbNXobt@̎Op`̈ʒu)
+	std::vector<uint32_t> triangle_indices;
+
+	static const uint32_t MAX_LEAF_TRIANGLES{ 4 };
+	static const uint32_t MAX_DEPTH{ 64 };
+	static const uint32_t BIN_COUNT{ 12 };
+
+	void build(const DirectX::XMFLOAT3* positions, const uint32_t* indices, size_t index_count);
+
+	template<class T>
+	void serialize(T& archive)
+	{
+		archive(nodes, triangle_indices);
+	}
+
+	// ʉ߂t߂ɖK₷B
+	// leaf_callback(first, count)͗t̎Op`͈[first, first + count)󂯎Adistancek߂B
+	// ddistanceƓړx̕xNg(ʏ͐Kς)łȂ΂ȂȂB
+	template<class F>
+	void traverse(const float p[3], const float d[3], const float& distance, F&& leaf_callback) const
+	{
+		if (nodes.empty())
+		{
+			return;
+		}
+		const float inv_d[3]{ 1.0f / d[0], 1.0f / d[1], 1.0f / d[2] };
+
+		float t{ 0 };
+		if (!intersect_ray_slabs(p, inv_d, &nodes.at(0).bounding_box[0].x, &nodes.at(0).bounding_box[1].x, distance, t))
+		{
+			return;
+		}
+
+		uint32_t stack[MAX_DEPTH + 1];
+		uint32_t stack_size{ 0 };
+		stack[stack_size++] = 0;
+		while (stack_size > 0)
+		{
+			const node& node{ nodes[stack[--stack_size]] };
+			if (node.is_leaf())
+			{
+				leaf_callback(node.offset, node.triangle_count);
+				continue;
+			}
+
+			const uint32_t children[2]{ static_cast<uint32_t>(&node - nodes.data()) + 1, node.offset };
+			float t_enter[2]{};
+			const bool hit[2]{
+				intersect_ray_slabs(p, inv_d, &nodes[children[0]].bounding_box[0].x, &nodes[children[0]].bounding_box[1].x, distance, t_enter[0]),
+				intersect_ray_slabs(p, inv_d, &nodes[children[1]].bounding_box[0].x, &nodes[children[1]].bounding_box[1].x, distance, t_enter[1]) };
+			if (hit[0] && hit[1])
+			{
+				// ɐς݁A߂珈
+				const bool near_is_first{ t_enter[0] <= t_enter[1] };
+				stack[stack_size++] = children[near_is_first ? 1 : 0];
+				stack[stack_size++] = children[near_is_first ? 0 : 1];
+			}
+			else if (hit[0])
+			{
+				stack[stack_size++] = children[0];
+			}
+			else if (hit[1])
+			{
+				stack[stack_size++] = children[1];
+			}
+		}
+	}
+
+	// AABB(min, max)ƏdȂtׂĖK₷Bleaf_callback(first, count)̈traverseƓB
+	template<class F>
+	void query(const float min[3], const float max[3], F&& leaf_callback) const
+	{
+		if (nodes.empty())
+		{
+			return;
+		}
+
+		uint32_t stack[MAX_DEPTH + 1];
+		uint32_t stack_size{ 0 };
+		stack[stack_size++] = 0;
+		while (stack_size > 0)
+		{
+			const uint32_t node_index{ stack[--stack_size] };
+			const node& node{ nodes[node_index] };
+			if (node.bounding_box[0].x > max[0] || node.bounding_box[1].x < min[0] ||
+				node.bounding_box[0].y > max[1] || node.bounding_box[1].y < min[1] ||
+				node.bounding_box[0].z > max[2] || node.bounding_box[1].z < min[2])
+			{
+				continue;
+			}
+			if (node.is_leaf())
+			{
+				leaf_callback(node.offset, node.triangle_count);
+				continue;
+			}
+			stack[stack_size++] = node.offset;
+			stack[stack_size++] = node_index + 1;
+		}
+	}
+
+private:
+	uint32_t subdivide(const std::vector<DirectX::XMFLOAT3>& centroids, const std::vector<DirectX::XMFLOAT3>& triangle_bounding_boxes, uint32_t first, uint32_t count, uint32_t depth);
+};
@@ -46,16 +46,13 @@ void camera::update(float delta_time)
 
 void camera::collide_with(const collision_mesh* collision_mesh, DirectX::XMFLOAT4X4 transform)
 {
-	XMFLOAT4 intersection;
-	std::string mesh;
-	std::string material;
-
+	::collision_mesh::raycast_hit ground;
 	if (collision_mesh->raycast(
 		{ _position.x, _position.y + 10, _position.z, 1.0f },
 		{ 0, -1, 0, 0 },
-		transform, intersection, mesh, material))
+		transform, ground))
 	{
-		_position = intersection;
+		_position = ground.closest_point;
 		// TODO
 	}
 }
\ No newline at end of file
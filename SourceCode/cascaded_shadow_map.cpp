@@ -56,6 +56,23 @@ cascaded_shadow_map::cascaded_shadow_map(ID3D11Device* device, uint32_t width, u
 	hr = device->CreateDepthStencilView(depth_stencil_buffer.Get(), &depth_stencil_view_desc, _depth_stencil_view.GetAddressOf());
 	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 
+	// ÓIȃVhELX^[̐[x̃LbVBCopyResourceŕʂ̂ŃVhE}bvƓ\ɂ
+	hr = device->CreateTexture2D(&texture2d_desc, 0, _static_depth_stencil_buffer.GetAddressOf());
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+
+	_slice_depth_stencil_views.resize(_cascade_count);
+	_static_slice_depth_stencil_views.resize(_cascade_count);
+	for (size_t cascade_index = 0; cascade_index < _cascade_count; ++cascade_index)
+	{
+		depth_stencil_view_desc.Texture2DArray.FirstArraySlice = static_cast<UINT>(cascade_index);
+		depth_stencil_view_desc.Texture2DArray.ArraySize = 1;
+		hr = device->CreateDepthStencilView(depth_stencil_buffer.Get(), &depth_stencil_view_desc, _slice_depth_stencil_views.at(cascade_index).GetAddressOf());
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+		hr = device->CreateDepthStencilView(_static_depth_stencil_buffer.Get(), &depth_stencil_view_desc, _static_slice_depth_stencil_views.at(cascade_index).GetAddressOf());
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	}
+	_cached_cascades.resize(_cascade_count);
+
 	D3D11_SHADER_RESOURCE_VIEW_DESC shader_resource_view_desc = {};
 	shader_resource_view_desc.Format = DXGI_FORMAT_R32_FLOAT; // DXGI_FORMAT_R24_UNORM_X8_TYPELESS : DXGI_FORMAT_R32_FLOAT : DXGI_FORMAT_R16_UNORM
 	shader_resource_view_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
@@ -77,20 +94,8 @@ cascaded_shadow_map::cascaded_shadow_map(ID3D11Device* device, uint32_t width, u
 
 }
 
-void cascaded_shadow_map::make(ID3D11DeviceContext* immediate_context,
-	const DirectX::XMFLOAT4X4& camera_view,
-	const DirectX::XMFLOAT4X4& camera_projection,
-	const DirectX::XMFLOAT4& light_direction,
-	float critical_depth_value,
-	std::function<void()> drawcallback)
+void cascaded_shadow_map::update_distances(const DirectX::XMFLOAT4X4& camera_projection, float critical_depth_value)
 {
-	D3D11_VIEWPORT cached_viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
-	UINT viewport_count = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
-	immediate_context->RSGetViewports(&viewport_count, cached_viewports);
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> cached_render_target_view;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> cached_depth_stencil_view;
-	immediate_context->OMGetRenderTargets(1, cached_render_target_view.ReleaseAndGetAddressOf(), cached_depth_stencil_view.ReleaseAndGetAddressOf());
-
 	// es񂩂̋߁El
 	float m33 = camera_projection._33;
 	float m43 = camera_projection._43;
@@ -110,6 +115,31 @@ void cascaded_shadow_map::make(ID3D11DeviceContext* immediate_context,
 	// {[_[̒lmł邱ƂmF
 	_distances.at(0) = zn;
 	_distances.at(_cascade_count) = zf;
+}
+
+void cascaded_shadow_map::update_constants()
+{
+	_frustums.clear();
+	for (const XMFLOAT4X4& view_projection : _view_projection)
+	{
+		_frustums.emplace_back(view_projection);
+	}
+
+	_constants->data.view_projection_matrices[0] = _view_projection.at(0);
+	_constants->data.view_projection_matrices[1] = _view_projection.at(1);
+	_constants->data.view_projection_matrices[2] = _view_projection.at(2);
+	_constants->data.view_projection_matrices[3] = _view_projection.at(3);
+
+	_constants->data.cascade_plane_distances[0] = _distances.at(1);
+	_constants->data.cascade_plane_distances[1] = _distances.at(2);
+	_constants->data.cascade_plane_distances[2] = _distances.at(3);
+	_constants->data.cascade_plane_distances[3] = _distances.at(4);
+}
+
+void cascaded_shadow_map::update_cascades(const DirectX::XMFLOAT4X4& camera_view, const DirectX::XMFLOAT4X4& camera_projection, const DirectX::XMFLOAT4& light_direction, float critical_depth_value)
+{
+	update_distances(camera_projection, critical_depth_value);
+	const float zn = _distances.at(0);
 
 	const bool fit_to_cascade = true; 
 	_view_projection.resize(_cascade_count);
@@ -184,15 +214,116 @@ void cascaded_shadow_map::make(ID3D11DeviceContext* immediate_context,
 		XMStoreFloat4x4(&_view_projection.at(cascade_index), V * P);
 	}
 
-	_constants->data.view_projection_matrices[0] = _view_projection.at(0);
-	_constants->data.view_projection_matrices[1] = _view_projection.at(1);
-	_constants->data.view_projection_matrices[2] = _view_projection.at(2);
-	_constants->data.view_projection_matrices[3] = _view_projection.at(3);
+	update_constants();
+}
 
-	_constants->data.cascade_plane_distances[0] = _distances.at(1);
-	_constants->data.cascade_plane_distances[1] = _distances.at(2);
-	_constants->data.cascade_plane_distances[2] = _distances.at(3);
-	_constants->data.cascade_plane_distances[3] = _distances.at(4);
+// sړ܂܂ȂCg̃r[sBCgԂ̍W[hɌŒ肳̂ŁAeNZPʂɑʒu͎_ĂςȂ
+static XMMATRIX light_view(FXMVECTOR L)
+{
+	const XMVECTOR up{ fabsf(XMVectorGetY(L)) > 0.99f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) };
+	return XMMatrixLookToLH(XMVectorZero(), L, up);
+}
+
+uint32_t cascaded_shadow_map::update_stable_cascades(const DirectX::XMFLOAT4X4& camera_view, const DirectX::XMFLOAT4X4& camera_projection, const DirectX::XMFLOAT4& light_direction, float critical_depth_value)
+{
+	update_distances(camera_projection, critical_depth_value);
+
+	// Cg̉smakeƓlɑ傫AJXP[h̊OɂՕ܂߂
+	constexpr float depth_scale = 50.0f;
+
+	const XMVECTOR L{ XMVector3Normalize(XMVectorSet(light_direction.x, light_direction.y, light_direction.z, 0.0f)) };
+	const float cos_threshold{ cosf(XMConvertToRadians(_static_cache_light_angle_threshold)) };
+	uint32_t refresh_mask{ 0 };
+
+	_view_projection.resize(_cascade_count);
+	for (size_t cascade_index = 0; cascade_index < _cascade_count; ++cascade_index)
+	{
+		cached_cascade& cache{ _cached_cascades.at(cascade_index) };
+		const float _zn = _distances.at(cascade_index);
+		const float _zf = _distances.at(cascade_index + 1);
+
+		DirectX::XMFLOAT4X4 cascaded_projection = camera_projection;
+		cascaded_projection._33 = _zf / (_zf - _zn);
+		cascaded_projection._43 = -_zn * _zf / (_zf - _zn);
+
+		std::array<XMFLOAT4, 8> corners = _make_frustum_corners_world_space(camera_view, cascaded_projection);
+
+		// JXP[h̕܋Ba͎_̉]ŕςȂ̂ŁAۂ߂ĂΓȇ傫t[hȂ
+		XMVECTOR center{ XMVectorZero() };
+		for (decltype(corners)::const_reference v : corners)
+		{
+			center = XMVectorAdd(center, XMVectorSet(v.x, v.y, v.z, 0.0f));
+		}
+		center = XMVectorScale(center, 1.0f / corners.size());
+		float radius{ 0 };
+		for (decltype(corners)::const_reference v : corners)
+		{
+			radius = std::max(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(XMVectorSet(v.x, v.y, v.z, 0.0f), center))));
+		}
+		radius = ceilf(radius * 16.0f) / 16.0f;
+
+		bool refit{ !cache.valid ||
+			XMVectorGetX(XMVector3Dot(L, XMLoadFloat3(&cache.light_direction))) < cos_threshold ||
+			fabsf(cache.near_distance - _zn) > _zf * 1e-4f || fabsf(cache.far_distance - _zf) > _zf * 1e-4f };
+		if (!refit)
+		{
+			// LbV͈͂Ɍ݂̕܋܂ĂԂ͓eg
+			XMFLOAT3 c;
+			XMStoreFloat3(&c, XMVector3TransformCoord(center, light_view(XMLoadFloat3(&cache.light_direction))));
+			refit = fabsf(c.x - cache.center.x) + radius > cache.half_extent ||
+				fabsf(c.y - cache.center.y) + radius > cache.half_extent ||
+				fabsf(c.z - cache.center.z) + radius > cache.half_extent * depth_scale;
+		}
+		if (refit)
+		{
+			cache.valid = true;
+			XMStoreFloat3(&cache.light_direction, L);
+			cache.near_distance = _zn;
+			cache.far_distance = _zf;
+			cache.half_extent = radius * (1.0f + _static_cache_margin);
+
+			// SVhE}bṽeNZPʂɑ
+			XMFLOAT3 c;
+			XMStoreFloat3(&c, XMVector3TransformCoord(center, light_view(L)));
+			const float texel_size{ 2.0f * cache.half_extent / _viewport.Width };
+			cache.center = { floorf(c.x / texel_size) * texel_size, floorf(c.y / texel_size) * texel_size, c.z };
+
+			refresh_mask |= 1U << cascade_index;
+		}
+
+		const float h{ cache.half_extent };
+		XMMATRIX V = light_view(XMLoadFloat3(&cache.light_direction));
+		XMMATRIX P = XMMatrixOrthographicOffCenterLH(cache.center.x - h, cache.center.x + h, cache.center.y - h, cache.center.y + h, cache.center.z - h * depth_scale, cache.center.z + h * depth_scale);
+		XMStoreFloat4x4(&_view_projection.at(cascade_index), V * P);
+	}
+
+	update_constants();
+	return refresh_mask;
+}
+
+void cascaded_shadow_map::invalidate_static_cache()
+{
+	for (cached_cascade& cache : _cached_cascades)
+	{
+		cache.valid = false;
+	}
+}
+
+void cascaded_shadow_map::make(ID3D11DeviceContext* immediate_context,
+	const DirectX::XMFLOAT4X4& camera_view,
+	const DirectX::XMFLOAT4X4& camera_projection,
+	const DirectX::XMFLOAT4& light_direction,
+	float critical_depth_value,
+	std::function<void()> drawcallback)
+{
+	D3D11_VIEWPORT cached_viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	UINT viewport_count = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	immediate_context->RSGetViewports(&viewport_count, cached_viewports);
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> cached_render_target_view;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> cached_depth_stencil_view;
+	immediate_context->OMGetRenderTargets(1, cached_render_target_view.ReleaseAndGetAddressOf(), cached_depth_stencil_view.ReleaseAndGetAddressOf());
+
+	update_cascades(camera_view, camera_projection, light_direction, critical_depth_value);
 
 	_constants->activate(immediate_context, 13, cb_usage::vp);
 
@@ -206,3 +337,99 @@ void cascaded_shadow_map::make(ID3D11DeviceContext* immediate_context,
 	immediate_context->RSSetViewports(viewport_count, cached_viewports);
 	immediate_context->OMSetRenderTargets(1, cached_render_target_view.GetAddressOf(), cached_depth_stencil_view.Get());
 }
+
+void cascaded_shadow_map::make_per_cascade(ID3D11DeviceContext* immediate_context,
+	const DirectX::XMFLOAT4X4& camera_view,
+	const DirectX::XMFLOAT4X4& camera_projection,
+	const DirectX::XMFLOAT4& light_direction,
+	float critical_depth_value,
+	std::function<void(size_t cascade_index)> drawcallback)
+{
+	D3D11_VIEWPORT cached_viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	UINT viewport_count = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	immediate_context->RSGetViewports(&viewport_count, cached_viewports);
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> cached_render_target_view;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> cached_depth_stencil_view;
+	immediate_context->OMGetRenderTargets(1, cached_render_target_view.ReleaseAndGetAddressOf(), cached_depth_stencil_view.ReleaseAndGetAddressOf());
+
+	update_cascades(camera_view, camera_projection, light_direction, critical_depth_value);
+	const constants cascades{ _constants->data };
+
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> null_render_target_view;
+	immediate_context->ClearDepthStencilView(_depth_stencil_view.Get(), D3D11_CLEAR_DEPTH, 1, 0);
+	immediate_context->RSSetViewports(1, &_viewport);
+
+	for (size_t cascade_index = 0; cascade_index < _cascade_count; ++cascade_index)
+	{
+		// VF[_[̓CX^XԍŃJXP[h̍sƏo͐̃XCXIԂ̂ŁA
+		// 0Ԗڂ̍s̃JXP[ĥ̂ɍւAo͐̃XCXɂ
+		_constants->data.view_projection_matrices[0] = cascades.view_projection_matrices[cascade_index];
+		_constants->activate(immediate_context, 13, cb_usage::vp);
+		immediate_context->OMSetRenderTargets(1, null_render_target_view.GetAddressOf(), _slice_depth_stencil_views.at(cascade_index).Get());
+
+		drawcallback(cascade_index);
+	}
+
+	// V[̕`ŎQƂ̂łׂẴJXP[h̒lɖ߂
+	_constants->data = cascades;
+	_constants->activate(immediate_context, 13, cb_usage::vp);
+
+	immediate_context->RSSetViewports(viewport_count, cached_viewports);
+	immediate_context->OMSetRenderTargets(1, cached_render_target_view.GetAddressOf(), cached_depth_stencil_view.Get());
+}
+
+void cascaded_shadow_map::make_cached(ID3D11DeviceContext* immediate_context,
+	const DirectX::XMFLOAT4X4& camera_view,
+	const DirectX::XMFLOAT4X4& camera_projection,
+	const DirectX::XMFLOAT4& light_direction,
+	float critical_depth_value,
+	std::function<void(size_t cascade_index)> static_drawcallback,
+	std::function<void(size_t cascade_index)> dynamic_drawcallback)
+{
+	D3D11_VIEWPORT cached_viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	UINT viewport_count = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	immediate_context->RSGetViewports(&viewport_count, cached_viewports);
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> cached_render_target_view;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> cached_depth_stencil_view;
+	immediate_context->OMGetRenderTargets(1, cached_render_target_view.ReleaseAndGetAddressOf(), cached_depth_stencil_view.ReleaseAndGetAddressOf());
+
+	const uint32_t refresh_mask{ update_stable_cascades(camera_view, camera_projection, light_direction, critical_depth_value) };
+	const constants cascades{ _constants->data };
+
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> null_render_target_view;
+	immediate_context->RSSetViewports(1, &_viewport);
+
+	// eςJXP[hÓIȃVhELX^[`
+	for (size_t cascade_index = 0; cascade_index < _cascade_count; ++cascade_index)
+	{
+		if ((refresh_mask & (1U << cascade_index)) == 0)
+		{
+			continue;
+		}
+		_constants->data.view_projection_matrices[0] = cascades.view_projection_matrices[cascade_index];
+		_constants->activate(immediate_context, 13, cb_usage::vp);
+		immediate_context->ClearDepthStencilView(_static_slice_depth_stencil_views.at(cascade_index).Get(), D3D11_CLEAR_DEPTH, 1, 0);
+		immediate_context->OMSetRenderTargets(1, null_render_target_view.GetAddressOf(), _static_slice_depth_stencil_views.at(cascade_index).Get());
+
+		static_drawcallback(cascade_index);
+		++_static_cache_refresh_count;
+	}
+
+	// LbV𕡎ʂȀɓVhELX^[d˂
+	immediate_context->OMSetRenderTargets(1, null_render_target_view.GetAddressOf(), NULL);
+	immediate_context->CopyResource(depth_stencil_buffer.Get(), _static_depth_stencil_buffer.Get());
+	for (size_t cascade_index = 0; cascade_index < _cascade_count; ++cascade_index)
+	{
+		_constants->data.view_projection_matrices[0] = cascades.view_projection_matrices[cascade_index];
+		_constants->activate(immediate_context, 13, cb_usage::vp);
+		immediate_context->OMSetRenderTargets(1, null_render_target_view.GetAddressOf(), _slice_depth_stencil_views.at(cascade_index).Get());
+
+		dynamic_drawcallback(cascade_index);
+	}
+
+	_constants->data = cascades;
+	_constants->activate(immediate_context, 13, cb_usage::vp);
+
+	immediate_context->RSSetViewports(viewport_count, cached_viewports);
+	immediate_context->OMSetRenderTargets(1, cached_render_target_view.GetAddressOf(), cached_depth_stencil_view.Get());
+}
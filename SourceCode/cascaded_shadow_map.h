@@ -7,6 +7,7 @@
 #include <functional>
 
 #include "constant_buffer.h"
+#include "collision_detection.h"
 
 // https://learnopengl.com/Guest-Articles/2021/CSM
 
@@ -27,13 +28,42 @@ public:
 		float critical_depth_value, // ̒l0̏ꍇAJ̉plgp
 		std::function<void()> drawcallback);
 
+	// JXP[hƂdrawcallback(cascade_index)ĂсÃXCXɕ`悳ŁB
+	// Ăяo̓CX^X0cascade_index̃JXP[hɑΉ̂ŁAR[obNł̓CX^X1ŕ`悵A
+	// _frustums.at(cascade_index)ƏdȂ̂`΂悢B
+	void make_per_cascade(ID3D11DeviceContext* immediate_context,
+		const DirectX::XMFLOAT4X4& camera_view,
+		const DirectX::XMFLOAT4X4& camera_projection,
+		const DirectX::XMFLOAT4& light_direction,
+		float critical_depth_value, // ̒l0̏ꍇAJ̉plgp
+		std::function<void(size_t cascade_index)> drawcallback);
+
+	// n`̂悤ȐÓIȃVhELX^[̐[xJXP[hƂɃLbVŁB
+	// e̓[hɌŒ肵CgԂŃeNZPʂɑA܋_static_cache_marginLB
+	// ͈̔͂͂̕ݏoACǧ_static_cache_light_angle_threshold(x)傫ςJXP[h
+	// static_drawcallbackŕ`At[̃LbV𕡎ʂĂdynamic_drawcallbackœLX^[d˂B
+	// ǂ̃R[obNmake_per_cascadeƓlɃCX^X1ŕ`悷B
+	void make_cached(ID3D11DeviceContext* immediate_context,
+		const DirectX::XMFLOAT4X4& camera_view,
+		const DirectX::XMFLOAT4X4& camera_projection,
+		const DirectX::XMFLOAT4& light_direction,
+		float critical_depth_value, // ̒l0̏ꍇAJ̉plgp
+		std::function<void(size_t cascade_index)> static_drawcallback,
+		std::function<void(size_t cascade_index)> dynamic_drawcallback);
+	// ÓIȃVhELX^[ςꍇɌĂԁBmake_cachedłׂẴJXP[h`
+	void invalidate_static_cache();
+
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> depth_stencil_buffer;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> _depth_stencil_view;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _shader_resource_view;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilView>> _slice_depth_stencil_views; // JXP[hƂ1̃XCXwr[
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> _static_depth_stencil_buffer; // ÓIȃVhELX^[`[x̃LbV
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilView>> _static_slice_depth_stencil_views;
 	D3D11_VIEWPORT _viewport;
 
 	std::vector<DirectX::XMFLOAT4X4> _view_projection;
 	std::vector<float> _distances;
+	std::vector<view_frustum> _frustums; // JXP[hƂ̃CgԂ̎(VhELX^[̃JOp)
 
 
 	struct constants
@@ -45,6 +75,30 @@ public:
 
 
 
+	float _static_cache_margin = 0.25f; // LbVJXP[h͈̔͂܋̔aɑ΂ĂǂꂾL邩
+	float _static_cache_light_angle_threshold = 0.5f; // x
+	size_t _static_cache_refresh_count = 0; // ÓIȃVhELX^[`JXP[h̗݌v
+
+private:
+	struct cached_cascade
+	{
+		bool valid{ false };
+		DirectX::XMFLOAT3 light_direction{};
+		DirectX::XMFLOAT3 center{}; // Cg(light_direction)ł̓e̒S
+		float half_extent{ 0 };
+		float near_distance{ 0 };
+		float far_distance{ 0 };
+	};
+	std::vector<cached_cascade> _cached_cascades;
+
+	void update_distances(const DirectX::XMFLOAT4X4& camera_projection, float critical_depth_value);
+	// _view_projection_frustumsƒ萔obt@̓e߂
+	void update_constants();
+	// _distancesA_view_projectionA_frustumsƒ萔obt@̓e߂
+	void update_cascades(const DirectX::XMFLOAT4X4& camera_view, const DirectX::XMFLOAT4X4& camera_projection, const DirectX::XMFLOAT4& light_direction, float critical_depth_value);
+	// make_cachedp̈艻e߁A`KvȃJXP[h̃rbgԂ
+	uint32_t update_stable_cascades(const DirectX::XMFLOAT4X4& camera_view, const DirectX::XMFLOAT4X4& camera_projection, const DirectX::XMFLOAT4& light_direction, float critical_depth_value);
+
 public:
 	const size_t _cascade_count;
 	float _split_scheme_weight = 0.82f; 
@@ -1,5 +1,8 @@
 #include <utility>
+#include <algorithm>
 #include "collision_detection.h"
+#include "misc.h"
+#include "simd_lanes.h"
 using namespace DirectX;
 
 bool intersect_ray_aabb(const float p[3], const float d[3], const float min[3], const float max[3], float q[3], float& tmin)
@@ -170,6 +173,429 @@ int intersect_ray_triangles
 	return intersected_triangle_index;
 }
 
+void triangle_soa::build(const float* positions, const uint32_t stride, const uint32_t* indices, const size_t index_count, bool RHS)
+{
+	const bool CCW{ RHS };
+	const int C0{ 0 };
+	const int C1{ CCW ? 1 : 2 };
+	const int C2{ CCW ? 2 : 1 };
+
+	triangle_count = index_count / 3;
+	for (size_t axis = 0; axis < 3; ++axis)
+	{
+		a[axis].assign(triangle_count + PADDING, 0.0f);
+		b[axis].assign(triangle_count + PADDING, 0.0f);
+		c[axis].assign(triangle_count + PADDING, 0.0f);
+		n[axis].assign(triangle_count + PADDING, 0.0f);
+	}
+	d.assign(triangle_count + PADDING, 0.0f);
+
+	using byte = uint8_t;
+	const byte* p{ reinterpret_cast<const byte*>(positions) };
+	for (size_t triangle_index = 0; triangle_index < triangle_count; triangle_index++)
+	{
+		const float* vertices[3]{
+			reinterpret_cast<const float*>(p + indices[triangle_index * 3 + C0] * stride),
+			reinterpret_cast<const float*>(p + indices[triangle_index * 3 + C1] * stride),
+			reinterpret_cast<const float*>(p + indices[triangle_index * 3 + C2] * stride) };
+		const XMVECTOR A{ XMVectorSet(vertices[0][0], vertices[0][1], vertices[0][2], 1.0f) };
+		const XMVECTOR B{ XMVectorSet(vertices[1][0], vertices[1][1], vertices[1][2], 1.0f) };
+		const XMVECTOR C{ XMVectorSet(vertices[2][0], vertices[2][1], vertices[2][2], 1.0f) };
+
+		// t@XƓŋ߂邱ƂŁAƂ̐KȂĂʂςȂ
+		XMFLOAT3 N;
+		XMStoreFloat3(&N, XMVector3Normalize(XMVector3Cross(XMVectorSubtract(B, A), XMVectorSubtract(C, A))));
+		d.at(triangle_index) = XMVectorGetByIndex(XMVector3Dot(XMLoadFloat3(&N), A), 0);
+
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			a[axis].at(triangle_index) = vertices[0][axis];
+			b[axis].at(triangle_index) = vertices[1][axis];
+			c[axis].at(triangle_index) = vertices[2][axis];
+		}
+		n[0].at(triangle_index) = N.x;
+		n[1].at(triangle_index) = N.y;
+		n[2].at(triangle_index) = N.z;
+	}
+}
+
+// t@XXMVector3DotAXMVector3CrossƓŉZ(FMA͎gȂ)
+template<class lanes>
+int intersect_ray_triangles_kernel(const triangle_soa& triangles, const size_t first, const size_t count, const float p[3], const float d[3], const float ray_length_limit, float& closest_distance)
+{
+	using vector = typename lanes::type;
+	const vector zero{ lanes::set1(0.0f) };
+	const vector limit{ lanes::set1(ray_length_limit) };
+	const vector px{ lanes::set1(p[0]) }, py{ lanes::set1(p[1]) }, pz{ lanes::set1(p[2]) };
+	const vector dx{ lanes::set1(d[0]) }, dy{ lanes::set1(d[1]) }, dz{ lanes::set1(d[2]) };
+
+	int intersected_triangle_index{ -1 };
+	float distances[lanes::width];
+
+	const size_t last{ first + count };
+	for (size_t base = first; base < last; base += lanes::width)
+	{
+		const vector nx{ lanes::load(&triangles.n[0][base]) };
+		const vector ny{ lanes::load(&triangles.n[1][base]) };
+		const vector nz{ lanes::load(&triangles.n[2][base]) };
+
+		// ƕʂ
+		const vector denominator{ lanes::add(lanes::add(lanes::mul(nx, dx), lanes::mul(ny, dy)), lanes::mul(nz, dz)) };
+		const vector numerator{ lanes::sub(lanes::load(&triangles.d[base]), lanes::add(lanes::add(lanes::mul(nx, px), lanes::mul(ny, py)), lanes::mul(nz, pz))) };
+		const vector t{ lanes::div(numerator, denominator) };
+		vector mask{ lanes::logical_and(lanes::less(denominator, zero), lanes::logical_and(lanes::less(zero, t), lanes::less(t, limit))) };
+		if (lanes::movemask(mask) == 0)
+		{
+			continue;
+		}
+
+		const vector qx{ lanes::add(px, lanes::mul(dx, t)) };
+		const vector qy{ lanes::add(py, lanes::mul(dy, t)) };
+		const vector qz{ lanes::add(pz, lanes::mul(dz, t)) };
+
+		const vector qax{ lanes::sub(lanes::load(&triangles.a[0][base]), qx) };
+		const vector qay{ lanes::sub(lanes::load(&triangles.a[1][base]), qy) };
+		const vector qaz{ lanes::sub(lanes::load(&triangles.a[2][base]), qz) };
+		const vector qbx{ lanes::sub(lanes::load(&triangles.b[0][base]), qx) };
+		const vector qby{ lanes::sub(lanes::load(&triangles.b[1][base]), qy) };
+		const vector qbz{ lanes::sub(lanes::load(&triangles.b[2][base]), qz) };
+		const vector qcx{ lanes::sub(lanes::load(&triangles.c[0][base]), qx) };
+		const vector qcy{ lanes::sub(lanes::load(&triangles.c[1][base]), qy) };
+		const vector qcz{ lanes::sub(lanes::load(&triangles.c[2][base]), qz) };
+
+		// U = QB x QC, V = QC x QA, W = QA x QB
+		const vector ux{ lanes::sub(lanes::mul(qby, qcz), lanes::mul(qbz, qcy)) };
+		const vector uy{ lanes::sub(lanes::mul(qbz, qcx), lanes::mul(qbx, qcz)) };
+		const vector uz{ lanes::sub(lanes::mul(qbx, qcy), lanes::mul(qby, qcx)) };
+		const vector vx{ lanes::sub(lanes::mul(qcy, qaz), lanes::mul(qcz, qay)) };
+		const vector vy{ lanes::sub(lanes::mul(qcz, qax), lanes::mul(qcx, qaz)) };
+		const vector vz{ lanes::sub(lanes::mul(qcx, qay), lanes::mul(qcy, qax)) };
+		const vector wx{ lanes::sub(lanes::mul(qay, qbz), lanes::mul(qaz, qby)) };
+		const vector wy{ lanes::sub(lanes::mul(qaz, qbx), lanes::mul(qax, qbz)) };
+		const vector wz{ lanes::sub(lanes::mul(qax, qby), lanes::mul(qay, qbx)) };
+
+		const vector uv{ lanes::add(lanes::add(lanes::mul(ux, vx), lanes::mul(uy, vy)), lanes::mul(uz, vz)) };
+		const vector uw{ lanes::add(lanes::add(lanes::mul(ux, wx), lanes::mul(uy, wy)), lanes::mul(uz, wz)) };
+		const vector vw{ lanes::add(lanes::add(lanes::mul(vx, wx), lanes::mul(vy, wy)), lanes::mul(vz, wz)) };
+		mask = lanes::logical_and(mask, lanes::not_less(uv, zero));
+		mask = lanes::logical_and(mask, lanes::not_less(uw, zero));
+		mask = lanes::logical_and(mask, lanes::not_less(vw, zero));
+
+		int hits{ lanes::movemask(mask) };
+		if (last - base < lanes::width)
+		{
+			hits &= (1 << (last - base)) - 1; // ͈͊O(ׂ̗t])Op`
+		}
+		if (hits == 0)
+		{
+			continue;
+		}
+
+		// ͋HȂ̂ŁAXJ[ŃCfbNXɍł߂̂I(t@XƓȂ̂)
+		lanes::store(distances, t);
+		for (int lane = 0; lane < lanes::width; ++lane)
+		{
+			if ((hits & (1 << lane)) && distances[lane] < closest_distance)
+			{
+				closest_distance = distances[lane];
+				intersected_triangle_index = static_cast<int>(base - first) + lane;
+			}
+		}
+	}
+	return intersected_triangle_index;
+}
+
+using ray_triangles_kernel = int(*)(const triangle_soa&, const size_t, const size_t, const float[3], const float[3], const float, float&);
+static ray_triangles_kernel select_ray_triangles_kernel()
+{
+	static const ray_triangles_kernel kernel{ supports_avx() ? intersect_ray_triangles_kernel<avx_lanes> : intersect_ray_triangles_kernel<sse_lanes> };
+	return kernel;
+}
+const char* ray_triangles_kernel_isa()
+{
+	return select_ray_triangles_kernel() == intersect_ray_triangles_kernel<avx_lanes> ? "AVX" : "SSE";
+}
+
+// ʂƂɖ@̕ł_(x, y, z)̔zIׂ΁A[Ԃŕ򂹂ɍς
+template<class lanes>
+void cull_frustum_aabbs_kernel(const view_frustum& view_frustum, const bounding_box_soa& bounding_boxes, uint64_t* visibility)
+{
+	const typename lanes::type zero{ lanes::set1(0.0f) };
+	const uint64_t lane_mask{ (1ULL << lanes::width) - 1 };
+	for (size_t base = 0; base < bounding_boxes.count; base += lanes::width)
+	{
+		typename lanes::type culled{ zero };
+		for (const XMFLOAT4& face : view_frustum.faces)
+		{
+			const float* x{ (face.x < 0.0f ? bounding_boxes.min[0] : bounding_boxes.max[0]).data() + base };
+			const float* y{ (face.y < 0.0f ? bounding_boxes.min[1] : bounding_boxes.max[1]).data() + base };
+			const float* z{ (face.z < 0.0f ? bounding_boxes.min[2] : bounding_boxes.max[2]).data() + base };
+			const typename lanes::type distance{ lanes::add(lanes::add(lanes::add(
+				lanes::mul(lanes::set1(face.x), lanes::load(x)),
+				lanes::mul(lanes::set1(face.y), lanes::load(y))),
+				lanes::mul(lanes::set1(face.z), lanes::load(z))),
+				lanes::set1(face.w)) };
+			culled = lanes::logical_or(culled, lanes::less(distance, zero));
+		}
+		// (4܂8)64̖񐔂Ȃ̂ŁA1񕪂̃rbg܂Ƃ͂Ȃ
+		visibility[base / 64] |= (~static_cast<uint64_t>(lanes::movemask(culled)) & lane_mask) << (base % 64);
+	}
+}
+using frustum_aabbs_kernel = void(*)(const view_frustum&, const bounding_box_soa&, uint64_t*);
+void cull_frustum_aabbs(const view_frustum& view_frustum, const bounding_box_soa& bounding_boxes, std::vector<uint64_t>& visibility)
+{
+	static const frustum_aabbs_kernel kernel{ supports_avx() ? cull_frustum_aabbs_kernel<avx_lanes> : cull_frustum_aabbs_kernel<sse_lanes> };
+
+	visibility.assign((bounding_boxes.count + 63) / 64, 0);
+	kernel(view_frustum, bounding_boxes, visibility.data());
+	// pfBÕrbg𗎂Ƃ
+	if (bounding_boxes.count % 64 != 0)
+	{
+		visibility.back() &= (1ULL << (bounding_boxes.count % 64)) - 1;
+	}
+}
+
+int intersect_ray_triangles
+(
+	const triangle_soa& triangles,
+	const size_t first,
+	const size_t count,
+	const XMFLOAT4& ray_position,
+	const XMFLOAT4& ray_direction,
+	XMFLOAT4& intersection,
+	float& distance
+)
+{
+	_ASSERT_EXPR(first + count <= triangles.triangle_count, L"The triangle range is out of bounds.");
+
+	const XMVECTOR P{ XMVectorSet(ray_position.x, ray_position.y, ray_position.z, 1) };
+	const XMVECTOR D{ XMVector3Normalize(XMVectorSet(ray_direction.x, ray_direction.y, ray_direction.z, 0)) };
+	XMFLOAT3 p, d;
+	XMStoreFloat3(&p, P);
+	XMStoreFloat3(&d, D);
+
+	float closest_distance{ FLT_MAX };
+	const int intersected_triangle_index{ select_ray_triangles_kernel()(triangles, first, count, &p.x, &d.x, distance, closest_distance) };
+	if (intersected_triangle_index >= 0)
+	{
+		XMStoreFloat4(&intersection, XMVectorAdd(P, XMVectorScale(D, closest_distance)));
+		distance = closest_distance;
+	}
+	return intersected_triangle_index;
+}
+
+// A^CՓˌo 5.1.5 _ɑ΂Op`̍ŋߐړ_
+static XMVECTOR closest_point_point_triangle(FXMVECTOR P, FXMVECTOR A, FXMVECTOR B, GXMVECTOR C)
+{
+	const XMVECTOR AB{ XMVectorSubtract(B, A) };
+	const XMVECTOR AC{ XMVectorSubtract(C, A) };
+	const XMVECTOR AP{ XMVectorSubtract(P, A) };
+	const float d1{ XMVectorGetX(XMVector3Dot(AB, AP)) };
+	const float d2{ XMVectorGetX(XMVector3Dot(AC, AP)) };
+	if (d1 <= 0.0f && d2 <= 0.0f)
+	{
+		return A; // _Ä̗
+	}
+
+	const XMVECTOR BP{ XMVectorSubtract(P, B) };
+	const float d3{ XMVectorGetX(XMVector3Dot(AB, BP)) };
+	const float d4{ XMVectorGetX(XMVector3Dot(AC, BP)) };
+	if (d3 >= 0.0f && d4 <= d3)
+	{
+		return B; // _B̗̈
+	}
+
+	const float vc{ d1 * d4 - d3 * d2 };
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		return XMVectorAdd(A, XMVectorScale(AB, d1 / (d1 - d3))); // AB̗̈
+	}
+
+	const XMVECTOR CP{ XMVectorSubtract(P, C) };
+	const float d5{ XMVectorGetX(XMVector3Dot(AB, CP)) };
+	const float d6{ XMVectorGetX(XMVector3Dot(AC, CP)) };
+	if (d6 >= 0.0f && d5 <= d6)
+	{
+		return C; // _C̗̈
+	}
+
+	const float vb{ d5 * d2 - d1 * d6 };
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		return XMVectorAdd(A, XMVectorScale(AC, d2 / (d2 - d6))); // AC̗̈
+	}
+
+	const float va{ d3 * d6 - d5 * d4 };
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		return XMVectorAdd(B, XMVectorScale(XMVectorSubtract(C, B), (d4 - d3) / ((d4 - d3) + (d5 - d6)))); // BC̗̈
+	}
+
+	// ʂ̗̈
+	const float denominator{ 1.0f / (va + vb + vc) };
+	return XMVectorAdd(A, XMVectorAdd(XMVectorScale(AB, vb * denominator), XMVectorScale(AC, vc * denominator)));
+}
+
+// A^CՓˌo 5.1.9 2̐̍ŋߐړ_
+static float closest_points_segment_segment(FXMVECTOR P1, FXMVECTOR Q1, FXMVECTOR P2, GXMVECTOR Q2, XMVECTOR& C1, XMVECTOR& C2)
+{
+	const XMVECTOR D1{ XMVectorSubtract(Q1, P1) };
+	const XMVECTOR D2{ XMVectorSubtract(Q2, P2) };
+	const XMVECTOR R{ XMVectorSubtract(P1, P2) };
+	const float a{ XMVectorGetX(XMVector3Dot(D1, D1)) };
+	const float e{ XMVectorGetX(XMVector3Dot(D2, D2)) };
+	const float f{ XMVectorGetX(XMVector3Dot(D2, R)) };
+
+	float s{ 0.0f };
+	float t{ 0.0f };
+	if (a <= FLT_EPSILON && e <= FLT_EPSILON)
+	{
+		// Ƃ_ɏkނĂ
+	}
+	else if (a <= FLT_EPSILON)
+	{
+		t = std::min<float>(1.0f, std::max<float>(0.0f, f / e));
+	}
+	else
+	{
+		const float c{ XMVectorGetX(XMVector3Dot(D1, R)) };
+		if (e <= FLT_EPSILON)
+		{
+			s = std::min<float>(1.0f, std::max<float>(0.0f, -c / a));
+		}
+		else
+		{
+			const float b{ XMVectorGetX(XMVector3Dot(D1, D2)) };
+			const float denominator{ a * e - b * b };
+			// słȂΖm̍ŋߐړ_n߂
+			s = denominator != 0.0f ? std::min<float>(1.0f, std::max<float>(0.0f, (b * f - c * e) / denominator)) : 0.0f;
+			t = (b * s + f) / e;
+			if (t < 0.0f)
+			{
+				t = 0.0f;
+				s = std::min<float>(1.0f, std::max<float>(0.0f, -c / a));
+			}
+			else if (t > 1.0f)
+			{
+				t = 1.0f;
+				s = std::min<float>(1.0f, std::max<float>(0.0f, (b - c) / a));
+			}
+		}
+	}
+	C1 = XMVectorAdd(P1, XMVectorScale(D1, s));
+	C2 = XMVectorAdd(P2, XMVectorScale(D2, t));
+	return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(C1, C2)));
+}
+
+float closest_points_segment_triangle(const XMFLOAT3 segment[2], const XMFLOAT3 triangle[3], XMFLOAT3& on_segment, XMFLOAT3& on_triangle)
+{
+	const XMVECTOR S0{ XMLoadFloat3(&segment[0]) };
+	const XMVECTOR S1{ XMLoadFloat3(&segment[1]) };
+	const XMVECTOR A{ XMLoadFloat3(&triangle[0]) };
+	const XMVECTOR B{ XMLoadFloat3(&triangle[1]) };
+	const XMVECTOR C{ XMLoadFloat3(&triangle[2]) };
+
+	// Op`тĂ΋0
+	const XMVECTOR N{ XMVector3Cross(XMVectorSubtract(B, A), XMVectorSubtract(C, A)) };
+	const float distance0{ XMVectorGetX(XMVector3Dot(N, XMVectorSubtract(S0, A))) };
+	const float distance1{ XMVectorGetX(XMVector3Dot(N, XMVectorSubtract(S1, A))) };
+	if ((distance0 <= 0.0f && distance1 >= 0.0f) || (distance0 >= 0.0f && distance1 <= 0.0f))
+	{
+		const float denominator{ distance0 - distance1 };
+		const XMVECTOR X{ denominator != 0.0f ? XMVectorLerp(S0, S1, distance0 / denominator) : S0 };
+		const XMVECTOR Y{ closest_point_point_triangle(X, A, B, C) };
+		if (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(X, Y))) <= FLT_EPSILON * FLT_EPSILON)
+		{
+			XMStoreFloat3(&on_segment, X);
+			XMStoreFloat3(&on_triangle, Y);
+			return 0.0f;
+		}
+	}
+
+	// тĂȂ΁A[_ƎOp`AƊeӂ̍ŋߐړ_̂ł߂
+	XMVECTOR closest_on_segment{ S0 };
+	XMVECTOR closest_on_triangle{ closest_point_point_triangle(S0, A, B, C) };
+	float closest_distance_squared{ XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(closest_on_segment, closest_on_triangle))) };
+	auto update = [&](FXMVECTOR on_segment, FXMVECTOR on_triangle) {
+		const float distance_squared{ XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(on_segment, on_triangle))) };
+		if (distance_squared < closest_distance_squared)
+		{
+			closest_distance_squared = distance_squared;
+			closest_on_segment = on_segment;
+			closest_on_triangle = on_triangle;
+		}
+	};
+	update(S1, closest_point_point_triangle(S1, A, B, C));
+
+	const XMVECTOR edges[3][2]{ { A, B }, { B, C }, { C, A } };
+	for (const XMVECTOR* edge : edges)
+	{
+		XMVECTOR on_segment_edge, on_edge;
+		closest_points_segment_segment(S0, S1, edge[0], edge[1], on_segment_edge, on_edge);
+		update(on_segment_edge, on_edge);
+	}
+
+	XMStoreFloat3(&on_segment, closest_on_segment);
+	XMStoreFloat3(&on_triangle, closest_on_triangle);
+	return closest_distance_squared;
+}
+
+bool sweep_capsule_triangle(const XMFLOAT3 segment[2], const float radius, const XMFLOAT3& displacement, const XMFLOAT3 triangle[3], float& time, XMFLOAT3& contact_point, XMFLOAT3& normal)
+{
+	const XMVECTOR V{ XMLoadFloat3(&displacement) };
+	const XMVECTOR A{ XMLoadFloat3(&triangle[0]) };
+	const XMVECTOR N{ XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&triangle[1]), A), XMVectorSubtract(XMLoadFloat3(&triangle[2]), A)) };
+	if (XMVectorGetX(XMVector3Dot(N, V)) >= 0.0f)
+	{
+		return false; // ʁA܂͋߂ÂȂ
+	}
+
+	// sړʌ`ǂ͎̋̓ʊ֐Ȃ̂ŁAj[g@ŋradiusɂȂ鎞ɋ߂ÂĂǂzȂB
+	const float tolerance{ 1.0e-4f };
+	const int max_iterations{ 32 };
+	float t{ 0.0f };
+	XMFLOAT3 on_segment, on_triangle;
+	float distance{ 0.0f };
+	XMVECTOR separation{};
+	for (int iteration = 0; iteration < max_iterations; ++iteration)
+	{
+		const XMVECTOR offset{ XMVectorScale(V, t) };
+		XMFLOAT3 moved_segment[2];
+		XMStoreFloat3(&moved_segment[0], XMVectorAdd(XMLoadFloat3(&segment[0]), offset));
+		XMStoreFloat3(&moved_segment[1], XMVectorAdd(XMLoadFloat3(&segment[1]), offset));
+
+		distance = sqrtf(closest_points_segment_triangle(moved_segment, triangle, on_segment, on_triangle));
+		separation = XMVectorSubtract(XMLoadFloat3(&on_segment), XMLoadFloat3(&on_triangle));
+		if (distance - radius <= tolerance)
+		{
+			break;
+		}
+
+		// ̌鑬BȂȂAȌڐGȂ
+		const float approach_speed{ -XMVectorGetX(XMVector3Dot(separation, V)) / distance };
+		if (approach_speed <= 0.0f)
+		{
+			return false;
+		}
+		const float next_t{ t + (distance - radius) / approach_speed };
+		if (next_t > time)
+		{
+			return false;
+		}
+		if (iteration + 1 == max_iterations)
+		{
+			break; // ڐG_Ɩ@߂t̂܂ܕԂ
+		}
+		t = next_t;
+	}
+	// g؂ꍇAt͐ڐG̎Oɂړʂ͈͓̔ŁA̐ŐڐĜŁAŌɋ߂ŐڐGƂĕԂ
+	contact_point = on_triangle;
+	// ߂荞łČ܂Ȃꍇ͖ʂ̖@g
+	XMStoreFloat3(&normal, XMVector3Normalize(distance > tolerance ? separation : N));
+	time = t;
+	return true;
+}
+
 int intersect_frustum_aabb(const view_frustum& view_frustum, const DirectX::XMFLOAT3 bounding_box[2])
 {
 	int cull{ false };
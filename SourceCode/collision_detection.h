@@ -3,6 +3,8 @@
 // UNIT.99
 #include <directxmath.h>
 #include <functional>
+#include <vector>
+#include <cstdint>
 
 //֐̈ϐ̍Wnׂ͂ēłȂ΂ȂȂB
 inline bool intersect_ray_aabb(const float p[3], const float d[3], const float min[3], const float max[3])
@@ -28,6 +30,31 @@ inline bool intersect_ray_aabb(const float p[3], const float d[3], const float m
 	}
 	return true;
 }
+// txNg(inv_d = 1/d)gXuB[0, t_limit]͈̔͂Ō΁Aiʒutt_enterɕԂB
+// BVH̑̂悤ɓőAABB𔻒肷ꍇɎgB
+inline bool intersect_ray_slabs(const float p[3], const float inv_d[3], const float min[3], const float max[3], float t_limit, float& t_enter)
+{
+	float tmin{ 0 };
+	float tmax{ t_limit };
+
+	for (size_t a = 0; a < 3; ++a)
+	{
+		float t0{ (min[a] - p[a]) * inv_d[a] };
+		float t1{ (max[a] - p[a]) * inv_d[a] };
+		if (t0 > t1)
+		{
+			std::swap<float>(t0, t1);
+		}
+		tmin = t0 > tmin ? t0 : tmin;
+		tmax = t1 < tmax ? t1 : tmax;
+		if (tmax < tmin)
+		{
+			return false;
+		}
+	}
+	t_enter = tmin;
+	return true;
+}
 // C R(t) = p + t*d  AABB(min, max) ƌB
 // _(q)܂ł́A߂(tmin)ԂB
 bool intersect_ray_aabb(const float p[3], const float d[3], const float min[3], const float max[3], float q[3], float& tmin);
@@ -46,6 +73,56 @@ int intersect_ray_triangles
 	bool RHS = true //EWn
 );
 
+// SIMDintersect_ray_trianglespɁAOp`SoA(Structure of Arrays)`ŕׂ́B
+// ezSIMD̒[ǂ݉z悤ɗ]ɊmۂĂB
+struct triangle_soa
+{
+	static const size_t PADDING{ 8 };
+
+	std::vector<float> a[3]; // _A(x, y, z)
+	std::vector<float> b[3]; // _B
+	std::vector<float> c[3]; // _C
+	std::vector<float> n[3]; // Kς݂̖ʖ@
+	std::vector<float> d; // ʂ̕ NEX = d
+	size_t triangle_count{ 0 };
+
+	// intersect_ray_triangles(t@X)ƓvZŖ@ƕʂOvZB
+	void build(const float* positions, const uint32_t stride, const uint32_t* indices, const size_t index_count, bool RHS = true);
+};
+
+// SoA`̎Op`[first, first + count)4(SSE)܂8(AVX)肷B
+// eƉZ̓t@XƓŁA(߂lAintersectionAdistance)̓rbgPʂňvB
+// ߂lfirst̑΃CfbNXB
+int intersect_ray_triangles
+(
+	const triangle_soa& triangles,
+	const size_t first,
+	const size_t count,
+	const DirectX::XMFLOAT4& ray_position,
+	const DirectX::XMFLOAT4& ray_direction,
+	DirectX::XMFLOAT4& intersection,
+	float& distance //[in] ̍ő勗A[out] __܂ł̍ŏ
+);
+// sɑIꂽSIMD߃Zbg̖O("AVX" ܂ "SSE")
+const char* ray_triangles_kernel_isa();
+
+// (segment[0], segment[1])ƎOp`ABC̍ŋߐړ_߁A2ԂB
+float closest_points_segment_triangle(const DirectX::XMFLOAT3 segment[2], const DirectX::XMFLOAT3 triangle[3], DirectX::XMFLOAT3& on_segment, DirectX::XMFLOAT3& on_triangle);
+
+// aradius̃JvZ(csegment)displacementsړƂAOp`ABCɍŏɐڐG鎞߂B
+// segment[0] == segment[1]̃JvZƂĈB
+// \(intersect_ray_trianglesƓ)ɋ߂Âꍇ̂ݔ肵AڐGĂtimeAcontact_pointAnormalXVB
+bool sweep_capsule_triangle
+(
+	const DirectX::XMFLOAT3 segment[2],
+	const float radius,
+	const DirectX::XMFLOAT3& displacement,
+	const DirectX::XMFLOAT3 triangle[3],
+	float& time, //[in] T鎞̏A[out] ڐG(0:ړOA1:ړ)
+	DirectX::XMFLOAT3& contact_point, //[out] Op`̐ڐG_
+	DirectX::XMFLOAT3& normal //[out] Op`JvZ֌ڐG@
+);
+
 
 // tX^JO
 struct view_frustum
@@ -90,12 +167,49 @@ struct view_frustum
 
 		//
 		DirectX::XMStoreFloat4(&faces[5], DirectX::XMVector3Normalize(DirectX::XMVectorSet(
-			view_projection_matrix._14 - view_projection_matrix._12,
-			view_projection_matrix._24 - view_projection_matrix._22,
-			view_projection_matrix._34 - view_projection_matrix._32,
-			view_projection_matrix._44 - view_projection_matrix._42)));
+			view_projection_matrix._14 - view_projection_matrix._13,
+			view_projection_matrix._24 - view_projection_matrix._23,
+			view_projection_matrix._34 - view_projection_matrix._33,
+			view_projection_matrix._44 - view_projection_matrix._43)));
 	}
 };
 //IuWFNgAABB(Axis-Aligned Bounding Box)Jr[ɂ邩ǂmFA
 //łȂꍇGPUɑMȂ@wт܂B
 int intersect_frustum_aabb(const view_frustum& view_frustum, const DirectX::XMFLOAT3 bounding_box[2]);
+
+// ꊇJOpSoA`̃[hAABBQ
+struct bounding_box_soa
+{
+	static const size_t PADDING{ 8 };
+
+	std::vector<float> min[3];
+	std::vector<float> max[3];
+	size_t count{ 0 };
+
+	void resize(size_t bounding_box_count)
+	{
+		count = bounding_box_count;
+		const size_t padded_count{ (bounding_box_count + PADDING - 1) / PADDING * PADDING };
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			min[axis].resize(padded_count);
+			max[axis].resize(padded_count);
+		}
+	}
+	void set(size_t index, const DirectX::XMFLOAT3 bounding_box[2])
+	{
+		min[0].at(index) = bounding_box[0].x;
+		min[1].at(index) = bounding_box[0].y;
+		min[2].at(index) = bounding_box[0].z;
+		max[0].at(index) = bounding_box[1].x;
+		max[1].at(index) = bounding_box[1].y;
+		max[2].at(index) = bounding_box[1].z;
+	}
+};
+// AABB4(SSE)܂8(AVX)6ʂƔ肵AtX^ɂ(JOȂ)AABB̃rbg𗧂ĂB
+// eƉZintersect_frustum_aabbƓBvisibility(count + 63) / 64ɍ蒼B
+void cull_frustum_aabbs(const view_frustum& view_frustum, const bounding_box_soa& bounding_boxes, std::vector<uint64_t>& visibility);
+inline bool is_visible(const std::vector<uint64_t>& visibility, size_t index)
+{
+	return (visibility.at(index / 64) >> (index % 64)) & 1;
+}
@@ -1,23 +1,246 @@
 #include "collision_detection.h"
 #include "collision_mesh.h"
 
+#include "job_system.h"
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
 using namespace DirectX;
 
-bool collision_mesh::raycast(const XMFLOAT4& position, const XMFLOAT4& direction, const XMFLOAT4X4& world_transform, _Out_ XMFLOAT4& closest_point,
-	_Out_ std::string& intersected_mesh, _Out_ std::string& intersected_material, bool skip_if) const
+collision_mesh::collision_mesh(ID3D11Device* device, const char* fbx_filename, bool triangulate) : triangulate(triangulate)
 {
-	float closest_distance{ FLT_MAX };
+	static std::atomic<uint64_t> instance_count{ 0 };
+	transform_cache_key = ++instance_count;
+	source_stamp = geometric_substance::stamp_sources(fbx_filename, {});
+	cache_filename = fbx_filename;
+	cache_filename.replace_extension("collision");
+	if (load_cache(fbx_filename))
+	{
+		return;
+	}
+	if (source_hash == 0 && source_stamp != 0)
+	{
+		source_hash = geometric_substance::hash_sources(fbx_filename, {});
+	}
 
-	for (const mesh& mesh : meshes)
+	geometric_substance interim_geometric_substance(device, fbx_filename, {}, triangulate, 0, true/*avoid_create_com_objects*/);
+	size_t mesh_count = interim_geometric_substance.meshes.size();
+	meshes.resize(mesh_count);
+	for (size_t mesh_index = 0; mesh_index < mesh_count; ++mesh_index)
 	{
-		XMFLOAT4 ray_position = position;
-		XMFLOAT4 ray_direction = direction;
+		meshes.at(mesh_index) = interim_geometric_substance.meshes.at(mesh_index);
+	}
+	save_cache();
+}
+
+bool collision_mesh::load_cache(const char* fbx_filename)
+{
+	if (!std::filesystem::exists(cache_filename))
+	{
+		return false;
+	}
+	// rŐ؂ꂽꂽ肵LbVcerealO𓊂(ꂽvfł̓mۂɎs邱Ƃ)̂ŁA
+	// ǂ݂̓êĂfalseԂAĂяoFBX蒼
+	bool stale_stamp{ false };
+	try
+	{
+		std::ifstream ifs(cache_filename, std::ios::binary);
+		cereal::BinaryInputArchive deserialization(ifs);
+		uint32_t version{ 0 };
+		deserialization(version);
+		if (version != CACHE_VERSION)
+		{
+			return false;
+		}
+		uint64_t cached_source_stamp{ 0 };
+		uint64_t cached_source_hash{ 0 };
+		bool cached_triangulate{ false };
+		deserialization(cached_source_stamp, cached_source_hash, cached_triangulate);
+		if (cached_triangulate != triangulate)
+		{
+			return false;
+		}
+		// FBXȂꍇ(source_stamp0)͏ƍłȂ̂ł̂܂܎gB傫ƍXVႤƂFBXǂœeׁA
+		// Ȃsource_stampLbVۑāA͓ǂ܂ɍς܂
+		if (source_stamp != 0 && cached_source_stamp != source_stamp)
+		{
+			source_hash = geometric_substance::hash_sources(fbx_filename, {});
+			if (cached_source_hash != source_hash)
+			{
+				return false;
+			}
+			stale_stamp = true;
+		}
+		source_hash = cached_source_hash;
+		deserialization(meshes, ground);
+	}
+	catch (const std::exception&)
+	{
+		meshes.clear();
+		ground.reset();
+		return false;
+	}
+
+	for (mesh& mesh : meshes)
+	{
+		for (mesh::subset& subset : mesh.subsets)
+		{
+			subset.material_id = string_table::intern(subset.material_name);
+		}
+		mesh.build_triangle_materials();
+		mesh.build_triangles();
+	}
+	if (stale_stamp)
+	{
+		save_cache();
+	}
+	return true;
+}
+
+void collision_mesh::save_cache() const
+{
+	if (cache_filename.empty())
+	{
+		return;
+	}
+	std::ofstream ofs(cache_filename, std::ios::binary);
+	cereal::BinaryOutputArchive serialization(ofs);
+	const uint32_t version{ CACHE_VERSION };
+	serialization(version, source_stamp, source_hash, triangulate, meshes, ground);
+}
 
+void collision_mesh::mesh::build_triangle_materials()
+{
+	triangle_materials.assign(indices.size() / 3, string_table::INVALID_ID);
+	for (const subset& subset : subsets)
+	{
+		const size_t first{ subset.start_index_location / 3 };
+		const size_t last{ std::min<size_t>(triangle_materials.size(), (static_cast<size_t>(subset.start_index_location) + subset.index_count) / 3) };
+		for (size_t triangle_index = first; triangle_index < last; ++triangle_index)
+		{
+			triangle_materials.at(triangle_index) = subset.material_id;
+		}
+	}
+}
+
+void collision_mesh::mesh::build_bounding_volume_hierarchy()
+{
+	bvh.build(vertex_positions.data(), indices.data(), indices.size());
+
+	// t̎Op`AĕԂ悤ɃCfbNXobt@בւ
+	const size_t triangle_count{ bvh.triangle_indices.size() };
+	std::vector<uint32_t> sorted_indices(triangle_count * 3);
+	for (size_t slot = 0; slot < triangle_count; ++slot)
+	{
+		const uint32_t triangle_index{ bvh.triangle_indices.at(slot) };
+		sorted_indices.at(slot * 3 + 0) = indices.at(triangle_index * 3LL + 0);
+		sorted_indices.at(slot * 3 + 1) = indices.at(triangle_index * 3LL + 1);
+		sorted_indices.at(slot * 3 + 2) = indices.at(triangle_index * 3LL + 2);
+	}
+	indices.swap(sorted_indices);
+
+	build_triangles();
+}
+
+void collision_mesh::mesh::build_triangles()
+{
+	triangles.build(reinterpret_cast<const float*>(vertex_positions.data()), sizeof(XMFLOAT3), indices.data(), indices.size());
+}
+
+int collision_mesh::mesh::intersect(const XMFLOAT4& ray_position, const XMFLOAT4& ray_direction, XMFLOAT4& intersection, float& distance, bool use_bounding_volume_hierarchy, bool use_simd) const
+{
+	const float* positions{ reinterpret_cast<const float*>(vertex_positions.data()) };
+
+	int intersected_slot{ -1 };
+	if (use_bounding_volume_hierarchy)
+	{
+		// intersect_ray_trianglesƓKŋ𑪂
+		XMFLOAT3 d;
+		XMStoreFloat3(&d, XMVector3Normalize(XMLoadFloat4(&ray_direction)));
+		bvh.traverse(&ray_position.x, &d.x, distance, [&](uint32_t first, uint32_t count) {
+			const int triangle_index{ use_simd ?
+				intersect_ray_triangles(triangles, first, count, ray_position, ray_direction, intersection, distance) :
+				intersect_ray_triangles(positions, sizeof(XMFLOAT3), indices.data() + first * 3LL, count * 3LL, ray_position, ray_direction, intersection, distance) };
+			if (triangle_index >= 0)
+			{
+				intersected_slot = static_cast<int>(first) + triangle_index;
+			}
+			});
+	}
+	else if (use_simd)
+	{
+		intersected_slot = intersect_ray_triangles(triangles, 0, triangles.triangle_count, ray_position, ray_direction, intersection, distance);
+	}
+	else
+	{
+		intersected_slot = intersect_ray_triangles(positions, sizeof(XMFLOAT3), indices.data(), indices.size(), ray_position, ray_direction, intersection, distance);
+	}
+	return intersected_slot < 0 ? -1 : static_cast<int>(bvh.triangle_indices.at(intersected_slot));
+}
+
+void collision_mesh::compute_mesh_transforms(const XMFLOAT4X4& world_transform, std::vector<mesh_transform>& transforms) const
+{
+	transforms.resize(meshes.size());
+	for (size_t mesh_index = 0; mesh_index < meshes.size(); ++mesh_index)
+	{
+		const mesh& mesh{ meshes.at(mesh_index) };
 		XMMATRIX concatenated_matrix{
 			XMLoadFloat4x4(&mesh.geometric_transform) *
 			XMLoadFloat4x4(&mesh.default_global_transform) *
 			XMLoadFloat4x4(&world_transform) };
-		XMMATRIX inverse_concatenated_matrix{ XMMatrixInverse(nullptr, concatenated_matrix) };
+		XMStoreFloat4x4(&transforms.at(mesh_index).concatenated, concatenated_matrix);
+		XMStoreFloat4x4(&transforms.at(mesh_index).inverse_concatenated, XMMatrixInverse(nullptr, concatenated_matrix));
+	}
+}
+
+const std::vector<collision_mesh::mesh_transform>& collision_mesh::cached_mesh_transforms(const XMFLOAT4X4& world_transform) const
+{
+	thread_local uint64_t cached_key{ 0 };
+	thread_local XMFLOAT4X4 cached_world_transform{};
+	thread_local std::vector<mesh_transform> cached_transforms;
+	if (cached_key != transform_cache_key || memcmp(&cached_world_transform, &world_transform, sizeof(world_transform)) != 0)
+	{
+		compute_mesh_transforms(world_transform, cached_transforms);
+		cached_key = transform_cache_key;
+		cached_world_transform = world_transform;
+	}
+	return cached_transforms;
+}
+
+void collision_mesh::bake_heightfield(const XMFLOAT4X4& world_transform, float cell_size, float tolerance, job_system* jobs)
+{
+	if (ground && ground->built_with(world_transform) && ground->cell_size == cell_size && ground->tolerance == tolerance)
+	{
+		return;
+	}
+
+	// \žׂ͂ĎOp`Ŕ肳
+	ground.reset();
+	std::unique_ptr<heightfield> baked_heightfield{ std::make_unique<heightfield>() };
+	baked_heightfield->build(*this, world_transform, cell_size, tolerance, jobs);
+	ground = std::move(baked_heightfield);
+	save_cache();
+}
+
+inline bool is_downward(const XMFLOAT4& direction)
+{
+	return direction.x == 0.0f && direction.z == 0.0f && direction.y < 0.0f;
+}
+
+int collision_mesh::raycast(const std::vector<mesh_transform>& transforms, const XMFLOAT4& position, const XMFLOAT4& direction, bool skip_if,
+	XMFLOAT4& closest_point, int& intersected_triangle_index) const
+{
+	float closest_distance{ FLT_MAX };
+	int intersected_mesh_index{ -1 };
+
+	for (size_t mesh_index = 0; mesh_index < meshes.size(); ++mesh_index)
+	{
+		const mesh& mesh{ meshes.at(mesh_index) };
+		XMFLOAT4 ray_position = position;
+		XMFLOAT4 ray_direction = direction;
+
+		XMMATRIX inverse_concatenated_matrix{ XMLoadFloat4x4(&transforms.at(mesh_index).inverse_concatenated) };
 		XMStoreFloat4(&ray_position, XMVector3TransformCoord(XMLoadFloat4(&ray_position), inverse_concatenated_matrix));
 		XMStoreFloat4(&ray_direction, XMVector3TransformNormal(XMLoadFloat4(&ray_direction), inverse_concatenated_matrix));
 
@@ -32,19 +255,16 @@ bool collision_mesh::raycast(const XMFLOAT4& position, const XMFLOAT4& direction
 
 		float distance{ 1.0e+7f };
 		XMFLOAT4 intersection{};
-		const float* vertex_positions{ reinterpret_cast<const float*>( mesh.vertex_positions.data()) };
-		const uint32_t* indices{ mesh.indices.data() };
-		const size_t index_count{ mesh.indices.size() };
 
-		const int intersected_triangle_index{ intersect_ray_triangles(vertex_positions, sizeof(XMFLOAT3), indices, index_count, ray_position, ray_direction, intersection, distance) };
-		if (intersected_triangle_index >= 0)
+		const int triangle_index{ mesh.intersect(ray_position, ray_direction, intersection, distance, enable_bounding_volume_hierarchy, enable_simd) };
+		if (triangle_index >= 0)
 		{
 			if (closest_distance > distance)
 			{
 				closest_distance = distance;
-				XMStoreFloat4(&closest_point, XMVector3TransformCoord(XMLoadFloat4(&intersection), concatenated_matrix));
-				intersected_mesh = mesh.name;
-				intersected_material = mesh.find_subset(intersected_triangle_index * 3)->material_name;
+				XMStoreFloat4(&closest_point, XMVector3TransformCoord(XMLoadFloat4(&intersection), XMLoadFloat4x4(&transforms.at(mesh_index).concatenated)));
+				intersected_mesh_index = static_cast<int>(mesh_index);
+				intersected_triangle_index = triangle_index;
 #if 1
 				if (skip_if)
 				{
@@ -54,5 +274,153 @@ bool collision_mesh::raycast(const XMFLOAT4& position, const XMFLOAT4& direction
 			}
 		}
 	}
-	return closest_distance < FLT_MAX;
+	return intersected_mesh_index;
+}
+
+bool collision_mesh::raycast(const XMFLOAT4& position, const XMFLOAT4& direction, const XMFLOAT4X4& world_transform, _Out_ raycast_hit& hit, bool skip_if) const
+{
+	hit.mesh_index = -1;
+	hit.triangle_index = -1;
+
+	// }bvœ΁AšvZOp`̔sv
+	heightfield::answer answer{ heightfield::answer::unresolved };
+	if (enable_heightfield && ground && is_downward(direction) && ground->built_with(world_transform))
+	{
+		answer = ground->raycast_down(position, hit.closest_point, hit.mesh_index, hit.triangle_index);
+	}
+	if (answer == heightfield::answer::unresolved)
+	{
+		hit.mesh_index = raycast(cached_mesh_transforms(world_transform), position, direction, skip_if, hit.closest_point, hit.triangle_index);
+	}
+	hit.material_id = material_id(hit.mesh_index, hit.triangle_index);
+	return hit.mesh_index >= 0;
+}
+
+bool collision_mesh::raycast(const XMFLOAT4& position, const XMFLOAT4& direction, const XMFLOAT4X4& world_transform, _Out_ XMFLOAT4& closest_point,
+	_Out_ std::string& intersected_mesh, _Out_ std::string& intersected_material, bool skip_if) const
+{
+	raycast_hit hit;
+	if (!raycast(position, direction, world_transform, hit, skip_if))
+	{
+		return false;
+	}
+	closest_point = hit.closest_point;
+	intersected_mesh = meshes.at(hit.mesh_index).name;
+	intersected_material = material_name(hit);
+	return true;
+}
+
+void collision_mesh::raycast(const ray_batch& rays, const XMFLOAT4X4& world_transform, _Out_ std::vector<raycast_hit>& hits, bool skip_if, job_system* jobs) const
+{
+	std::vector<mesh_transform> transforms;
+	compute_mesh_transforms(world_transform, transforms);
+	const bool use_heightfield{ enable_heightfield && ground && ground->built_with(world_transform) };
+
+	const size_t ray_count{ rays.size() };
+	hits.resize(ray_count);
+
+	auto raycast_range = [&](size_t first, size_t last) {
+		for (size_t ray_index = first; ray_index < last; ++ray_index)
+		{
+			const XMFLOAT4 position{ rays.positions[0][ray_index], rays.positions[1][ray_index], rays.positions[2][ray_index], 1.0f };
+			const XMFLOAT4 direction{ rays.directions[0][ray_index], rays.directions[1][ray_index], rays.directions[2][ray_index], 0.0f };
+			raycast_hit& hit{ hits[ray_index] };
+			hit.mesh_index = -1;
+			hit.triangle_index = -1;
+			if (use_heightfield && is_downward(direction))
+			{
+				const heightfield::answer answer{ ground->raycast_down(position, hit.closest_point, hit.mesh_index, hit.triangle_index) };
+				if (answer != heightfield::answer::unresolved)
+				{
+					hit.material_id = material_id(hit.mesh_index, hit.triangle_index);
+					continue;
+				}
+			}
+			hit.mesh_index = raycast(transforms, position, direction, skip_if, hit.closest_point, hit.triangle_index);
+			hit.material_id = material_id(hit.mesh_index, hit.triangle_index);
+		}
+	};
+
+	if (!jobs || ray_count <= PARALLEL_RAYCAST_GRAIN)
+	{
+		raycast_range(0, ray_count);
+		return;
+	}
+	// ĂяõXbhWûŁA[J[ȂĂŌ܂ŏ
+	jobs->parallel_for(ray_count, PARALLEL_RAYCAST_GRAIN, raycast_range);
+}
+
+bool collision_mesh::sweep_sphere(const XMFLOAT4& center, float radius, const XMFLOAT4& displacement, const XMFLOAT4X4& world_transform, _Out_ sweep_hit& hit) const
+{
+	return sweep_capsule(center, center, radius, displacement, world_transform, hit);
+}
+
+bool collision_mesh::sweep_capsule(const XMFLOAT4& segment_start, const XMFLOAT4& segment_end, float radius, const XMFLOAT4& displacement,
+	const XMFLOAT4X4& world_transform, _Out_ sweep_hit& hit) const
+{
+	hit = {};
+
+	const XMFLOAT3 segment[2]{ { segment_start.x, segment_start.y, segment_start.z }, { segment_end.x, segment_end.y, segment_end.z } };
+	const XMFLOAT3 motion{ displacement.x, displacement.y, displacement.z };
+
+	// ړ̑O܂ރ[hԂAABB
+	XMVECTOR world_min{ XMVectorMin(XMLoadFloat3(&segment[0]), XMLoadFloat3(&segment[1])) };
+	XMVECTOR world_max{ XMVectorMax(XMLoadFloat3(&segment[0]), XMLoadFloat3(&segment[1])) };
+	world_min = XMVectorMin(world_min, XMVectorAdd(world_min, XMLoadFloat3(&motion)));
+	world_max = XMVectorMax(world_max, XMVectorAdd(world_max, XMLoadFloat3(&motion)));
+	world_min = XMVectorSubtract(world_min, XMVectorReplicate(radius));
+	world_max = XMVectorAdd(world_max, XMVectorReplicate(radius));
+	XMFLOAT3 world_bounding_box[2];
+	XMStoreFloat3(&world_bounding_box[0], world_min);
+	XMStoreFloat3(&world_bounding_box[1], world_max);
+
+	const std::vector<mesh_transform>& transforms{ cached_mesh_transforms(world_transform) };
+	for (size_t mesh_index = 0; mesh_index < meshes.size(); ++mesh_index)
+	{
+		const mesh& mesh{ meshes.at(mesh_index) };
+		const XMMATRIX concatenated_matrix{ XMLoadFloat4x4(&transforms.at(mesh_index).concatenated) };
+		const XMMATRIX inverse_concatenated_matrix{ XMLoadFloat4x4(&transforms.at(mesh_index).inverse_concatenated) };
+
+		// [hԂAABB8_fԂɈڂA͂AABBBVH
+		XMVECTOR model_min{ XMVectorReplicate(+FLT_MAX) };
+		XMVECTOR model_max{ XMVectorReplicate(-FLT_MAX) };
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const XMVECTOR point{ XMVector3TransformCoord(XMVectorSet(
+				world_bounding_box[corner & 1].x, world_bounding_box[(corner >> 1) & 1].y, world_bounding_box[(corner >> 2) & 1].z, 1.0f), inverse_concatenated_matrix) };
+			model_min = XMVectorMin(model_min, point);
+			model_max = XMVectorMax(model_max, point);
+		}
+		XMFLOAT3 model_bounding_box[2];
+		XMStoreFloat3(&model_bounding_box[0], model_min);
+		XMStoreFloat3(&model_bounding_box[1], model_max);
+
+		// ϊł̓[hԂł̊tɂȂ̂ŁA\ʂ̌ۂ߂ɒ_ւ
+		const bool mirrored{ XMVectorGetX(XMMatrixDeterminant(concatenated_matrix)) < 0.0f };
+
+		mesh.bvh.query(&model_bounding_box[0].x, &model_bounding_box[1].x, [&](uint32_t first, uint32_t count) {
+			for (uint32_t slot = first; slot < first + count; ++slot)
+			{
+				XMFLOAT3 triangle[3];
+				for (int vertex = 0; vertex < 3; ++vertex)
+				{
+					XMStoreFloat3(&triangle[mirrored && vertex > 0 ? 3 - vertex : vertex],
+						XMVector3TransformCoord(XMLoadFloat3(&mesh.vertex_positions.at(mesh.indices.at(slot * 3LL + vertex))), concatenated_matrix));
+				}
+
+				float time{ hit.time };
+				XMFLOAT3 contact_point, normal;
+				if (sweep_capsule_triangle(segment, radius, motion, triangle, time, contact_point, normal) && (hit.mesh_index < 0 || time < hit.time))
+				{
+					hit.time = time;
+					hit.contact_point = { contact_point.x, contact_point.y, contact_point.z, 1.0f };
+					hit.normal = { normal.x, normal.y, normal.z, 0.0f };
+					hit.mesh_index = static_cast<int>(mesh_index);
+					hit.triangle_index = static_cast<int>(mesh.bvh.triangle_indices.at(slot));
+					hit.material_id = mesh.triangle_materials.at(hit.triangle_index);
+				}
+			}
+		});
+	}
+	return hit.mesh_index >= 0;
 }
@@ -1,8 +1,14 @@
 #pragma once
 #include <algorithm>
+#include <filesystem>
 
 // UNIT.99
 #include "geometric_substance.h"
+#include "bounding_volume_hierarchy.h"
+#include "heightfield.h"
+#include "string_table.h"
+
+class job_system; // job_system.h
 
 class collision_mesh
 {
@@ -15,6 +21,7 @@ public:
 		struct subset
 		{
 			std::string material_name;
+			int32_t material_id{ string_table::INVALID_ID }; // material_nameC^[ID
 
 			uint32_t start_index_location{ 0 }; // GPUCfbNXobt@ŏɓǂݍ񂾃CfbNẌʒu
 			uint32_t index_count{ 0 }; // `悷CfbNX̐B
@@ -22,9 +29,17 @@ public:
 			void operator=(const geometric_substance::mesh::subset& rhs)
 			{
 				material_name = rhs.material_name;
+				material_id = string_table::intern(material_name);
 				start_index_location = rhs.start_index_location;
 				index_count = rhs.index_count;
 			}
+
+			// material_id͎sƂɕς蓾̂ŕۑAǂݍݎɃC^[
+			template<class T>
+			void serialize(T& archive)
+			{
+				archive(material_name, start_index_location, index_count);
+			}
 		};
 		std::vector<subset> subsets;
 		const subset* find_subset(uint32_t index) const
@@ -43,6 +58,20 @@ public:
 		DirectX::XMFLOAT4X4 geometric_transform{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
 		DirectX::XMFLOAT3 bounding_box[2]{};
 
+		// (בւO)Op`ԍƂ̃}eAIDBfind_subset̐`T̑ɎgB
+		std::vector<int32_t> triangle_materials;
+		void build_triangle_materials();
+
+		// \zindicesBVH̗t̏ɕבւB̎Op`ԍbvh.triangle_indicesňB
+		bounding_volume_hierarchy bvh;
+		triangle_soa triangles; // indicesƓ(BVH̗t)ɕׂSoA`̎Op`
+		void build_bounding_volume_hierarchy();
+		// vertex_positionsindicestrianglesBbuild_bounding_volume_hierarchyĂ
+		void build_triangles();
+
+		// fԂ̌ƌł߂Op`(בւO)ԍԂBȂ-1B
+		int intersect(const DirectX::XMFLOAT4& ray_position, const DirectX::XMFLOAT4& ray_direction, DirectX::XMFLOAT4& intersection, float& distance, bool use_bounding_volume_hierarchy, bool use_simd) const;
+
 		void operator=(const geometric_substance::mesh& rhs)
 		{
 			name = rhs.name;
@@ -71,22 +100,134 @@ public:
 			{
 				subsets.at(subset_index) = rhs.subsets.at(subset_index);
 			}
+
+			build_triangle_materials();
+			build_bounding_volume_hierarchy();
+		}
+
+		// triangle_materialssubsetsAtriangles͕בւindices狁܂̂ŕۑȂ
+		template<class T>
+		void serialize(T& archive)
+		{
+			archive(name, vertex_positions, indices, subsets, default_global_transform, geometric_transform, bounding_box, bvh);
 		}
 	};
 	std::vector<mesh> meshes;
 
-	collision_mesh(ID3D11Device* device, const char* fbx_filename, bool triangulate = false)
+	// falseɂƑSOp`𑍓Ŕ肷(vp)
+	bool enable_bounding_volume_hierarchy{ true };
+	// falseɂƃXJ[̃t@XŔ肷(vp)
+	bool enable_simd{ true };
+
+	// ^(0, -1, 0)̌ɓ鍂}bvBbake_heightfieldƓ[hϊraycastꍇ̂ݎgB
+	std::unique_ptr<heightfield> ground;
+	bool enable_heightfield{ true };
+	// ̍}bvLbVǂݍł΍蒼ȂB蒼ꍇ̓LbVɏ߂B
+	void bake_heightfield(const DirectX::XMFLOAT4X4& world_transform, float cell_size = 1.0f, float tolerance = 0.01f, job_system* jobs = nullptr);
+
+	// Փ˔ɕKvȃf[^(_ʒuACfbNXATuZbgABVHA}bv)
+	// FBXƓꏊ.collisiont@CɃLbVBLbVgeometric_substance̓ǂݍ݂\zȂB
+	// SoA`̎Op`͓ǂݍ񂾌ɍ蒼B
+	// FBX̓e(geometric_substance::hash_sources)triangulateĂƂƈقȂLbV͎gȂB
+	// eFBX̑傫ƍXV(geometric_substance::stamp_sources)LbVƈႤƂǂŔׂ
+	static const uint32_t CACHE_VERSION{ 4 };
+	std::filesystem::path cache_filename;
+	uint64_t source_stamp{ 0 };
+	uint64_t source_hash{ 0 };
+	bool triangulate{ false };
+
+	collision_mesh(ID3D11Device* device, const char* fbx_filename, bool triangulate = false);
+
+	struct raycast_hit
 	{
-		geometric_substance interim_geometric_substance(device, fbx_filename, {}, triangulate, 0, true/*avoid_create_com_objects*/);
-		size_t mesh_count = interim_geometric_substance.meshes.size();
-		meshes.resize(mesh_count);
-		for (size_t mesh_index = 0; mesh_index < mesh_count; ++mesh_index)
-		{
-			meshes.at(mesh_index) = interim_geometric_substance.meshes.at(mesh_index);
-		}
-	}
+		DirectX::XMFLOAT4 closest_point{};
+		int mesh_index{ -1 }; // Ȃ-1
+		int triangle_index{ -1 };
+		int32_t material_id{ string_table::INVALID_ID }; // string_tableŃC^[}eA
+	};
 
 	// ׂĂ̊֐̈̍Wn̓[h.
+	bool raycast(const DirectX::XMFLOAT4& position, const DirectX::XMFLOAT4& direction, const DirectX::XMFLOAT4X4& world_transform, _Out_ raycast_hit& hit,
+		bool skip_if = true/*Once the first intersection is found, the process is interrupted.*/) const;
+	// ԂŁBt[̔ɂIDԂłgB
 	bool raycast(const DirectX::XMFLOAT4& position, const DirectX::XMFLOAT4& direction, const DirectX::XMFLOAT4X4& world_transform, _Out_ DirectX::XMFLOAT4& closest_point,
 		_Out_ std::string& intersected_mesh, _Out_ std::string& intersected_material, bool skip_if = true/*Once the first intersection is found, the process is interrupted.*/) const;
+
+	// ꊇpSoA`̌Q
+	struct ray_batch
+	{
+		std::vector<float> positions[3];
+		std::vector<float> directions[3];
+
+		size_t size() const { return positions[0].size(); }
+		void resize(size_t ray_count)
+		{
+			for (size_t axis = 0; axis < 3; ++axis)
+			{
+				positions[axis].resize(ray_count);
+				directions[axis].resize(ray_count);
+			}
+		}
+		void set(size_t ray_index, const DirectX::XMFLOAT4& position, const DirectX::XMFLOAT4& direction)
+		{
+			positions[0].at(ray_index) = position.x;
+			positions[1].at(ray_index) = position.y;
+			positions[2].at(ray_index) = position.z;
+			directions[0].at(ray_index) = direction.x;
+			directions[1].at(ray_index) = direction.y;
+			directions[2].at(ray_index) = direction.z;
+		}
+	};
+	// Ƃ̌ʂ͒PłraycastƓBbVƂ̋ts̓ob`Ŝ1񂾂߁A
+	// jobsnꍇ́APARALLEL_RAYCAST_GRAIN{𒴂镪job_system̃[J[XbhɔzĔ肷(Xbh͍Ȃ)B
+	static const size_t PARALLEL_RAYCAST_GRAIN{ 64 };
+	void raycast(const ray_batch& rays, const DirectX::XMFLOAT4X4& world_transform, _Out_ std::vector<raycast_hit>& hits, bool skip_if = true, job_system* jobs = nullptr) const;
+	// ɂȂ(material_idINVALID_ID)ꍇ͋̕Ԃ
+	const std::string& material_name(const raycast_hit& hit) const
+	{
+		static const std::string none;
+		return hit.material_id == string_table::INVALID_ID ? none : string_table::name(hit.material_id);
+	}
+
+	struct sweep_hit
+	{
+		float time{ 1.0f }; // ړʂɑ΂ڐG܂ł̊(0:ړOA1:ړ)
+		DirectX::XMFLOAT4 contact_point{}; // Op`̐ڐG_
+		DirectX::XMFLOAT4 normal{}; // Op``Ԃ̐ڐG@
+		int mesh_index{ -1 }; // ڐGȂ-1
+		int triangle_index{ -1 };
+		int32_t material_id{ string_table::INVALID_ID };
+	};
+	// (JvZ)displacementsړƂAŏɐڐGOp`߂B
+	// ̎Op`BVHōi荞݁A[hԂŔ肷Bʂ◣ĂOp`Ƃ͐ڐGȂB
+	bool sweep_sphere(const DirectX::XMFLOAT4& center, float radius, const DirectX::XMFLOAT4& displacement, const DirectX::XMFLOAT4X4& world_transform, _Out_ sweep_hit& hit) const;
+	bool sweep_capsule(const DirectX::XMFLOAT4& segment_start, const DirectX::XMFLOAT4& segment_end, float radius, const DirectX::XMFLOAT4& displacement,
+		const DirectX::XMFLOAT4X4& world_transform, _Out_ sweep_hit& hit) const;
+	// ڐGȂ(material_idINVALID_ID)ꍇ͋̕Ԃ
+	const std::string& material_name(const sweep_hit& hit) const
+	{
+		static const std::string none;
+		return hit.material_id == string_table::INVALID_ID ? none : string_table::name(hit.material_id);
+	}
+	int32_t material_id(int mesh_index, int triangle_index) const
+	{
+		return mesh_index < 0 ? string_table::INVALID_ID : meshes.at(mesh_index).triangle_materials.at(triangle_index);
+	}
+
+private:
+	bool load_cache(const char* fbx_filename);
+	void save_cache() const;
+
+	struct mesh_transform
+	{
+		DirectX::XMFLOAT4X4 concatenated;
+		DirectX::XMFLOAT4X4 inverse_concatenated;
+	};
+	void compute_mesh_transforms(const DirectX::XMFLOAT4X4& world_transform, std::vector<mesh_transform>& transforms) const;
+	// Praycastsweep_capsulêтɔzmۂċtsߒȂ悤ɁAXbhƂɒÕ[hϊ̌ʂg
+	const std::vector<mesh_transform>& cached_mesh_transforms(const DirectX::XMFLOAT4X4& world_transform) const;
+	uint64_t transform_cache_key{ 0 }; // cached_mesh_transformšʂǂ̃CX^X̂̂BCX^XƂɈقȂ
+	// bṼCfbNXԂBȂ-1B
+	int raycast(const std::vector<mesh_transform>& transforms, const DirectX::XMFLOAT4& position, const DirectX::XMFLOAT4& direction, bool skip_if,
+		DirectX::XMFLOAT4& closest_point, int& intersected_triangle_index) const;
 };
@@ -0,0 +1,108 @@
+#pragma once
+
+// UNIT.99
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <type_traits>
+
+// }bvĂ̂܂܎QƂł镽RȃoCi`B
+// ϒ̃f[^ׂ͂ăt@C擪̃ItZbgƗvf(flat_span)ŕ\A|C^[ʂ̊mۂ܂܂ȂB
+// z͐擪ALIGNMENTɑĒûŁA}bvy[W^t̔zƂĂ̂܂ܓǂ߂B
+template<class T>
+struct flat_span
+{
+	uint64_t offset{ 0 };
+	uint64_t count{ 0 };
+};
+
+class flat_writer
+{
+public:
+	static const size_t ALIGNMENT{ 16 };
+
+	// 擪ɒuwb_[̗̈mۂBepatchŌォ珑
+	template<class T>
+	flat_span<T> reserve(size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "flat_writer can only store trivially copyable types.");
+		align();
+		const flat_span<T> span{ _bytes.size(), count };
+		_bytes.resize(_bytes.size() + sizeof(T) * count);
+		return span;
+	}
+	template<class T>
+	flat_span<T> write(const T* data, size_t count)
+	{
+		const flat_span<T> span{ reserve<T>(count) };
+		if (count > 0)
+		{
+			memcpy(_bytes.data() + span.offset, data, sizeof(T) * count);
+		}
+		return span;
+	}
+	template<class T>
+	flat_span<T> write(const std::vector<T>& data)
+	{
+		return write(data.data(), data.size());
+	}
+	flat_span<char> write(const std::string& string)
+	{
+		return write(string.data(), string.size());
+	}
+	template<class T>
+	void patch(const flat_span<T>& span, const T& data)
+	{
+		memcpy(_bytes.data() + span.offset, &data, sizeof(T));
+	}
+
+	size_t size() const { return _bytes.size(); }
+	bool save(const std::filesystem::path& filename) const
+	{
+		std::ofstream ofs(filename, std::ios::binary);
+		ofs.write(reinterpret_cast<const char*>(_bytes.data()), _bytes.size());
+		return ofs.good();
+	}
+
+private:
+	std::vector<uint8_t> _bytes;
+
+	void align()
+	{
+		_bytes.resize((_bytes.size() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT);
+	}
+};
+
+// }bvt@C(܂̓̃oCg)flat_spanB
+// ͈͊O␮񂵂ĂȂflat_spanɑ΂ĂnullptrԂ̂ŁAꂽt@Cǂł͈͊OQƂȂB
+class flat_reader
+{
+public:
+	flat_reader(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+	template<class T>
+	bool contains(const flat_span<T>& span) const
+	{
+		return span.offset % alignof(T) == 0 && span.offset <= _size && span.count <= (_size - span.offset) / sizeof(T);
+	}
+	template<class T>
+	const T* data(const flat_span<T>& span) const
+	{
+		return _data && contains(span) ? reinterpret_cast<const T*>(_data + span.offset) : nullptr;
+	}
+	// ͈͊Ȍꍇ͋󕶎
+	std::string string(const flat_span<char>& span) const
+	{
+		const char* data{ this->data(span) };
+		return data ? std::string(data, static_cast<size_t>(span.count)) : std::string();
+	}
+	const uint8_t* base() const { return _data; }
+	size_t size() const { return _size; }
+
+private:
+	const uint8_t* _data;
+	size_t _size;
+};
@@ -1,18 +1,37 @@
 
 #include "misc.h"
 #include "geometric_substance.h"
+#include "collision_detection.h"
 
 #include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <DirectXPackedVector.h>
 
 using namespace DirectX;
 
+// AVOID_CREATE_COM_OBJECTS:D3D̃IuWFNgȂĂݐp̃rh(bake_tool)BVF[_[ƃeNX`NȂ
+#ifndef AVOID_CREATE_COM_OBJECTS
 #include "shader.h"
+#endif
 
 #include <filesystem>
+#ifndef AVOID_CREATE_COM_OBJECTS
 #include "texture.h"
+#endif
 
 #include <fstream>
 
+#include "flat_archive.h"
+#include "mapped_file.h"
+#include "mesh_optimizer.h"
+#include "simd_lanes.h"
+
+#include <atomic>
+#include <future>
+#include <thread>
+
 //FbxAMatrix ^̍sADirectXMathCu XMFLOAT4X4 ^̍sɕϊ
 inline XMFLOAT4X4 to_xmfloat4x4(const FbxAMatrix& fbxamatrix)
 {
@@ -44,6 +63,75 @@ inline XMFLOAT4 to_xmfloat4(const FbxDouble4& fbxdouble4)
 	return xmfloat4;
 }
 
+// FBXt@C1ǂݍ݁AFbxManagerƏLB
+// FBX SDK̓XbhZ[tł͂ȂA}l[W[LȂΕʁX̃t@CʁX̃Xbhœǂݍ߂B
+// }l[W[̍쐬Ɣj(vOC̓o^Ɖ)͔Ôߒɂ
+class fbx_document
+{
+	static std::mutex _mutex;
+	FbxManager* manager{ nullptr };
+
+public:
+	FbxScene* scene{ nullptr };
+
+	fbx_document(const char* fbx_filename, bool triangulate)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			manager = FbxManager::Create();
+		}
+		scene = FbxScene::Create(manager, "");
+		FbxImporter* fbx_importer{ FbxImporter::Create(manager, "") };
+		bool import_status{ false };
+		import_status = fbx_importer->Initialize(fbx_filename);
+		_ASSERT_EXPR_A(import_status, fbx_importer->GetStatus().GetErrorString());
+		import_status = fbx_importer->Import(scene);
+		_ASSERT_EXPR_A(import_status, fbx_importer->GetStatus().GetErrorString());
+
+		if (triangulate)
+		{
+			FbxGeometryConverter fbx_converter(manager);
+			fbx_converter.Triangulate(scene, true, false);
+			fbx_converter.RemoveBadPolygonsFromMeshes(scene);
+		}
+	}
+	~fbx_document()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		manager->Destroy();
+	}
+	fbx_document(const fbx_document&) = delete;
+	fbx_document& operator =(const fbx_document&) = delete;
+	fbx_document(fbx_document&&) noexcept = delete;
+	fbx_document& operator =(fbx_document&&) noexcept = delete;
+};
+std::mutex fbx_document::_mutex;
+
+// 0count-1܂ł̔ԍ[J[1zAfunction(ԍ)ɌĂԁBĂяõXbh[J[1ɂȂB
+// bVƂ̒_̎ô悤ɁAԍƂ̏ʂ傫قȂꍇɎg
+template<class F>
+void parallel_for_each_index(size_t count, F function)
+{
+	const size_t worker_count{ std::min<size_t>(std::max<size_t>(1, std::thread::hardware_concurrency()), count) };
+	std::atomic<size_t> next_index{ 0 };
+	auto work = [&]() {
+		for (size_t index = next_index++; index < count; index = next_index++)
+		{
+			function(index);
+		}
+	};
+	std::vector<std::future<void>> futures;
+	for (size_t worker_index = 1; worker_index < worker_count; ++worker_index)
+	{
+		futures.emplace_back(std::async(std::launch::async, work));
+	}
+	work();
+	for (std::future<void>& future : futures)
+	{
+		future.get();
+	}
+}
+
 // 
 struct bone_influence
 {
@@ -84,23 +172,187 @@ void fetch_bone_influences(const FbxMesh* fbx_mesh, std::vector<bone_influences_
 	}
 }
 
-void geometric_substance::fetch_scene(const char* fbx_filename, bool triangulate, float sampling_rate)
+// ʒuE@/ڐ/UVE{[̉erbgPʂňv钸_1ɂ܂Ƃ߁ACfbNXU蒼B
+// CfbNX̕т͕̂̂ςȂ̂ŁATuZbg͈̔͂ƃoEfBO{bNX͂̂܂܎gB
+void weld_vertices(geometric_substance::mesh& mesh)
 {
-	FbxManager* fbx_manager{ FbxManager::Create() };
-	FbxScene* fbx_scene{ FbxScene::Create(fbx_manager, "") };
-	FbxImporter* fbx_importer{ FbxImporter::Create(fbx_manager, "") };
-	bool import_status{ false };
-	import_status = fbx_importer->Initialize(fbx_filename);
-	_ASSERT_EXPR_A(import_status, fbx_importer->GetStatus().GetErrorString());
-	import_status = fbx_importer->Import(fbx_scene);
-	_ASSERT_EXPR_A(import_status, fbx_importer->GetStatus().GetErrorString());
+	using vertex_position = geometric_substance::vertex_position;
+	using vertex_extra_attribute = geometric_substance::vertex_extra_attribute;
+	using vertex_bone_influence = geometric_substance::vertex_bone_influence;
+	// pfBOƃnbVƔrsɂȂ
+	static_assert(sizeof(vertex_position) == 12 && sizeof(vertex_extra_attribute) == 36 && sizeof(vertex_bone_influence) == 32, "vertex layouts must not contain padding");
+
+	const size_t vertex_count{ mesh.vertex_positions.size() };
+	_ASSERT_EXPR(mesh.vertex_extra_attributes.size() == vertex_count && mesh.vertex_bone_influences.size() == vertex_count, L"All vertex streams must have the same length.");
+	if (vertex_count == 0)
+	{
+		return;
+	}
 
-	FbxGeometryConverter fbx_converter(fbx_manager);
-	if (triangulate)
+	// FNV-1a
+	auto hash{ [&](size_t vertex_index) {
+		uint64_t value{ 14695981039346656037ULL };
+		auto accumulate{ [&value](const void* data, size_t size) {
+			const uint8_t* bytes{ static_cast<const uint8_t*>(data) };
+			for (size_t i = 0; i < size; ++i)
+			{
+				value = (value ^ bytes[i]) * 1099511628211ULL;
+			}
+		} };
+		accumulate(&mesh.vertex_positions[vertex_index], sizeof(vertex_position));
+		accumulate(&mesh.vertex_extra_attributes[vertex_index], sizeof(vertex_extra_attribute));
+		accumulate(&mesh.vertex_bone_influences[vertex_index], sizeof(vertex_bone_influence));
+		return value;
+	} };
+	auto equal{ [&](size_t a, size_t b) {
+		return memcmp(&mesh.vertex_positions[a], &mesh.vertex_positions[b], sizeof(vertex_position)) == 0 &&
+			memcmp(&mesh.vertex_extra_attributes[a], &mesh.vertex_extra_attributes[b], sizeof(vertex_extra_attribute)) == 0 &&
+			memcmp(&mesh.vertex_bone_influences[a], &mesh.vertex_bone_influences[b], sizeof(vertex_bone_influence)) == 0;
+	} };
+
+	// I[vAhX@̃nbV\Bi[̂͗nڌ̒_ԍ
+	size_t table_size{ 1 };
+	while (table_size < vertex_count * 2)
+	{
+		table_size <<= 1;
+	}
+	const uint32_t empty{ UINT32_MAX };
+	std::vector<uint32_t> table(table_size, empty);
+	std::vector<uint32_t> remap(vertex_count);
+
+	// nڌ̒_͑Ol߂œzɏ߂(ݐ͏ɓǂݏoʒuȉ)
+	uint32_t welded_count{ 0 };
+	for (size_t vertex_index = 0; vertex_index < vertex_count; ++vertex_index)
 	{
-		fbx_converter.Triangulate(fbx_scene, true, false);
-		fbx_converter.RemoveBadPolygonsFromMeshes(fbx_scene);
+		size_t slot{ static_cast<size_t>(hash(vertex_index)) & (table_size - 1) };
+		while (table.at(slot) != empty && !equal(table.at(slot), vertex_index))
+		{
+			slot = (slot + 1) & (table_size - 1);
+		}
+		if (table.at(slot) == empty)
+		{
+			table.at(slot) = welded_count;
+			mesh.vertex_positions[welded_count] = mesh.vertex_positions[vertex_index];
+			mesh.vertex_extra_attributes[welded_count] = mesh.vertex_extra_attributes[vertex_index];
+			mesh.vertex_bone_influences[welded_count] = mesh.vertex_bone_influences[vertex_index];
+			++welded_count;
+		}
+		remap.at(vertex_index) = table.at(slot);
 	}
+	for (uint32_t& index : mesh.indices)
+	{
+		index = remap.at(index);
+	}
+
+	mesh.vertex_positions.resize(welded_count);
+	mesh.vertex_extra_attributes.resize(welded_count);
+	mesh.vertex_bone_influences.resize(welded_count);
+	mesh.vertex_positions.shrink_to_fit();
+	mesh.vertex_extra_attributes.shrink_to_fit();
+	mesh.vertex_bone_influences.shrink_to_fit();
+}
+
+template<class T>
+void remap_vertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap)
+{
+	std::vector<T> remapped_vertices(vertices.size());
+	for (size_t vertex_index = 0; vertex_index < vertices.size(); ++vertex_index)
+	{
+		remapped_vertices.at(remap.at(vertex_index)) = vertices.at(vertex_index);
+	}
+	vertices.swap(remapped_vertices);
+}
+
+inline int16_t to_snorm16(float value)
+{
+	return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+inline float from_snorm16(int16_t value)
+{
+	// -32768-32767Ɠ-1ɂȂ(D3D11SNORM̋K)
+	return std::max<float>(value / 32767.0f, -1.0f);
+}
+geometric_substance::compact_vertex_extra_attribute geometric_substance::compress(const vertex_extra_attribute& vertex)
+{
+	compact_vertex_extra_attribute compact_vertex;
+	compact_vertex.normal[0] = to_snorm16(vertex.normal.x);
+	compact_vertex.normal[1] = to_snorm16(vertex.normal.y);
+	compact_vertex.normal[2] = to_snorm16(vertex.normal.z);
+	compact_vertex.normal[3] = to_snorm16(1.0f);
+	compact_vertex.tangent[0] = to_snorm16(vertex.tangent.x);
+	compact_vertex.tangent[1] = to_snorm16(vertex.tangent.y);
+	compact_vertex.tangent[2] = to_snorm16(vertex.tangent.z);
+	compact_vertex.tangent[3] = to_snorm16(vertex.tangent.w);
+	compact_vertex.texcoord[0] = PackedVector::XMConvertFloatToHalf(vertex.texcoord.x);
+	compact_vertex.texcoord[1] = PackedVector::XMConvertFloatToHalf(vertex.texcoord.y);
+	return compact_vertex;
+}
+geometric_substance::compact_float_texcoord_vertex_extra_attribute geometric_substance::compress_float_texcoord(const vertex_extra_attribute& vertex)
+{
+	const compact_vertex_extra_attribute compact_vertex{ compress(vertex) };
+	compact_float_texcoord_vertex_extra_attribute float_texcoord_vertex;
+	std::copy(std::begin(compact_vertex.normal), std::end(compact_vertex.normal), float_texcoord_vertex.normal);
+	std::copy(std::begin(compact_vertex.tangent), std::end(compact_vertex.tangent), float_texcoord_vertex.tangent);
+	float_texcoord_vertex.texcoord = vertex.texcoord;
+	return float_texcoord_vertex;
+}
+geometric_substance::compact_vertex_bone_influence geometric_substance::compress(const vertex_bone_influence& vertex)
+{
+	compact_vertex_bone_influence compact_vertex{};
+	// ۂ߂d݂̍v̍v炸Ȃ悤A덷͍ł傫d݂Ɋ񂹂
+	int quantized_sum{ 0 };
+	float weight_sum{ 0 };
+	float largest_weight{ -1.0f };
+	size_t largest{ 0 };
+	for (size_t influence_index = 0; influence_index < MAX_BONE_INFLUENCES; ++influence_index)
+	{
+		_ASSERT_EXPR(vertex.bone_indices[influence_index] < MAX_BONES, L"The bone index is out of range.");
+		const float weight{ std::clamp(vertex.bone_weights[influence_index], 0.0f, 1.0f) };
+		compact_vertex.bone_weights[influence_index] = static_cast<uint8_t>(std::lround(weight * 255.0f));
+		compact_vertex.bone_indices[influence_index] = static_cast<uint8_t>(vertex.bone_indices[influence_index]);
+		quantized_sum += compact_vertex.bone_weights[influence_index];
+		weight_sum += weight;
+		if (weight > largest_weight)
+		{
+			largest_weight = weight;
+			largest = influence_index;
+		}
+	}
+	const int error{ static_cast<int>(std::lround(weight_sum * 255.0f)) - quantized_sum };
+	compact_vertex.bone_weights[largest] = static_cast<uint8_t>(std::clamp(compact_vertex.bone_weights[largest] + error, 0, 255));
+	return compact_vertex;
+}
+geometric_substance::vertex_extra_attribute geometric_substance::decompress(const compact_vertex_extra_attribute& compact_vertex)
+{
+	vertex_extra_attribute vertex;
+	vertex.normal = { from_snorm16(compact_vertex.normal[0]), from_snorm16(compact_vertex.normal[1]), from_snorm16(compact_vertex.normal[2]) };
+	vertex.tangent = { from_snorm16(compact_vertex.tangent[0]), from_snorm16(compact_vertex.tangent[1]), from_snorm16(compact_vertex.tangent[2]), from_snorm16(compact_vertex.tangent[3]) };
+	vertex.texcoord = { PackedVector::XMConvertHalfToFloat(compact_vertex.texcoord[0]), PackedVector::XMConvertHalfToFloat(compact_vertex.texcoord[1]) };
+	return vertex;
+}
+geometric_substance::vertex_extra_attribute geometric_substance::decompress(const compact_float_texcoord_vertex_extra_attribute& compact_vertex)
+{
+	vertex_extra_attribute vertex;
+	vertex.normal = { from_snorm16(compact_vertex.normal[0]), from_snorm16(compact_vertex.normal[1]), from_snorm16(compact_vertex.normal[2]) };
+	vertex.tangent = { from_snorm16(compact_vertex.tangent[0]), from_snorm16(compact_vertex.tangent[1]), from_snorm16(compact_vertex.tangent[2]), from_snorm16(compact_vertex.tangent[3]) };
+	vertex.texcoord = compact_vertex.texcoord;
+	return vertex;
+}
+geometric_substance::vertex_bone_influence geometric_substance::decompress(const compact_vertex_bone_influence& compact_vertex)
+{
+	vertex_bone_influence vertex;
+	for (size_t influence_index = 0; influence_index < MAX_BONE_INFLUENCES; ++influence_index)
+	{
+		vertex.bone_weights[influence_index] = compact_vertex.bone_weights[influence_index] / 255.0f;
+		vertex.bone_indices[influence_index] = compact_vertex.bone_indices[influence_index];
+	}
+	return vertex;
+}
+
+void geometric_substance::fetch_scene(const char* fbx_filename, bool triangulate, float sampling_rate)
+{
+	const fbx_document document(fbx_filename, triangulate);
+	FbxScene* fbx_scene{ document.scene };
 
 	// V[OtŜVACY
 	std::function<void(FbxNode*)> traverse{ [&](FbxNode* fbx_node) {
@@ -120,6 +372,7 @@ void geometric_substance::fetch_scene(const char* fbx_filename, bool triangulate
 				node.attribute = fbx_node->GetNodeAttribute()->GetAttributeType();
 				node.name = fbx_node->GetName();
 				node.unique_id = fbx_node->GetUniqueID();
+				scene_view.indices.emplace(node.unique_id, scene_view.nodes.size() - 1);
 				node.parent_index = scene_view.indexof(fbx_node->GetParent() ? fbx_node->GetParent()->GetUniqueID() : 0);
 				break;
 			}
@@ -129,6 +382,7 @@ void geometric_substance::fetch_scene(const char* fbx_filename, bool triangulate
 		node.attribute = fbx_node->GetNodeAttribute() ? fbx_node->GetNodeAttribute()->GetAttributeType() : FbxNodeAttribute::EType::eUnknown;
 		node.name = fbx_node->GetName();
 		node.unique_id = fbx_node->GetUniqueID();
+		scene_view.indices.emplace(node.unique_id, scene_view.nodes.size() - 1);
 		node.parent_index = scene_view.indexof(fbx_node->GetParent() ? fbx_node->GetParent()->GetUniqueID() : 0);
 #endif
 		for (int child_index = 0; child_index < fbx_node->GetChildCount(); ++child_index)
@@ -147,38 +401,72 @@ void geometric_substance::fetch_scene(const char* fbx_filename, bool triangulate
 	float sampling_rate{ 0 };
 #endif
 	fetch_animations(fbx_scene, animation_clips, sampling_rate);
-
-
-	fbx_manager->Destroy();
 }
 
 
-geometric_substance::geometric_substance(ID3D11Device* device, const char* fbx_filename, const std::vector<std::string>& animation_filenames, bool triangulate, float sampling_rate, bool avoid_create_com_objects/*UNIT.99*/)
+geometric_substance::geometric_substance(ID3D11Device* device, const char* fbx_filename, const std::vector<std::string>& animation_filenames, bool triangulate, float sampling_rate, bool avoid_create_com_objects/*UNIT.99*/,
+	vertex_format vertex_format, bool require_vertex_format) : format(vertex_format)
 {
-	std::filesystem::path cereal_filename(fbx_filename);
-	cereal_filename.replace_extension("cereal");
-	if (std::filesystem::exists(cereal_filename.c_str()))
+	// FBXAj[V̈ꗗςAÂLbVg킸ɍ蒼B
+	// ẽnbV̓t@CSǂނ̂ŁA傫ƍXVLbVƈႤƂ߂
+	signature.source_stamp = stamp_sources(fbx_filename, animation_filenames);
+	signature.triangulate = triangulate;
+	signature.sampling_rate = sampling_rate;
+	signature.animation_filenames = animation_filenames;
+
+	std::filesystem::path substance_filename(fbx_filename);
+	substance_filename.replace_extension("substance");
+	if (load_substance(substance_filename, device, fbx_filename, avoid_create_com_objects, require_vertex_format))
 	{
-		std::ifstream ifs(cereal_filename.c_str(), std::ios::binary);
-		cereal::BinaryInputArchive deserialization(ifs);
-		deserialization(scene_view, meshes, materials, animation_clips);
+		if (signature.stale_stamp)
+		{
+			restamp_substance(substance_filename);
+		}
+		return;
 	}
-	else
+
+	std::filesystem::path cereal_filename(fbx_filename);
+	cereal_filename.replace_extension("cereal");
+	if (!load_cereal(cereal_filename, fbx_filename))
 	{
+		// Aj[Vt@C̓t@CƂɕʂFbxManager(fbx_document)œǂݍ݁ATvO܂Ń[J[XbhōsB
+		// TvOscene_view̃m[hĝŁAV[ǂݍݏI܂ő҂
+		std::promise<void> scene_fetched;
+		const std::shared_future<void> scene_ready{ scene_fetched.get_future().share() };
+		std::vector<std::future<std::vector<animation>>> animation_files;
+		for (const std::string& animation_filename : animation_filenames)
+		{
+			animation_files.emplace_back(std::async(std::launch::async, [this, scene_ready, sampling_rate](std::string animation_filename) {
+				const fbx_document document(animation_filename.c_str(), false);
+				scene_ready.get(); // V[̓ǂݍ݂OŏIꍇ͂Ŕ
+				std::vector<animation> file_animation_clips;
+				fetch_animations(document.scene, file_animation_clips, sampling_rate);
+				return file_animation_clips;
+			}, animation_filename));
+		}
+
 		//V[̓ǂݍ
 		fetch_scene(fbx_filename, triangulate, sampling_rate);
+		scene_fetched.set_value();
 
-		//Aj[Vt@C̒ǉ
-		for (const std::string animation_filename : animation_filenames)
+		//Aj[Vt@C̒ǉBNbv͈̏ɕׂ
+		for (std::future<std::vector<animation>>& animation_file : animation_files)
 		{
-			append_animations(animation_filename.c_str(), sampling_rate);
+			for (animation& animation_clip : animation_file.get())
+			{
+				animation_clips.push_back(std::move(animation_clip));
+			}
 		}
 
-		
-		std::ofstream ofs(cereal_filename.c_str(), std::ios::binary);
-		cereal::BinaryOutputArchive serialization(ofs);
-		serialization(scene_view, meshes, materials, animation_clips);
+		signature.resolve_source_hash(fbx_filename);
+		save_cereal(cereal_filename);
 	}
+	bake_meshes(fbx_filename);
+	// Nbv͏ĂƂɈk.substanceɓĂAs͓ǂݍނɂB
+	// ̃L[t[.substanceɓȂ̂ŁAǂݍ񂾂ƂƓɂȂ悤Ŏ̂Ă
+	compress_animations({}, true/*discard_keyframes*/);
+	save_substance(substance_filename);
+
 	//IuWFNg̍쐬𐧌
 	if (!avoid_create_com_objects) 
 	{
@@ -187,17 +475,731 @@ geometric_substance::geometric_substance(ID3D11Device* device, const char* fbx_f
 
 }
 
+uint64_t geometric_substance::hash_sources(const char* fbx_filename, const std::vector<std::string>& animation_filenames)
+{
+	uint64_t hash{ 0xCBF29CE484222325ull };
+	auto combine = [&](const char* filename) {
+		const mapped_file file(filename);
+		if (!file.data())
+		{
+			return false;
+		}
+		hash = (hash ^ content_hash(file.data(), file.size())) * 0x100000001B3ull;
+		return true;
+	};
+	if (!combine(fbx_filename))
+	{
+		return 0;
+	}
+	for (const std::string& animation_filename : animation_filenames)
+	{
+		if (!combine(animation_filename.c_str()))
+		{
+			return 0;
+		}
+	}
+	return hash != 0 ? hash : 1;
+}
 
-void geometric_substance::fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& meshes)
+uint64_t geometric_substance::stamp_sources(const char* fbx_filename, const std::vector<std::string>& animation_filenames)
+{
+	uint64_t stamp{ 0xCBF29CE484222325ull };
+	auto combine = [&](const char* filename) {
+		std::error_code error;
+		const uintmax_t size{ std::filesystem::file_size(filename, error) };
+		if (error)
+		{
+			return false;
+		}
+		const std::filesystem::file_time_type write_time{ std::filesystem::last_write_time(filename, error) };
+		if (error)
+		{
+			return false;
+		}
+		stamp = (stamp ^ static_cast<uint64_t>(size)) * 0x100000001B3ull;
+		stamp = (stamp ^ static_cast<uint64_t>(write_time.time_since_epoch().count())) * 0x100000001B3ull;
+		return true;
+	};
+	if (!combine(fbx_filename))
+	{
+		return 0;
+	}
+	for (const std::string& animation_filename : animation_filenames)
+	{
+		if (!combine(animation_filename.c_str()))
+		{
+			return 0;
+		}
+	}
+	return stamp != 0 ? stamp : 1;
+}
+
+bool geometric_substance::load_cereal(const std::filesystem::path& filename, const char* fbx_filename)
+{
+	if (!std::filesystem::exists(filename))
+	{
+		return false;
+	}
+	// rŐ؂ꂽꂽ肵.cerealcerealO𓊂̂ŁAǂ݂̃o[ɖ߂FBXǂݒ
+	try
+	{
+		std::ifstream ifs(filename, std::ios::binary);
+		cereal::BinaryInputArchive deserialization(ifs);
+		// ̂ȂÂ`ł͐擪z̗vfɂȂ̂ŁACEREAL_MAGICƈvȂ
+		uint32_t magic{ 0 };
+		uint32_t version{ 0 };
+		deserialization(magic, version);
+		if (magic != CEREAL_MAGIC || version != CEREAL_VERSION)
+		{
+			return false;
+		}
+		source_signature cached_signature;
+		deserialization(cached_signature);
+		if (!signature.accepts(cached_signature, fbx_filename))
+		{
+			return false;
+		}
+		deserialization(scene_view, meshes, materials, animation_clips);
+	}
+	catch (const std::exception&)
+	{
+		scene_view = {};
+		meshes.clear();
+		materials.clear();
+		animation_clips.clear();
+		return false;
+	}
+	return true;
+}
+
+void geometric_substance::save_cereal(const std::filesystem::path& filename) const
+{
+	std::ofstream ofs(filename, std::ios::binary);
+	cereal::BinaryOutputArchive serialization(ofs);
+	const uint32_t magic{ CEREAL_MAGIC };
+	const uint32_t version{ CEREAL_VERSION };
+	serialization(magic, version, signature, scene_view, meshes, materials, animation_clips);
+}
+
+// .cerealFBXo܂܂̃f[^Ȃ̂ŁA.substanceɏĂOɂōœK
+void geometric_substance::bake_meshes(const char* fbx_filename)
+{
+	baked_vertex_cache_statistics[0] = {};
+	baked_vertex_cache_statistics[1] = {};
+	for (mesh& mesh : meshes)
+	{
+		// |S̊pƂɍ_L_ɂ܂Ƃ߁A{̃CfbNXtbVɂ
+		weld_vertices(mesh);
+
+		// }eAƂ͈̔͂A܂ܕۂ悤AOp`̕בւ̓TuZbg̒ōs
+		const size_t vertex_count{ mesh.vertex_positions.size() };
+		for (const mesh::subset& subset : mesh.subsets)
+		{
+			_ASSERT_EXPR(static_cast<size_t>(subset.start_index_location) + subset.index_count <= mesh.indices.size(), L"The subset is out of the index buffer.");
+			uint32_t* indices{ mesh.indices.data() + subset.start_index_location };
+			baked_vertex_cache_statistics[0] += analyze_vertex_cache(indices, subset.index_count, vertex_count);
+			optimize_vertex_cache(indices, subset.index_count, vertex_count);
+			optimize_overdraw(indices, subset.index_count, &mesh.vertex_positions.data()->position.x, sizeof(vertex_position), vertex_count);
+			baked_vertex_cache_statistics[1] += analyze_vertex_cache(indices, subset.index_count, vertex_count);
+		}
+
+		// _ŏɎQƂ鏇ɕגA_tFb`̃ANZXA
+		const std::vector<uint32_t> remap{ optimize_vertex_fetch(mesh.indices.data(), mesh.indices.size(), vertex_count) };
+		remap_vertices(mesh.vertex_positions, remap);
+		remap_vertices(mesh.vertex_extra_attributes, remap);
+		remap_vertices(mesh.vertex_bone_influences, remap);
+	}
+
+	// ^Cn`ȂǂUV[0, 1]傫AFLOAT16ɋl߂ƃeNX`̂ŁAUVfloat̂܂܎`ɂ
+	if (format == vertex_format::compact)
+	{
+		float texcoord_extent{ 0.0f };
+		for (const mesh& mesh : meshes)
+		{
+			for (const vertex_extra_attribute& vertex : mesh.vertex_extra_attributes)
+			{
+				texcoord_extent = std::max({ texcoord_extent, fabsf(vertex.texcoord.x), fabsf(vertex.texcoord.y) });
+			}
+		}
+		if (texcoord_extent > HALF_TEXCOORD_LIMIT)
+		{
+			format = vertex_format::compact_float_texcoord;
+			OutputDebugStringA((std::string(fbx_filename) + " UV:" + std::to_string(texcoord_extent) + " exceeds the FLOAT16 limit, keeping float UVs.\n").c_str());
+		}
+	}
+
+	OutputDebugStringA((std::string(fbx_filename) +
+		" ACMR:" + std::to_string(baked_vertex_cache_statistics[0].acmr()) + "->" + std::to_string(baked_vertex_cache_statistics[1].acmr()) +
+		" ATVR:" + std::to_string(baked_vertex_cache_statistics[0].atvr()) + "->" + std::to_string(baked_vertex_cache_statistics[1].atvr()) + '\n').c_str());
+}
+
+// .substancet@C̍\B擪flat_substance_headeruAϒ̃f[^ׂ͂flat_spanŎQƂ
+struct flat_scene_node
+{
+	uint64_t unique_id;
+	flat_span<char> name;
+	int32_t attribute;
+	int64_t parent_index;
+};
+struct flat_bone
+{
+	uint64_t unique_id;
+	flat_span<char> name;
+	int64_t parent_index;
+	int64_t node_index;
+	XMFLOAT4X4 offset_transform;
+};
+struct flat_subset
+{
+	uint64_t material_unique_id;
+	flat_span<char> material_name;
+	uint32_t start_index_location;
+	uint32_t index_count;
+};
+struct flat_mesh
 {
+	uint64_t unique_id;
+	flat_span<char> name;
+	int64_t node_index;
+	flat_span<flat_subset> subsets;
+	XMFLOAT4X4 default_global_transform;
+	XMFLOAT4X4 geometric_transform;
+	flat_span<flat_bone> bones;
+	XMFLOAT3 bounding_box[2];
+	flat_span<geometric_substance::vertex_position> vertex_positions;
+	flat_span<geometric_substance::vertex_extra_attribute> vertex_extra_attributes;
+	flat_span<geometric_substance::vertex_bone_influence> vertex_bone_influences;
+	// compactŏĂꍇ͏2ɂȂAɓ
+	flat_span<geometric_substance::compact_vertex_extra_attribute> compact_vertex_extra_attributes;
+	flat_span<geometric_substance::compact_vertex_bone_influence> compact_vertex_bone_influences;
+	flat_span<geometric_substance::compact_float_texcoord_vertex_extra_attribute> compact_float_texcoord_vertex_extra_attributes; // compact_float_texcoord̏ꍇ
+	flat_span<uint32_t> indices;
+};
+struct flat_material
+{
+	uint64_t unique_id;
+	flat_span<char> name;
+	XMFLOAT4 ambient;
+	XMFLOAT4 diffuse;
+	XMFLOAT4 specular;
+	XMFLOAT4 reflection;
+	XMFLOAT4 emissive;
+	flat_span<char> texture_filenames[4];
+};
+struct flat_animation
+{
+	flat_span<char> name;
+	float sampling_rate;
+	flat_span<flat_span<animation::keyframe::node>> sequence;
+};
+struct flat_compressed_animation
+{
+	flat_span<char> name;
+	float sampling_rate;
+	uint32_t frame_count;
+	flat_span<compressed_animation::track> tracks;
+	flat_span<uint16_t> key_frames;
+	flat_span<uint16_t> key_values;
+};
+struct flat_substance_header
+{
+	char magic[4]{ 'G', 'S', 'U', 'B' };
+	uint32_t version{ geometric_substance::SUBSTANCE_VERSION };
+	// \̂̔zuقȂrhŏot@C͓ǂ܂Ȃ
+	uint32_t record_sizes[8]{
+		sizeof(geometric_substance::vertex_position),
+		sizeof(geometric_substance::vertex_extra_attribute),
+		sizeof(geometric_substance::vertex_bone_influence),
+		sizeof(geometric_substance::compact_vertex_extra_attribute),
+		sizeof(geometric_substance::compact_vertex_bone_influence),
+		sizeof(geometric_substance::compact_float_texcoord_vertex_extra_attribute),
+		sizeof(animation::keyframe::node),
+		sizeof(compressed_animation::track) };
+	uint64_t file_size{ 0 };
+	uint32_t vertex_format{ 0 }; // geometric_substance::vertex_format
+
+	// geometric_substance::source_signature
+	uint64_t source_stamp{ 0 };
+	uint64_t source_hash{ 0 };
+	uint32_t triangulate{ 0 };
+	float sampling_rate{ 0 };
+	flat_span<flat_span<char>> animation_filenames;
+
+	flat_span<flat_scene_node> nodes;
+	flat_span<flat_mesh> meshes;
+	flat_span<flat_material> materials;
+	flat_span<flat_animation> animations;
+	flat_span<flat_compressed_animation> compressed_animations;
+
+	vertex_cache_statistics vertex_cache_statistics[2]; // 0:œKOA1:œK
+};
+
+void geometric_substance::save_substance(const std::filesystem::path& filename) const
+{
+	flat_writer writer;
+	const flat_span<flat_substance_header> header_span{ writer.reserve<flat_substance_header>(1) };
+	flat_substance_header header;
+
+	std::vector<flat_scene_node> flat_nodes;
 	for (const scene::node& node : scene_view.nodes)
 	{
+		flat_nodes.push_back({ node.unique_id, writer.write(node.name), static_cast<int32_t>(node.attribute), node.parent_index });
+	}
+	header.nodes = writer.write(flat_nodes);
+
+	std::vector<flat_mesh> flat_meshes;
+	for (const mesh& mesh : meshes)
+	{
+		flat_mesh& flat_mesh{ flat_meshes.emplace_back() };
+		flat_mesh.unique_id = mesh.unique_id;
+		flat_mesh.name = writer.write(mesh.name);
+		flat_mesh.node_index = mesh.node_index;
+
+		std::vector<flat_subset> flat_subsets;
+		for (const mesh::subset& subset : mesh.subsets)
+		{
+			flat_subsets.push_back({ subset.material_unique_id, writer.write(subset.material_name), subset.start_index_location, subset.index_count });
+		}
+		flat_mesh.subsets = writer.write(flat_subsets);
+
+		flat_mesh.default_global_transform = mesh.default_global_transform;
+		flat_mesh.geometric_transform = mesh.geometric_transform;
+
+		std::vector<flat_bone> flat_bones;
+		for (const skeleton::bone& bone : mesh.bind_pose.bones)
+		{
+			flat_bones.push_back({ bone.unique_id, writer.write(bone.name), bone.parent_index, bone.node_index, bone.offset_transform });
+		}
+		flat_mesh.bones = writer.write(flat_bones);
+
+		flat_mesh.bounding_box[0] = mesh.bounding_box[0];
+		flat_mesh.bounding_box[1] = mesh.bounding_box[1];
+		flat_mesh.vertex_positions = writer.write(mesh.vertex_positions);
+		if (is_compact(format))
+		{
+			if (format == vertex_format::compact_float_texcoord)
+			{
+				std::vector<compact_float_texcoord_vertex_extra_attribute> compact_extra_attributes;
+				for (const vertex_extra_attribute& vertex : mesh.vertex_extra_attributes)
+				{
+					compact_extra_attributes.push_back(compress_float_texcoord(vertex));
+				}
+				flat_mesh.compact_float_texcoord_vertex_extra_attributes = writer.write(compact_extra_attributes);
+			}
+			else
+			{
+				std::vector<compact_vertex_extra_attribute> compact_extra_attributes;
+				for (const vertex_extra_attribute& vertex : mesh.vertex_extra_attributes)
+				{
+					compact_extra_attributes.push_back(compress(vertex));
+				}
+				flat_mesh.compact_vertex_extra_attributes = writer.write(compact_extra_attributes);
+			}
+			std::vector<compact_vertex_bone_influence> compact_bone_influences;
+			for (const vertex_bone_influence& vertex : mesh.vertex_bone_influences)
+			{
+				compact_bone_influences.push_back(compress(vertex));
+			}
+			flat_mesh.compact_vertex_bone_influences = writer.write(compact_bone_influences);
+		}
+		else
+		{
+			flat_mesh.vertex_extra_attributes = writer.write(mesh.vertex_extra_attributes);
+			flat_mesh.vertex_bone_influences = writer.write(mesh.vertex_bone_influences);
+		}
+		flat_mesh.indices = writer.write(mesh.indices);
+	}
+	header.meshes = writer.write(flat_meshes);
+
+	std::vector<flat_material> flat_materials;
+	for (const std::pair<const uint64_t, material>& element : materials)
+	{
+		const material& material{ element.second };
+		flat_material& flat_material{ flat_materials.emplace_back() };
+		flat_material.unique_id = material.unique_id;
+		flat_material.name = writer.write(material.name);
+		flat_material.ambient = material.ambient;
+		flat_material.diffuse = material.diffuse;
+		flat_material.specular = material.specular;
+		flat_material.reflection = material.reflection;
+		flat_material.emissive = material.emissive;
+		for (size_t texture_index = 0; texture_index < 4; ++texture_index)
+		{
+			flat_material.texture_filenames[texture_index] = writer.write(material.texture_filenames[texture_index]);
+		}
+	}
+	header.materials = writer.write(flat_materials);
+
+	// kNbv΍Đɂ͂ꂾĝŁÃL[t[(m[hƂglobal_transform܂)͓ꂸOsampling_ratec
+	const bool has_compressed_animations{ !compressed_animation_clips.empty() };
+	std::vector<flat_animation> flat_animations;
+	for (const animation& animation_clip : animation_clips)
+	{
+		std::vector<flat_span<animation::keyframe::node>> sequence;
+		if (!has_compressed_animations)
+		{
+			for (const animation::keyframe& keyframe : animation_clip.sequence)
+			{
+				sequence.push_back(writer.write(keyframe.nodes));
+			}
+		}
+		flat_animations.push_back({ writer.write(animation_clip.name), animation_clip.sampling_rate, writer.write(sequence) });
+	}
+	header.animations = writer.write(flat_animations);
+
+	std::vector<flat_compressed_animation> flat_compressed_animations;
+	for (const compressed_animation& animation_clip : compressed_animation_clips)
+	{
+		flat_compressed_animations.push_back({ writer.write(animation_clip.name), animation_clip.sampling_rate, animation_clip.frame_count,
+			writer.write(animation_clip.tracks), writer.write(animation_clip.key_frames), writer.write(animation_clip.key_values) });
+	}
+	header.compressed_animations = writer.write(flat_compressed_animations);
+
+	header.vertex_format = static_cast<uint32_t>(format);
+	header.source_stamp = signature.source_stamp;
+	header.source_hash = signature.source_hash;
+	header.triangulate = signature.triangulate ? 1 : 0;
+	header.sampling_rate = signature.sampling_rate;
+	std::vector<flat_span<char>> animation_filenames;
+	for (const std::string& animation_filename : signature.animation_filenames)
+	{
+		animation_filenames.push_back(writer.write(animation_filename));
+	}
+	header.animation_filenames = writer.write(animation_filenames);
+	header.vertex_cache_statistics[0] = baked_vertex_cache_statistics[0];
+	header.vertex_cache_statistics[1] = baked_vertex_cache_statistics[1];
+
+	header.file_size = writer.size();
+	writer.patch(header_span, header);
+	writer.save(filename);
+}
+
+void geometric_substance::restamp_substance(const std::filesystem::path& filename) const
+{
+	std::fstream fs(filename, std::ios::in | std::ios::out | std::ios::binary);
+	fs.seekp(offsetof(flat_substance_header, source_stamp));
+	fs.write(reinterpret_cast<const char*>(&signature.source_stamp), sizeof(signature.source_stamp));
+}
+
+bool geometric_substance::load_substance(const std::filesystem::path& filename, ID3D11Device* device, const char* fbx_filename, bool avoid_create_com_objects, bool require_vertex_format)
+{
+	if (!std::filesystem::exists(filename))
+	{
+		return false;
+	}
+	const mapped_file file(filename);
+	const flat_reader reader(file.data(), file.size());
+
+	const flat_substance_header expected_header;
+	const flat_substance_header* header{ reader.data(flat_span<flat_substance_header>{ 0, 1 }) };
+	if (!header ||
+		memcmp(header->magic, expected_header.magic, sizeof(expected_header.magic)) != 0 ||
+		header->version != expected_header.version ||
+		memcmp(header->record_sizes, expected_header.record_sizes, sizeof(expected_header.record_sizes)) != 0 ||
+		header->file_size != file.size() ||
+		header->vertex_format > static_cast<uint32_t>(vertex_format::compact_float_texcoord))
+	{
+		return false;
+	}
+	// CPUŎgȂǂ̌`ł悢(collision_mesh.substanceǂłĂNȂ悤)
+	source_signature cached_signature;
+	cached_signature.source_stamp = header->source_stamp;
+	cached_signature.source_hash = header->source_hash;
+	cached_signature.triangulate = header->triangulate != 0;
+	cached_signature.sampling_rate = header->sampling_rate;
+	const flat_span<char>* flat_animation_filenames{ reader.data(header->animation_filenames) };
+	if (!flat_animation_filenames)
+	{
+		return false;
+	}
+	for (size_t filename_index = 0; filename_index < header->animation_filenames.count; ++filename_index)
+	{
+		cached_signature.animation_filenames.push_back(reader.string(flat_animation_filenames[filename_index]));
+	}
+	if (!signature.accepts(cached_signature, fbx_filename))
+	{
+		return false;
+	}
+	const vertex_format stored_format{ static_cast<vertex_format>(header->vertex_format) };
+	// compactw肵ꍇ́AĂƂUV͈̔͂compact_float_texcoordɂt@Ĉ܂܎gB
+	// bake_toolGPU֓]ȂAwƈႤ`̃LbVcȂ悤require_vertex_formatŏƍ
+	const bool compatible_format{ stored_format == format || (format == vertex_format::compact && stored_format == vertex_format::compact_float_texcoord) };
+	if ((!avoid_create_com_objects || require_vertex_format) && !compatible_format)
+	{
+		return false;
+	}
+	const flat_scene_node* flat_nodes{ reader.data(header->nodes) };
+	const flat_mesh* flat_meshes{ reader.data(header->meshes) };
+	const flat_material* flat_materials{ reader.data(header->materials) };
+	const flat_animation* flat_animations{ reader.data(header->animations) };
+	const flat_compressed_animation* flat_compressed_animations{ reader.data(header->compressed_animations) };
+	if (!flat_nodes || !flat_meshes || !flat_materials || !flat_animations || !flat_compressed_animations)
+	{
+		return false;
+	}
+
+	// rŉꂽf[^ꍇɃo[𒆓r[ȏԂɂȂ悤Aׂēǂ߂Ău
+	scene loaded_scene_view;
+	for (size_t node_index = 0; node_index < header->nodes.count; ++node_index)
+	{
+		const flat_scene_node& flat_node{ flat_nodes[node_index] };
+		scene::node& node{ loaded_scene_view.nodes.emplace_back() };
+		node.unique_id = flat_node.unique_id;
+		node.name = reader.string(flat_node.name);
+		node.attribute = static_cast<FbxNodeAttribute::EType>(flat_node.attribute);
+		node.parent_index = flat_node.parent_index;
+	}
+	loaded_scene_view.rebuild_indices();
+
+	std::vector<mesh> loaded_meshes(static_cast<size_t>(header->meshes.count));
+	std::vector<vertex_streams> streams(loaded_meshes.size());
+	for (size_t mesh_index = 0; mesh_index < loaded_meshes.size(); ++mesh_index)
+	{
+		const flat_mesh& flat_mesh{ flat_meshes[mesh_index] };
+		const flat_subset* flat_subsets{ reader.data(flat_mesh.subsets) };
+		const flat_bone* flat_bones{ reader.data(flat_mesh.bones) };
+		vertex_streams& stream{ streams.at(mesh_index) };
+		stream.positions = reader.data(flat_mesh.vertex_positions);
+		stream.vertex_count = static_cast<size_t>(flat_mesh.vertex_positions.count);
+		stream.indices = reader.data(flat_mesh.indices);
+		stream.index_count = static_cast<size_t>(flat_mesh.indices.count);
+		bool valid_attributes{ false };
+		if (stored_format == vertex_format::compact)
+		{
+			stream.compact_extra_attributes = reader.data(flat_mesh.compact_vertex_extra_attributes);
+			stream.compact_bone_influences = reader.data(flat_mesh.compact_vertex_bone_influences);
+			valid_attributes = stream.compact_extra_attributes && stream.compact_bone_influences &&
+				flat_mesh.compact_vertex_extra_attributes.count == stream.vertex_count && flat_mesh.compact_vertex_bone_influences.count == stream.vertex_count;
+		}
+		else if (stored_format == vertex_format::compact_float_texcoord)
+		{
+			stream.compact_float_texcoord_extra_attributes = reader.data(flat_mesh.compact_float_texcoord_vertex_extra_attributes);
+			stream.compact_bone_influences = reader.data(flat_mesh.compact_vertex_bone_influences);
+			valid_attributes = stream.compact_float_texcoord_extra_attributes && stream.compact_bone_influences &&
+				flat_mesh.compact_float_texcoord_vertex_extra_attributes.count == stream.vertex_count && flat_mesh.compact_vertex_bone_influences.count == stream.vertex_count;
+		}
+		else
+		{
+			stream.extra_attributes = reader.data(flat_mesh.vertex_extra_attributes);
+			stream.bone_influences = reader.data(flat_mesh.vertex_bone_influences);
+			valid_attributes = stream.extra_attributes && stream.bone_influences &&
+				flat_mesh.vertex_extra_attributes.count == stream.vertex_count && flat_mesh.vertex_bone_influences.count == stream.vertex_count;
+		}
+		if (!flat_subsets || !flat_bones || !stream.positions || !stream.indices || !valid_attributes)
+		{
+			return false;
+		}
+
+		mesh& mesh{ loaded_meshes.at(mesh_index) };
+		mesh.unique_id = flat_mesh.unique_id;
+		mesh.name = reader.string(flat_mesh.name);
+		mesh.node_index = flat_mesh.node_index;
+		for (size_t subset_index = 0; subset_index < flat_mesh.subsets.count; ++subset_index)
+		{
+			const flat_subset& flat_subset{ flat_subsets[subset_index] };
+			mesh::subset& subset{ mesh.subsets.emplace_back() };
+			subset.material_unique_id = flat_subset.material_unique_id;
+			subset.material_name = reader.string(flat_subset.material_name);
+			subset.start_index_location = flat_subset.start_index_location;
+			subset.index_count = flat_subset.index_count;
+		}
+		mesh.default_global_transform = flat_mesh.default_global_transform;
+		mesh.geometric_transform = flat_mesh.geometric_transform;
+		for (size_t bone_index = 0; bone_index < flat_mesh.bones.count; ++bone_index)
+		{
+			const flat_bone& flat_bone{ flat_bones[bone_index] };
+			skeleton::bone& bone{ mesh.bind_pose.bones.emplace_back() };
+			bone.unique_id = flat_bone.unique_id;
+			bone.name = reader.string(flat_bone.name);
+			bone.parent_index = flat_bone.parent_index;
+			bone.node_index = flat_bone.node_index;
+			bone.offset_transform = flat_bone.offset_transform;
+		}
+		mesh.bind_pose.rebuild_indices();
+		mesh.bounding_box[0] = flat_mesh.bounding_box[0];
+		mesh.bounding_box[1] = flat_mesh.bounding_box[1];
+
+		if (avoid_create_com_objects)
+		{
+			// GPU֓]Ȃꍇ(collision_meshȂ)͌Ăяo_ĝŕʂ
+			mesh.vertex_positions.assign(stream.positions, stream.positions + stream.vertex_count);
+			if (is_compact(stored_format))
+			{
+				mesh.vertex_extra_attributes.resize(stream.vertex_count);
+				mesh.vertex_bone_influences.resize(stream.vertex_count);
+				for (size_t vertex_index = 0; vertex_index < stream.vertex_count; ++vertex_index)
+				{
+					mesh.vertex_extra_attributes.at(vertex_index) = stream.compact_float_texcoord_extra_attributes ?
+						decompress(stream.compact_float_texcoord_extra_attributes[vertex_index]) : decompress(stream.compact_extra_attributes[vertex_index]);
+					mesh.vertex_bone_influences.at(vertex_index) = decompress(stream.compact_bone_influences[vertex_index]);
+				}
+			}
+			else
+			{
+				mesh.vertex_extra_attributes.assign(stream.extra_attributes, stream.extra_attributes + stream.vertex_count);
+				mesh.vertex_bone_influences.assign(stream.bone_influences, stream.bone_influences + stream.vertex_count);
+			}
+			mesh.indices.assign(stream.indices, stream.indices + stream.index_count);
+		}
+	}
+
+	std::unordered_map<uint64_t, material> loaded_materials;
+	for (size_t material_index = 0; material_index < header->materials.count; ++material_index)
+	{
+		const flat_material& flat_material{ flat_materials[material_index] };
+		material& material{ loaded_materials[flat_material.unique_id] };
+		material.unique_id = flat_material.unique_id;
+		material.name = reader.string(flat_material.name);
+		material.ambient = flat_material.ambient;
+		material.diffuse = flat_material.diffuse;
+		material.specular = flat_material.specular;
+		material.reflection = flat_material.reflection;
+		material.emissive = flat_material.emissive;
+		for (size_t texture_index = 0; texture_index < 4; ++texture_index)
+		{
+			material.texture_filenames[texture_index] = reader.string(flat_material.texture_filenames[texture_index]);
+		}
+	}
+
+	// L[t[͌Ăяoςstd::vectorƂĈ̂ŁAL[t[Ƃ1̈ꊇʂœǂݍ
+	std::vector<animation> loaded_animation_clips(static_cast<size_t>(header->animations.count));
+	for (size_t animation_index = 0; animation_index < loaded_animation_clips.size(); ++animation_index)
+	{
+		const flat_animation& flat_animation{ flat_animations[animation_index] };
+		const flat_span<animation::keyframe::node>* flat_sequence{ reader.data(flat_animation.sequence) };
+		if (!flat_sequence)
+		{
+			return false;
+		}
+		animation& animation_clip{ loaded_animation_clips.at(animation_index) };
+		animation_clip.name = reader.string(flat_animation.name);
+		animation_clip.sampling_rate = flat_animation.sampling_rate;
+		animation_clip.sequence.resize(static_cast<size_t>(flat_animation.sequence.count));
+		for (size_t keyframe_index = 0; keyframe_index < animation_clip.sequence.size(); ++keyframe_index)
+		{
+			const animation::keyframe::node* nodes{ reader.data(flat_sequence[keyframe_index]) };
+			if (!nodes)
+			{
+				return false;
+			}
+			animation_clip.sequence.at(keyframe_index).nodes.assign(nodes, nodes + flat_sequence[keyframe_index].count);
+		}
+	}
+
+	std::vector<compressed_animation> loaded_compressed_animation_clips(static_cast<size_t>(header->compressed_animations.count));
+	for (size_t animation_index = 0; animation_index < loaded_compressed_animation_clips.size(); ++animation_index)
+	{
+		const flat_compressed_animation& flat_animation{ flat_compressed_animations[animation_index] };
+		const compressed_animation::track* tracks{ reader.data(flat_animation.tracks) };
+		const uint16_t* key_frames{ reader.data(flat_animation.key_frames) };
+		const uint16_t* key_values{ reader.data(flat_animation.key_values) };
+		if (!tracks || !key_frames || !key_values || flat_animation.key_values.count != flat_animation.key_frames.count * 3)
+		{
+			return false;
+		}
+		compressed_animation& animation_clip{ loaded_compressed_animation_clips.at(animation_index) };
+		animation_clip.name = reader.string(flat_animation.name);
+		animation_clip.sampling_rate = flat_animation.sampling_rate;
+		animation_clip.frame_count = flat_animation.frame_count;
+		animation_clip.tracks.assign(tracks, tracks + flat_animation.tracks.count);
+		animation_clip.key_frames.assign(key_frames, key_frames + flat_animation.key_frames.count);
+		animation_clip.key_values.assign(key_values, key_values + flat_animation.key_values.count);
+		// sample͊egbNɏȂƂ1̃L[AL[͈̔͂zɎ܂Ă邱ƂOɂ
+		for (const compressed_animation::track& track : animation_clip.tracks)
+		{
+			if (track.key_count == 0 || static_cast<uint64_t>(track.first_key) + track.key_count > animation_clip.key_frames.size())
+			{
+				return false;
+			}
+		}
+	}
+
+	scene_view = std::move(loaded_scene_view);
+	meshes = std::move(loaded_meshes);
+	materials = std::move(loaded_materials);
+	animation_clips = std::move(loaded_animation_clips);
+	compressed_animation_clips = std::move(loaded_compressed_animation_clips);
+	baked_vertex_cache_statistics[0] = header->vertex_cache_statistics[0];
+	baked_vertex_cache_statistics[1] = header->vertex_cache_statistics[1];
+	if (compatible_format)
+	{
+		format = stored_format;
+	}
+
+	if (!avoid_create_com_objects)
+	{
+		create_com_objects(device, fbx_filename, &streams);
+	}
+	return true;
+}
+
+void geometric_substance::benchmark_loading(ID3D11Device* device, const char* fbx_filename, float seconds[2], vertex_format vertex_format)
+{
+	std::filesystem::path substance_filename(fbx_filename);
+	substance_filename.replace_extension("substance");
+
+	// .substanceȂ΂ōB1ڂ̓]ŃeNX`ƃVF[_[ǂݍ܂̂ŁAv͂̌ōs
+	geometric_substance substance(device, fbx_filename, {}, false, 0, false, vertex_format);
+	auto clear = [&]() {
+		substance.scene_view.nodes.clear();
+		substance.meshes.clear();
+		substance.materials.clear();
+		substance.animation_clips.clear();
+	};
+
+	// .cerealFBXo܂܂(nڂבւĂȂ)bVȂ̂ŁÂ܂ܔׂƌ`̈Ⴂɒ_̈ႢB
+	// .substanceɏĂbV𓯂_`̂܂ܕʂ.cerealɏoAbV𗼕̌`œǂݔׂ
+	std::filesystem::path baked_cereal_filename(fbx_filename);
+	baked_cereal_filename.replace_extension("baked.cereal");
+	seconds[0] = -1;
+	clear();
+	if (substance.load_substance(substance_filename, device, fbx_filename, true/*avoid_create_com_objects*/))
+	{
+		substance.save_cereal(baked_cereal_filename);
+		clear();
+		benchmark stopwatch;
+		stopwatch.begin();
+		if (substance.load_cereal(baked_cereal_filename, fbx_filename))
+		{
+			substance.create_com_objects(device, fbx_filename);
+			seconds[0] = stopwatch.end();
+		}
+		std::filesystem::remove(baked_cereal_filename);
+	}
+
+	clear();
+	benchmark stopwatch;
+	stopwatch.begin();
+	seconds[1] = substance.load_substance(substance_filename, device, fbx_filename, false) ? stopwatch.end() : -1;
+}
+
+void geometric_substance::fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& meshes)
+{
+	// FBX SDK̃IuWFNg͓ǂނł̏(@Eڐ̐AC[vf̎Q)L̂ŁAV[ǂނׂ̂͂ẴXbhōsB
+	// bVƂɊpƂ̒lz֎ʂĂA_̑gݗ(TuZbgւ̐U蕪A{[̉e̍i荞݁AE{bNX)[J[Xbhŕɍs
+	struct mesh_source
+	{
+		std::vector<bone_influences_per_control_point> bone_influences;
+		std::vector<FbxVector4> control_points;
+		std::vector<int> polygon_materials; // |SƂ̃}eA̔ԍB}eAȂ΋
+		std::vector<int> polygon_vertices; // |S̊pƂ̐_̔ԍ
+		std::vector<FbxVector4> normals; // pƁB@Ȃ΋
+		std::vector<FbxVector2> texcoords; // pƁBUVȂ΋
+		std::vector<FbxVector4> tangents; // pƁBڐȂ΋
+	};
+	const size_t first_mesh_index{ meshes.size() };
+	std::vector<mesh_source> mesh_sources;
+	const std::vector<FbxNode*> fbx_nodes{ fetch_fbx_nodes(fbx_scene) };
+	const size_t node_count{ scene_view.nodes.size() };
+	for (size_t node_index = 0; node_index < node_count; ++node_index)
+	{
+		const scene::node& node{ scene_view.nodes.at(node_index) };
 		if (node.attribute != FbxNodeAttribute::EType::eMesh)
 		{
 			continue;
 		}
 
-		FbxNode* fbx_node{ fbx_scene->FindNodeByName(node.name.c_str()) };
+		FbxNode* fbx_node{ fbx_nodes.at(node_index) };
 		FbxMesh* fbx_mesh{ fbx_node->GetMesh() };
 
 		mesh& mesh{ meshes.emplace_back() };
@@ -220,9 +1222,12 @@ void geometric_substance::fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& m
 			fbx_mesh->GetNode()->GetGeometricRotation(FbxNode::eSourcePivot),
 			fbx_mesh->GetNode()->GetGeometricScaling(FbxNode::eSourcePivot)));
 
-		
-		std::vector<bone_influences_per_control_point> bone_influences;
-		fetch_bone_influences(fbx_mesh, bone_influences);
+		// t@Cɖ@ڐ̏񂪂Ȃ΂Ő
+		const bool has_normals{ fbx_mesh->GenerateNormals(false) };
+		const bool has_tangents{ fbx_mesh->GenerateTangentsData(0, false) };
+
+		mesh_source& mesh_source{ mesh_sources.emplace_back() };
+		fetch_bone_influences(fbx_mesh, mesh_source.bone_influences);
 
 		fetch_skeleton(fbx_mesh, mesh.bind_pose);
 
@@ -237,13 +1242,66 @@ void geometric_substance::fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& m
 			subsets.at(material_index).material_name = fbx_material->GetName();
 			subsets.at(material_index).material_unique_id = fbx_material->GetUniqueID();
 		}
+
+		const int polygon_count{ fbx_mesh->GetPolygonCount() };
+		const FbxVector4* control_points{ fbx_mesh->GetControlPoints() };
+		mesh_source.control_points.assign(control_points, control_points + fbx_mesh->GetControlPointsCount());
 		if (material_count > 0)
 		{
-			//fނ̖ʂ𐔂
-			const int polygon_count{ fbx_mesh->GetPolygonCount() };
+			mesh_source.polygon_materials.resize(polygon_count);
 			for (int polygon_index = 0; polygon_index < polygon_count; ++polygon_index)
 			{
-				const int material_index{ fbx_mesh->GetElementMaterial()->GetIndexArray().GetAt(polygon_index) };
+				mesh_source.polygon_materials.at(polygon_index) = fbx_mesh->GetElementMaterial()->GetIndexArray().GetAt(polygon_index);
+			}
+		}
+
+		FbxStringList uv_names;
+		fbx_mesh->GetUVSetNames(uv_names);
+		const bool has_texcoords{ fbx_mesh->GetElementUVCount() > 0 };
+		const FbxGeometryElementTangent* tangent{ has_tangents ? fbx_mesh->GetElementTangent(0) : nullptr };
+		_ASSERT_EXPR(!tangent || (tangent->GetMappingMode() == FbxGeometryElement::EMappingMode::eByPolygonVertex &&
+			tangent->GetReferenceMode() == FbxGeometryElement::EReferenceMode::eDirect),
+			L"Only supports a combination of these modes.");
+		const size_t corner_count{ polygon_count * 3ULL };
+		mesh_source.polygon_vertices.resize(corner_count);
+		mesh_source.normals.resize(has_normals ? corner_count : 0);
+		mesh_source.texcoords.resize(has_texcoords ? corner_count : 0);
+		mesh_source.tangents.resize(tangent ? corner_count : 0);
+		for (int polygon_index = 0; polygon_index < polygon_count; ++polygon_index)
+		{
+			for (int position_in_polygon = 0; position_in_polygon < 3; ++position_in_polygon)
+			{
+				const int vertex_index{ polygon_index * 3 + position_in_polygon };
+				mesh_source.polygon_vertices.at(vertex_index) = fbx_mesh->GetPolygonVertex(polygon_index, position_in_polygon);
+				if (has_normals)
+				{
+					fbx_mesh->GetPolygonVertexNormal(polygon_index, position_in_polygon, mesh_source.normals.at(vertex_index));
+				}
+				if (has_texcoords)
+				{
+					bool unmapped_uv;
+					fbx_mesh->GetPolygonVertexUV(polygon_index, position_in_polygon, uv_names[0], mesh_source.texcoords.at(vertex_index), unmapped_uv);
+				}
+				if (tangent)
+				{
+					mesh_source.tangents.at(vertex_index) = tangent->GetDirectArray().GetAt(vertex_index);
+				}
+			}
+		}
+	}
+
+	// ʂ̓V[̃m[hɊmۂvf֏ނ̂ŁAXbh̎sɂ炸ɂȂ
+	parallel_for_each_index(mesh_sources.size(), [&](size_t source_index) {
+		const mesh_source& mesh_source{ mesh_sources.at(source_index) };
+		mesh& mesh{ meshes.at(first_mesh_index + source_index) };
+
+		std::vector<mesh::subset>& subsets{ mesh.subsets };
+		const bool has_materials{ !mesh_source.polygon_materials.empty() };
+		if (has_materials)
+		{
+			//fނ̖ʂ𐔂
+			for (const int material_index : mesh_source.polygon_materials)
+			{
 				subsets.at(material_index).index_count += 3;
 			}
 			uint32_t offset{ 0 };
@@ -257,36 +1315,34 @@ void geometric_substance::fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& m
 		}
 
 		//FBXbṼ|SɊÂāAbV̒_i[邽߂̓K؂ȃTCYɂ鏈
-		const int polygon_count{ fbx_mesh->GetPolygonCount() };
-		mesh.vertex_positions.resize(polygon_count * 3LL);
-		mesh.vertex_extra_attributes.resize(polygon_count * 3LL);
-		mesh.vertex_bone_influences.resize(polygon_count * 3LL);
-		mesh.indices.resize(polygon_count * 3LL);
+		const size_t polygon_count{ mesh_source.polygon_vertices.size() / 3 };
+		mesh.vertex_positions.resize(polygon_count * 3);
+		mesh.vertex_extra_attributes.resize(polygon_count * 3);
+		mesh.vertex_bone_influences.resize(polygon_count * 3);
+		mesh.indices.resize(polygon_count * 3);
 
-		FbxStringList uv_names;
-		fbx_mesh->GetUVSetNames(uv_names);
-		const FbxVector4* control_points{ fbx_mesh->GetControlPoints() };
-		for (int polygon_index = 0; polygon_index < polygon_count; ++polygon_index)
+		for (size_t polygon_index = 0; polygon_index < polygon_count; ++polygon_index)
 		{
 			
-			const int material_index{ material_count > 0 ? fbx_mesh->GetElementMaterial()->GetIndexArray().GetAt(polygon_index) : 0 };
+			const int material_index{ has_materials ? mesh_source.polygon_materials.at(polygon_index) : 0 };
 			mesh::subset& subset{ subsets.at(material_index) };
 			const uint32_t offset{ subset.start_index_location + subset.index_count };
 
-			for (int position_in_polygon = 0; position_in_polygon < 3; ++position_in_polygon)
+			for (size_t position_in_polygon = 0; position_in_polygon < 3; ++position_in_polygon)
 			{
-				const int vertex_index{ polygon_index * 3 + position_in_polygon };
+				const size_t vertex_index{ polygon_index * 3 + position_in_polygon };
 
 				vertex_position vertex_position;
 				vertex_extra_attribute vertex_extra_attribute;
 				vertex_bone_influence vertex_bone_influence;
-				const int polygon_vertex{ fbx_mesh->GetPolygonVertex(polygon_index, position_in_polygon) };
-				vertex_position.position.x = static_cast<float>(control_points[polygon_vertex][0]);
-				vertex_position.position.y = static_cast<float>(control_points[polygon_vertex][1]);
-				vertex_position.position.z = static_cast<float>(control_points[polygon_vertex][2]);
+				const int polygon_vertex{ mesh_source.polygon_vertices.at(vertex_index) };
+				const FbxVector4& control_point{ mesh_source.control_points.at(polygon_vertex) };
+				vertex_position.position.x = static_cast<float>(control_point[0]);
+				vertex_position.position.y = static_cast<float>(control_point[1]);
+				vertex_position.position.z = static_cast<float>(control_point[2]);
 
 				// _ɑ΂{[̉ei{[EFCgƃ{[CfbNXjݒ
-				const bone_influences_per_control_point& influences_per_control_point{ bone_influences.at(polygon_vertex) };
+				const bone_influences_per_control_point& influences_per_control_point{ mesh_source.bone_influences.at(polygon_vertex) };
 				for (size_t influence_index = 0; influence_index < influences_per_control_point.size(); ++influence_index)
 				{
 					if (influence_index < MAX_BONE_INFLUENCES)
@@ -327,35 +1383,27 @@ void geometric_substance::fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& m
 #endif
 
 			
-				if (fbx_mesh->GenerateNormals(false))
+				if (!mesh_source.normals.empty())
 				{
-					FbxVector4 normal;
-					fbx_mesh->GetPolygonVertexNormal(polygon_index, position_in_polygon, normal);
+					const FbxVector4& normal{ mesh_source.normals.at(vertex_index) };
 					vertex_extra_attribute.normal.x = static_cast<float>(normal[0]);
 					vertex_extra_attribute.normal.y = static_cast<float>(normal[1]);
 					vertex_extra_attribute.normal.z = static_cast<float>(normal[2]);
 				}
 
-				if (fbx_mesh->GetElementUVCount() > 0)
+				if (!mesh_source.texcoords.empty())
 				{
-					FbxVector2 uv;
-					bool unmapped_uv;
-					fbx_mesh->GetPolygonVertexUV(polygon_index, position_in_polygon, uv_names[0], uv, unmapped_uv);
+					const FbxVector2& uv{ mesh_source.texcoords.at(vertex_index) };
 					vertex_extra_attribute.texcoord.x = static_cast<float>(uv[0]);
 					vertex_extra_attribute.texcoord.y = 1.0f - static_cast<float>(uv[1]);
 				}
-				// t@Cɖ@xNgȂꍇGenerateTangentsData֐Ő 
-				if (fbx_mesh->GenerateTangentsData(0, false))
+				if (!mesh_source.tangents.empty())
 				{
-					const FbxGeometryElementTangent* tangent = fbx_mesh->GetElementTangent(0);
-					_ASSERT_EXPR(tangent->GetMappingMode() == FbxGeometryElement::EMappingMode::eByPolygonVertex &&
-						tangent->GetReferenceMode() == FbxGeometryElement::EReferenceMode::eDirect,
-						L"Only supports a combination of these modes.");
-
-					vertex_extra_attribute.tangent.x = static_cast<float>(tangent->GetDirectArray().GetAt(vertex_index)[0]);
-					vertex_extra_attribute.tangent.y = static_cast<float>(tangent->GetDirectArray().GetAt(vertex_index)[1]);
-					vertex_extra_attribute.tangent.z = static_cast<float>(tangent->GetDirectArray().GetAt(vertex_index)[2]);
-					vertex_extra_attribute.tangent.w = static_cast<float>(tangent->GetDirectArray().GetAt(vertex_index)[3]);
+					const FbxVector4& tangent{ mesh_source.tangents.at(vertex_index) };
+					vertex_extra_attribute.tangent.x = static_cast<float>(tangent[0]);
+					vertex_extra_attribute.tangent.y = static_cast<float>(tangent[1]);
+					vertex_extra_attribute.tangent.z = static_cast<float>(tangent[2]);
+					vertex_extra_attribute.tangent.w = static_cast<float>(tangent[3]);
 				}
 				mesh.vertex_extra_attributes.at(vertex_index) = std::move(vertex_extra_attribute);
 				mesh.vertex_bone_influences.at(vertex_index) = std::move(vertex_bone_influence);
@@ -365,7 +1413,7 @@ void geometric_substance::fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& m
 #if 0
 				mesh.indices.at(vertex_index) = vertex_index;
 #else
-				mesh.indices.at(static_cast<size_t>(offset) + position_in_polygon) = vertex_index;
+				mesh.indices.at(static_cast<size_t>(offset) + position_in_polygon) = static_cast<uint32_t>(vertex_index);
 				subset.index_count++;
 #endif
 			}
@@ -382,51 +1430,107 @@ void geometric_substance::fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& m
 			mesh.bounding_box[1].y = std::max<float>(mesh.bounding_box[1].y, v.position.y);
 			mesh.bounding_box[1].z = std::max<float>(mesh.bounding_box[1].z, v.position.z);
 		}
-	}
+	});
 }
 
-void geometric_substance::create_com_objects(ID3D11Device* device, const char* fbx_filename)
+void geometric_substance::create_com_objects(ID3D11Device* device, const char* fbx_filename, const std::vector<vertex_streams>* mapped_streams)
 {
-	
-	for (mesh& mesh : meshes)
+#ifdef AVOID_CREATE_COM_OBJECTS
+	_ASSERT_EXPR(FALSE, L"This build can not create COM objects. Pass 'avoid_create_com_objects = true'.");
+#else
+	vertex_strides[0] = sizeof(vertex_position);
+	vertex_strides[1] = format == vertex_format::compact_float_texcoord ? sizeof(compact_float_texcoord_vertex_extra_attribute) :
+		format == vertex_format::compact ? sizeof(compact_vertex_extra_attribute) : sizeof(vertex_extra_attribute);
+	vertex_strides[2] = is_compact(format) ? sizeof(compact_vertex_bone_influence) : sizeof(vertex_bone_influence);
+
+	for (size_t mesh_index = 0; mesh_index < meshes.size(); ++mesh_index)
 	{
+		mesh& mesh{ meshes.at(mesh_index) };
+		const vertex_streams streams{ mapped_streams ? mapped_streams->at(mesh_index) : vertex_streams{
+			mesh.vertex_positions.data(), mesh.vertex_extra_attributes.data(), mesh.vertex_bone_influences.data(), mesh.vertex_positions.size(),
+			mesh.indices.data(), mesh.indices.size() } };
+
+		// compact.substanceǂ񂾏ꍇȊÓAŋl߂Ă]
+		std::vector<compact_vertex_extra_attribute> compact_extra_attributes;
+		std::vector<compact_float_texcoord_vertex_extra_attribute> compact_float_texcoord_extra_attributes;
+		std::vector<compact_vertex_bone_influence> compact_bone_influences;
+		const void* extra_attributes{ streams.extra_attributes };
+		const void* bone_influences{ streams.bone_influences };
+		if (is_compact(format))
+		{
+			const void* mapped_extra_attributes{ format == vertex_format::compact_float_texcoord ?
+				static_cast<const void*>(streams.compact_float_texcoord_extra_attributes) : static_cast<const void*>(streams.compact_extra_attributes) };
+			if (mapped_extra_attributes && streams.compact_bone_influences)
+			{
+				extra_attributes = mapped_extra_attributes;
+				bone_influences = streams.compact_bone_influences;
+			}
+			else
+			{
+				compact_bone_influences.resize(streams.vertex_count);
+				for (size_t vertex_index = 0; vertex_index < streams.vertex_count; ++vertex_index)
+				{
+					compact_bone_influences.at(vertex_index) = compress(streams.bone_influences[vertex_index]);
+				}
+				bone_influences = compact_bone_influences.data();
+				if (format == vertex_format::compact_float_texcoord)
+				{
+					compact_float_texcoord_extra_attributes.resize(streams.vertex_count);
+					for (size_t vertex_index = 0; vertex_index < streams.vertex_count; ++vertex_index)
+					{
+						compact_float_texcoord_extra_attributes.at(vertex_index) = compress_float_texcoord(streams.extra_attributes[vertex_index]);
+					}
+					extra_attributes = compact_float_texcoord_extra_attributes.data();
+				}
+				else
+				{
+					compact_extra_attributes.resize(streams.vertex_count);
+					for (size_t vertex_index = 0; vertex_index < streams.vertex_count; ++vertex_index)
+					{
+						compact_extra_attributes.at(vertex_index) = compress(streams.extra_attributes[vertex_index]);
+					}
+					extra_attributes = compact_extra_attributes.data();
+				}
+			}
+		}
+
 		//bV̑ݒ
 		mesh.attribute = mesh.bind_pose.bones.size() > 0 ? geometric_attribute::skinnned_mesh : geometric_attribute::static_mesh;
 
 		HRESULT hr{ S_OK };
 		D3D11_BUFFER_DESC buffer_desc{};
 		D3D11_SUBRESOURCE_DATA subresource_data{};
-		buffer_desc.ByteWidth = static_cast<UINT>(sizeof(vertex_position) * mesh.vertex_positions.size());
+		buffer_desc.ByteWidth = static_cast<UINT>(vertex_strides[0] * streams.vertex_count);
 		buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 		buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 		buffer_desc.CPUAccessFlags = 0;
 		buffer_desc.MiscFlags = 0;
 		buffer_desc.StructureByteStride = 0;
-		subresource_data.pSysMem = mesh.vertex_positions.data();
+		subresource_data.pSysMem = streams.positions;
 		subresource_data.SysMemPitch = 0;
 		subresource_data.SysMemSlicePitch = 0;
 		hr = device->CreateBuffer(&buffer_desc, &subresource_data, mesh.vertex_buffers[0].ReleaseAndGetAddressOf());
 		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));    
 
 		
-		buffer_desc.ByteWidth = static_cast<UINT>(sizeof(vertex_extra_attribute) * mesh.vertex_extra_attributes.size());
+		buffer_desc.ByteWidth = static_cast<UINT>(vertex_strides[1] * streams.vertex_count);
 		buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 		buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		subresource_data.pSysMem = mesh.vertex_extra_attributes.data();
+		subresource_data.pSysMem = extra_attributes;
 		hr = device->CreateBuffer(&buffer_desc, &subresource_data, mesh.vertex_buffers[1].ReleaseAndGetAddressOf());
 		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 
-		buffer_desc.ByteWidth = static_cast<UINT>(sizeof(vertex_bone_influence) * mesh.vertex_bone_influences.size());
+		buffer_desc.ByteWidth = static_cast<UINT>(vertex_strides[2] * streams.vertex_count);
 		buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 		buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		subresource_data.pSysMem = mesh.vertex_bone_influences.data();
+		subresource_data.pSysMem = bone_influences;
 		hr = device->CreateBuffer(&buffer_desc, &subresource_data, mesh.vertex_buffers[2].ReleaseAndGetAddressOf());
 		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 
-		buffer_desc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * mesh.indices.size());
+		buffer_desc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * streams.index_count);
 		buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 		buffer_desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		subresource_data.pSysMem = mesh.indices.data();
+		subresource_data.pSysMem = streams.indices;
 		hr = device->CreateBuffer(&buffer_desc, &subresource_data, mesh.index_buffer.ReleaseAndGetAddressOf());
 		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 
@@ -469,6 +1573,23 @@ void geometric_substance::create_com_objects(ID3D11Device* device, const char* f
 	vertex_shaders[1] = shader<ID3D11VertexShader>::_emplace(device, "skinned_mesh_vs.cso", input_layouts[1].ReleaseAndGetAddressOf(), input_element_desc, 6);
 	vertex_shaders[2] = shader<ID3D11VertexShader>::_emplace(device, "static_mesh_csm_vs.cso", NULL, NULL, 0);
 	vertex_shaders[3] = shader<ID3D11VertexShader>::_emplace(device, "skinned_mesh_csm_vs.cso", NULL, NULL, 0);
+	if (is_compact(format))
+	{
+		// VF[_[猩^(float4/uint4)͓Ȃ̂ŁA̓CAEgւ
+		const bool float_texcoord{ format == vertex_format::compact_float_texcoord };
+		D3D11_INPUT_ELEMENT_DESC compact_input_element_desc[]
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "NORMAL", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "TANGENT", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "TEXCOORD", 0, float_texcoord ? DXGI_FORMAT_R32G32_FLOAT : DXGI_FORMAT_R16G16_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "WEIGHTS", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "BONES", 0, DXGI_FORMAT_R8G8B8A8_UINT, 2, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		};
+		const char* layout_name{ float_texcoord ? "compact_float_texcoord" : "compact" };
+		shader<ID3D11VertexShader>::_emplace_input_layout(device, "static_mesh_vs.cso", layout_name, input_layouts[0].ReleaseAndGetAddressOf(), compact_input_element_desc, 4);
+		shader<ID3D11VertexShader>::_emplace_input_layout(device, "skinned_mesh_vs.cso", layout_name, input_layouts[1].ReleaseAndGetAddressOf(), compact_input_element_desc, 6);
+	}
 	pixel_shaders[0] = shader<ID3D11PixelShader>::_emplace(device, "static_mesh_ps.cso");
 	pixel_shaders[1] = shader<ID3D11PixelShader>::_emplace(device, "skinned_mesh_ps.cso");
 	geometry_shader = shader<ID3D11GeometryShader>::_emplace(device, "geometric_substance_csm_gs.cso");
@@ -480,21 +1601,25 @@ void geometric_substance::create_com_objects(ID3D11Device* device, const char* f
 	hr = device->CreateBuffer(&buffer_desc, nullptr, constant_buffers[0].ReleaseAndGetAddressOf());
 	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
 
+	// UNIT.99 {[sbone_countނ̂MapōXV
 	buffer_desc.ByteWidth = sizeof(bone_constants);
-	buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+	buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
 	buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	hr = device->CreateBuffer(&buffer_desc, nullptr, constant_buffers[1].ReleaseAndGetAddressOf());
 	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	buffer_desc.CPUAccessFlags = 0;
 
 	buffer_desc.ByteWidth = sizeof(material_constants);
 	buffer_desc.Usage = D3D11_USAGE_DEFAULT;
 	buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 	hr = device->CreateBuffer(&buffer_desc, nullptr, constant_buffers[2].ReleaseAndGetAddressOf());
 	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+#endif
 }
 
 void geometric_substance::render(ID3D11DeviceContext* immediate_context, const XMFLOAT4X4& world, const animation::keyframe* keyframe/*UNIT.25*/,
-	std::function<int(const mesh&, const material&, shader_resources&, pipeline_state&)> callback/*UNIT.99*/)
+	std::function<int(const mesh&, const material&, shader_resources&, pipeline_state&)> callback/*UNIT.99*/, skinning_palette* palette)
 {
 	D3D11_PRIMITIVE_TOPOLOGY cached_topology;
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> cached_vertex_shader;
@@ -519,7 +1644,6 @@ void geometric_substance::render(ID3D11DeviceContext* immediate_context, const X
 
 	for (mesh& mesh : meshes)
 	{
-		uint32_t strides[3] = { sizeof(vertex_position), sizeof(vertex_extra_attribute), sizeof(vertex_bone_influence) };
 		uint32_t offsets[3] = { 0, 0, 0 };
 		ID3D11Buffer* vertex_buffers[3] =
 		{
@@ -527,7 +1651,7 @@ void geometric_substance::render(ID3D11DeviceContext* immediate_context, const X
 			mesh.vertex_buffers[1].Get(),
 			mesh.attribute == geometric_attribute::skinnned_mesh ? mesh.vertex_buffers[2].Get() : nullptr
 		};
-		immediate_context->IASetVertexBuffers(0, static_cast<size_t>(mesh.attribute) + 2, vertex_buffers, strides, offsets);
+		immediate_context->IASetVertexBuffers(0, static_cast<size_t>(mesh.attribute) + 2, vertex_buffers, vertex_strides, offsets);
 		immediate_context->IASetIndexBuffer(mesh.index_buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
 		immediate_context->IASetInputLayout(input_layouts[static_cast<size_t>(mesh.attribute)].Get());
 
@@ -540,24 +1664,9 @@ void geometric_substance::render(ID3D11DeviceContext* immediate_context, const X
 #else
 			XMStoreFloat4x4(&data.world, XMLoadFloat4x4(&mesh.geometric_transform)/*UNIT.99*/ * XMLoadFloat4x4(&mesh_node.global_transform) * XMLoadFloat4x4(&world));
 #endif
-			const size_t bone_count = mesh.bind_pose.bones.size();
-			_ASSERT_EXPR(bone_count < MAX_BONES, L"The value of the 'bone_count' has exceeded MAX_BONES.");
-
-			bone_constants bone_data;
-			for (size_t bone_index = 0; bone_index < bone_count; ++bone_index)
-			{
-				const skeleton::bone& bone{ mesh.bind_pose.bones.at(bone_index) };
-				const animation::keyframe::node& bone_node{ keyframe->nodes.at(bone.node_index) };
-				XMStoreFloat4x4(&bone_data.bone_transforms[bone_index],
-					XMLoadFloat4x4(&bone.offset_transform) *
-					XMLoadFloat4x4(&bone_node.global_transform) *
-					XMMatrixInverse(nullptr, XMLoadFloat4x4(&mesh_node.global_transform))
-				);
-			}
 			if (mesh.attribute == geometric_attribute::skinnned_mesh)
 			{
-				immediate_context->UpdateSubresource(constant_buffers[1].Get(), 0, 0, &bone_data, 0, 0);
-				immediate_context->VSSetConstantBuffers(1, 1, constant_buffers[1].GetAddressOf());
+				bind_bone_transforms(immediate_context, mesh, keyframe, palette); // UNIT.99
 			}
 		}
 		else
@@ -572,13 +1681,7 @@ void geometric_substance::render(ID3D11DeviceContext* immediate_context, const X
 			if (mesh.attribute == geometric_attribute::skinnned_mesh) // UNIT.99
 			{
 				//Kvȃ{[f[^ȂꍇłK؂ɓ삷悤ɂ邽߃oCh
-				bone_constants bone_data;
-				for (size_t bone_index = 0; bone_index < MAX_BONES; ++bone_index)
-				{
-					bone_data.bone_transforms[bone_index] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
-				}
-				immediate_context->UpdateSubresource(constant_buffers[1].Get(), 0, 0, &bone_data, 0, 0);
-				immediate_context->VSSetConstantBuffers(1, 1, constant_buffers[1].GetAddressOf());
+				bind_bone_transforms(immediate_context, mesh, nullptr, nullptr);
 			}
 #endif
 		}
@@ -652,11 +1755,14 @@ void geometric_substance::render(ID3D11DeviceContext* immediate_context, const X
 	immediate_context->OMSetDepthStencilState(cached_depth_stencil_state.Get(), cached_stencil_ref);
 }
 
-void geometric_substance::cast_shadow(ID3D11DeviceContext* immediate_context, const XMFLOAT4X4& world, const animation::keyframe* keyframe)
+void geometric_substance::cast_shadow(ID3D11DeviceContext* immediate_context, const XMFLOAT4X4& world, const animation::keyframe* keyframe, const std::vector<uint64_t>* visibility, UINT instance_count, skinning_palette* palette)
 {
 	for (mesh& mesh : meshes)
 	{
-		uint32_t strides[3] = { sizeof(vertex_position), sizeof(vertex_extra_attribute), sizeof(vertex_bone_influence) };
+		if (visibility && !is_visible(*visibility, static_cast<size_t>(&mesh - meshes.data())))
+		{
+			continue;
+		}
 		uint32_t offsets[3] = { 0, 0, 0 };
 		ID3D11Buffer* vertex_buffers[3] =
 		{
@@ -664,7 +1770,7 @@ void geometric_substance::cast_shadow(ID3D11DeviceContext* immediate_context, co
 			nullptr,
 			mesh.attribute == geometric_attribute::skinnned_mesh ? mesh.vertex_buffers[2].Get() : nullptr
 		};
-		immediate_context->IASetVertexBuffers(0, static_cast<size_t>(mesh.attribute) + 2, vertex_buffers, strides, offsets);
+		immediate_context->IASetVertexBuffers(0, static_cast<size_t>(mesh.attribute) + 2, vertex_buffers, vertex_strides, offsets);
 		immediate_context->IASetIndexBuffer(mesh.index_buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
 		immediate_context->IASetInputLayout(input_layouts[static_cast<size_t>(mesh.attribute)].Get());
 
@@ -677,78 +1783,263 @@ void geometric_substance::cast_shadow(ID3D11DeviceContext* immediate_context, co
 #else
 			XMStoreFloat4x4(&data.world, XMLoadFloat4x4(&mesh.geometric_transform) * XMLoadFloat4x4(&mesh_node.global_transform) * XMLoadFloat4x4(&world));
 #endif
-			const size_t bone_count{ mesh.bind_pose.bones.size() };
-			_ASSERT_EXPR(bone_count < MAX_BONES, L"The value of the 'bone_count' has exceeded MAX_BONES.");
+			if (mesh.attribute == geometric_attribute::skinnned_mesh)
+			{
+				bind_bone_transforms(immediate_context, mesh, keyframe, palette); // UNIT.99
+			}
+		}
+		else
+		{
+#if 0
+			XMStoreFloat4x4(&data.world, XMLoadFloat4x4(&mesh.default_global_transform) * XMLoadFloat4x4(&world));
+#else
+			XMStoreFloat4x4(&data.world, XMLoadFloat4x4(&mesh.geometric_transform)/*UNIT.99*/ * XMLoadFloat4x4(&mesh.default_global_transform) * XMLoadFloat4x4(&world));
+#endif
 
-			bone_constants bone_data;
-			for (size_t bone_index = 0; bone_index < bone_count; ++bone_index)
+#if 1
+			if (mesh.attribute == geometric_attribute::skinnned_mesh) 
 			{
-				const skeleton::bone& bone{ mesh.bind_pose.bones.at(bone_index) };
-				const animation::keyframe::node& bone_node{ keyframe->nodes.at(bone.node_index) };
-				XMStoreFloat4x4(&bone_data.bone_transforms[bone_index],
-					XMLoadFloat4x4(&bone.offset_transform) *
-					XMLoadFloat4x4(&bone_node.global_transform) *
-					XMMatrixInverse(nullptr, XMLoadFloat4x4(&mesh_node.global_transform))
-				);
+				// Kvȃ{[f[^ȂꍇłK؂ɓ삷悤ɂ邽߃oCh
+				bind_bone_transforms(immediate_context, mesh, nullptr, nullptr); // UNIT.99
 			}
+#endif
+		}
+		immediate_context->UpdateSubresource(constant_buffers[0].Get(), 0, 0, &data, 0, 0);
+		immediate_context->VSSetConstantBuffers(0, 1, constant_buffers[0].GetAddressOf());
+
+		for (const mesh::subset& subset : mesh.subsets)
+		{
+			immediate_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			immediate_context->VSSetShader(vertex_shaders[static_cast<size_t>(mesh.attribute) + 2].Get(), NULL, 0);
+			immediate_context->DSSetShader(NULL, NULL, 0);
+			immediate_context->HSSetShader(NULL, NULL, 0);
+			immediate_context->GSSetShader(geometry_shader.Get(), NULL, 0);
+			immediate_context->PSSetShader(NULL, NULL, 0);
+#if 0
+			immediate_context->DrawIndexed(subset.index_count, subset.start_index_location, 0);
+#else
+			immediate_context->DrawIndexedInstanced(subset.index_count, instance_count, subset.start_index_location, 0, 0);
+#endif
+		}
+	}
+	immediate_context->VSSetShader(NULL, NULL, 0);
+	immediate_context->GSSetShader(NULL, NULL, 0);
+
+}
+
+// UNIT.99
+inline XMFLOAT4X4* map_bone_transforms(ID3D11DeviceContext* immediate_context, ID3D11Buffer* buffer)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped_subresource{};
+	HRESULT hr{ immediate_context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subresource) };
+	_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+	return reinterpret_cast<XMFLOAT4X4*>(mapped_subresource.pData);
+}
+void geometric_substance::update_skinning_palette(const animation::keyframe* keyframe, skinning_palette& palette) const
+{
+	if (palette.visible)
+	{
+		prepare_skinning_palette(keyframe, palette);
+	}
+}
+// ]2̃{[s𐬕Ƃɐ`ԂB]킸ɏkނAԂ͉̂i̐t[Ȃ̂ŖڗȂ
+inline void lerp_bone_transforms(const XMFLOAT4X4* bone_transforms0, const XMFLOAT4X4* bone_transforms1, float t, size_t transform_count, XMFLOAT4X4* bone_transforms)
+{
+	for (size_t transform_index = 0; transform_index < transform_count; ++transform_index)
+	{
+		const XMMATRIX M0{ XMLoadFloat4x4(&bone_transforms0[transform_index]) };
+		const XMMATRIX M1{ XMLoadFloat4x4(&bone_transforms1[transform_index]) };
+		XMMATRIX M;
+		M.r[0] = XMVectorLerp(M0.r[0], M1.r[0], t);
+		M.r[1] = XMVectorLerp(M0.r[1], M1.r[1], t);
+		M.r[2] = XMVectorLerp(M0.r[2], M1.r[2], t);
+		M.r[3] = XMVectorLerp(M0.r[3], M1.r[3], t);
+		XMStoreFloat4x4(&bone_transforms[transform_index], M);
+	}
+}
+void geometric_substance::prepare_skinning_palette(const animation::keyframe* keyframe, skinning_palette& palette) const
+{
+	if (!keyframe || keyframe->nodes.size() == 0 || (palette.prepared_keyframe == keyframe && palette.prepared_frame_index == palette.frame_index))
+	{
+		return;
+	}
+	size_t transform_count{ 0 };
+	for (const mesh& mesh : meshes)
+	{
+		if (mesh.attribute == geometric_attribute::skinnned_mesh)
+		{
+			transform_count += mesh.bind_pose.bones.size();
+		}
+	}
+	const bool reduced_bones{ palette.reduced_bones };
+	const auto evaluate{ [this, keyframe, reduced_bones](XMFLOAT4X4* bone_transforms) {
+		for (const mesh& mesh : meshes)
+		{
 			if (mesh.attribute == geometric_attribute::skinnned_mesh)
 			{
-				immediate_context->UpdateSubresource(constant_buffers[1].Get(), 0, 0, &bone_data, 0, 0);
-				immediate_context->VSSetConstantBuffers(1, 1, constant_buffers[1].GetAddressOf());
+				make_bone_transforms(mesh, *keyframe, bone_transforms, reduced_bones);
+				bone_transforms += mesh.bind_pose.bones.size();
+			}
+		}
+	} };
+	palette.bone_transforms.resize(transform_count);
+	if (palette.update_interval <= 1)
+	{
+		evaluate(palette.bone_transforms.data());
+		palette.evaluated_bone_transforms[1].clear(); // Ԋu΂Ƃ͍̎pԂ蒼
+	}
+	else
+	{
+		std::vector<XMFLOAT4X4>* evaluated_bone_transforms{ palette.evaluated_bone_transforms };
+		if (evaluated_bone_transforms[1].size() != transform_count || palette.evaluated_reduced_bones != reduced_bones)
+		{
+			evaluated_bone_transforms[1].resize(transform_count);
+			evaluate(evaluated_bone_transforms[1].data());
+			evaluated_bone_transforms[0] = evaluated_bone_transforms[1];
+			palette.evaluated_reduced_bones = reduced_bones;
+			palette.frames_since_evaluation = 0;
+		}
+		else if (++palette.frames_since_evaluation >= palette.update_interval)
+		{
+			evaluated_bone_transforms[0].swap(evaluated_bone_transforms[1]);
+			evaluate(evaluated_bone_transforms[1].data());
+			palette.frames_since_evaluation = 0;
+		}
+		// ]t[玟ɕ]t[܂łɁAO̕]ʂ獡̕]ʂֈڂ
+		const float t{ static_cast<float>(palette.frames_since_evaluation + 1) / palette.update_interval };
+		lerp_bone_transforms(evaluated_bone_transforms[0].data(), evaluated_bone_transforms[1].data(), t, transform_count, palette.bone_transforms.data());
+	}
+	palette.prepared_keyframe = keyframe;
+	palette.prepared_frame_index = palette.frame_index;
+}
+void geometric_substance::mask_lod_bones(const std::function<bool(const skeleton::bone&, size_t height)>& keep)
+{
+	for (mesh& mesh : meshes)
+	{
+		if (mesh.attribute == geometric_attribute::skinnned_mesh)
+		{
+			mesh.bind_pose.mask_lod_bones(keep);
+		}
+	}
+}
+void geometric_substance::transform_bounding_box(const XMFLOAT4X4& world, XMFLOAT3 world_bounding_box[2]) const
+{
+	world_bounding_box[0] = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
+	world_bounding_box[1] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const mesh& mesh : meshes)
+	{
+		XMFLOAT3 mesh_bounding_box[2];
+		mesh.transform_bounding_box(world, mesh_bounding_box);
+		XMStoreFloat3(&world_bounding_box[0], XMVectorMin(XMLoadFloat3(&world_bounding_box[0]), XMLoadFloat3(&mesh_bounding_box[0])));
+		XMStoreFloat3(&world_bounding_box[1], XMVectorMax(XMLoadFloat3(&world_bounding_box[1]), XMLoadFloat3(&mesh_bounding_box[1])));
+	}
+}
+void geometric_substance::select_animation_lod(const XMFLOAT4X4& world, const XMFLOAT4& eye_position, bool visible, skinning_palette& palette) const
+{
+	XMFLOAT3 world_bounding_box[2];
+	transform_bounding_box(world, world_bounding_box);
+	palette.visible = meshes.empty() || visible;
+
+	const XMVECTOR center{ XMVectorScale(XMVectorAdd(XMLoadFloat3(&world_bounding_box[0]), XMLoadFloat3(&world_bounding_box[1])), 0.5f) };
+	const float eye_distance{ meshes.empty() ? 0.0f : XMVectorGetX(XMVector3Length(XMVectorSubtract(center, XMLoadFloat4(&eye_position)))) };
+	palette.update_interval = 1;
+	palette.reduced_bones = false;
+	if (!animation_lods.empty())
+	{
+		const animation_lod* lod{ &animation_lods.back() };
+		for (const animation_lod& candidate : animation_lods)
+		{
+			if (eye_distance < candidate.distance)
+			{
+				lod = &candidate;
+				break;
 			}
 		}
-		else
+		palette.update_interval = std::max<uint32_t>(lod->update_interval, 1);
+		palette.reduced_bones = lod->reduced_bones;
+	}
+}
+void geometric_substance::bind_bone_transforms(ID3D11DeviceContext* immediate_context, const mesh& mesh, const animation::keyframe* keyframe, skinning_palette* palette)
+{
+	if (!keyframe || !palette)
+	{
+		XMFLOAT4X4* bone_transforms{ map_bone_transforms(immediate_context, constant_buffers[1].Get()) };
+		if (bone_transforms != nullptr)
 		{
-#if 0
-			XMStoreFloat4x4(&data.world, XMLoadFloat4x4(&mesh.default_global_transform) * XMLoadFloat4x4(&world));
-#else
-			XMStoreFloat4x4(&data.world, XMLoadFloat4x4(&mesh.geometric_transform)/*UNIT.99*/ * XMLoadFloat4x4(&mesh.default_global_transform) * XMLoadFloat4x4(&world));
-#endif
-
-#if 1
-			if (mesh.attribute == geometric_attribute::skinnned_mesh) 
+			if (keyframe)
 			{
-				// Kvȃ{[f[^ȂꍇłK؂ɓ삷悤ɂ邽߃oCh
-				bone_constants bone_data;
+				make_bone_transforms(mesh, *keyframe, bone_transforms);
+			}
+			else
+			{
+				// ̐ɂ炸_ǂ̃{[QƂĂό`Ȃ悤ɁAׂĒPʍsŖ߂
 				for (size_t bone_index = 0; bone_index < MAX_BONES; ++bone_index)
 				{
-					bone_data.bone_transforms[bone_index] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+					bone_transforms[bone_index] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
 				}
-				immediate_context->UpdateSubresource(constant_buffers[1].Get(), 0, 0, &bone_data, 0, 0);
-				immediate_context->VSSetConstantBuffers(1, 1, constant_buffers[1].GetAddressOf());
 			}
-#endif
 		}
-		immediate_context->UpdateSubresource(constant_buffers[0].Get(), 0, 0, &data, 0, 0);
-		immediate_context->VSSetConstantBuffers(0, 1, constant_buffers[0].GetAddressOf());
+		immediate_context->Unmap(constant_buffers[1].Get(), 0);
+		immediate_context->VSSetConstantBuffers(1, 1, constant_buffers[1].GetAddressOf());
+		return;
+	}
 
-		for (const mesh::subset& subset : mesh.subsets)
+	prepare_skinning_palette(keyframe, *palette);
+	if (palette->constant_buffers.size() != meshes.size())
+	{
+		// ߂ĎgƂɃXLbVƂ̒萔obt@
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		immediate_context->GetDevice(device.GetAddressOf());
+		D3D11_BUFFER_DESC buffer_desc{};
+		buffer_desc.ByteWidth = sizeof(bone_constants);
+		buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+		buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		palette->constant_buffers.clear();
+		palette->constant_buffers.resize(meshes.size());
+		for (const geometric_substance::mesh& skinned_mesh : meshes)
 		{
-			immediate_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-			immediate_context->VSSetShader(vertex_shaders[static_cast<size_t>(mesh.attribute) + 2].Get(), NULL, 0);
-			immediate_context->DSSetShader(NULL, NULL, 0);
-			immediate_context->HSSetShader(NULL, NULL, 0);
-			immediate_context->GSSetShader(geometry_shader.Get(), NULL, 0);
-			immediate_context->PSSetShader(NULL, NULL, 0);
-#if 0
-			immediate_context->DrawIndexed(subset.index_count, subset.start_index_location, 0);
-#else
-			immediate_context->DrawIndexedInstanced(subset.index_count, 4, subset.start_index_location, 0, 0);
-#endif
+			if (skinned_mesh.attribute == geometric_attribute::skinnned_mesh)
+			{
+				HRESULT hr{ device->CreateBuffer(&buffer_desc, nullptr, palette->constant_buffers.at(&skinned_mesh - meshes.data()).ReleaseAndGetAddressOf()) };
+				_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+			}
 		}
+		palette->uploaded_keyframe = nullptr;
 	}
-	immediate_context->VSSetShader(NULL, NULL, 0);
-	immediate_context->GSSetShader(NULL, NULL, 0);
-
+	if (palette->uploaded_keyframe != keyframe || palette->uploaded_frame_index != palette->frame_index)
+	{
+		// ŏ̃pXŃXLbV܂Ƃ߂ď(cast_shadowŎ̊ÕbV{`ł͎g)
+		const XMFLOAT4X4* bone_transforms{ palette->bone_transforms.data() };
+		for (const geometric_substance::mesh& skinned_mesh : meshes)
+		{
+			ID3D11Buffer* buffer{ palette->constant_buffers.at(&skinned_mesh - meshes.data()).Get() };
+			if (buffer)
+			{
+				const size_t bone_count{ skinned_mesh.bind_pose.bones.size() };
+				XMFLOAT4X4* mapped_bone_transforms{ map_bone_transforms(immediate_context, buffer) };
+				if (mapped_bone_transforms != nullptr)
+				{
+					memcpy(mapped_bone_transforms, bone_transforms, sizeof(XMFLOAT4X4) * bone_count);
+				}
+				immediate_context->Unmap(buffer, 0);
+				bone_transforms += bone_count;
+			}
+		}
+		palette->uploaded_keyframe = keyframe;
+		palette->uploaded_frame_index = palette->frame_index;
+	}
+	immediate_context->VSSetConstantBuffers(1, 1, palette->constant_buffers.at(&mesh - meshes.data()).GetAddressOf());
 }
 //}eA擾
 void geometric_substance::fetch_materials(FbxScene* fbx_scene, std::unordered_map<uint64_t, material>& materials)
 {
+	const std::vector<FbxNode*> fbx_nodes{ fetch_fbx_nodes(fbx_scene) };
 	const size_t node_count{ scene_view.nodes.size() };
 	for (size_t node_index = 0; node_index < node_count; ++node_index)
 	{
 		const scene::node& node{ scene_view.nodes.at(node_index) };
-		const FbxNode* fbx_node{ fbx_scene->FindNodeByName(node.name.c_str()) };
+		const FbxNode* fbx_node{ fbx_nodes.at(node_index) };
 
 		const int material_count{ fbx_node->GetMaterialCount() };
 		for (int material_index = 0; material_index < material_count; ++material_index)
@@ -838,6 +2129,7 @@ void geometric_substance::fetch_skeleton(FbxMesh* fbx_mesh, skeleton& bind_pose)
 		FbxSkin* skin = static_cast<FbxSkin*>(fbx_mesh->GetDeformer(deformer_index, FbxDeformer::eSkin));
 		const int cluster_count = skin->GetClusterCount();
 		bind_pose.bones.resize(cluster_count);
+		bind_pose.indices.clear();
 		for (int cluster_index = 0; cluster_index < cluster_count; ++cluster_index)
 		{
 			FbxCluster* cluster = skin->GetCluster(cluster_index);
@@ -845,6 +2137,7 @@ void geometric_substance::fetch_skeleton(FbxMesh* fbx_mesh, skeleton& bind_pose)
 			skeleton::bone& bone{ bind_pose.bones.at(cluster_index) };
 			bone.name = cluster->GetLink()->GetName();
 			bone.unique_id = cluster->GetLink()->GetUniqueID();
+			bind_pose.indices.emplace(bone.unique_id, cluster_index);
 			bone.parent_index = bind_pose.indexof(cluster->GetLink()->GetParent()->GetUniqueID());
 			bone.node_index = scene_view.indexof(bone.unique_id);
 
@@ -861,6 +2154,29 @@ void geometric_substance::fetch_skeleton(FbxMesh* fbx_mesh, skeleton& bind_pose)
 		}
 	}
 }
+// scene_view̃m[hɑΉFbxNodem[h̏ɕׂBȂm[hnullptrɂȂB
+// Aj[Vt@C̃V[unique_idقȂ̂ŖOőΉt(Õm[h͐Ɍg)
+std::vector<FbxNode*> geometric_substance::fetch_fbx_nodes(FbxScene* fbx_scene) const
+{
+	std::unordered_map<std::string, FbxNode*> fbx_nodes_by_name;
+	std::function<void(FbxNode*)> traverse{ [&](FbxNode* fbx_node) {
+		fbx_nodes_by_name.emplace(fbx_node->GetName(), fbx_node);
+		for (int child_index = 0; child_index < fbx_node->GetChildCount(); ++child_index)
+		{
+			traverse(fbx_node->GetChild(child_index));
+		}
+	} };
+	traverse(fbx_scene->GetRootNode());
+
+	const size_t node_count{ scene_view.nodes.size() };
+	std::vector<FbxNode*> fbx_nodes(node_count);
+	for (size_t node_index = 0; node_index < node_count; ++node_index)
+	{
+		const auto fbx_node{ fbx_nodes_by_name.find(scene_view.nodes.at(node_index).name) };
+		fbx_nodes.at(node_index) = fbx_node != fbx_nodes_by_name.end() ? fbx_node->second : nullptr;
+	}
+	return fbx_nodes;
+}
 //Aj[V擾
 void geometric_substance::fetch_animations(FbxScene* fbx_scene, std::vector<animation>& animation_clips, float sampling_rate /*If this value is 0, the animation data will be sampled at the default frame rate.*/)
 {
@@ -870,6 +2186,10 @@ void geometric_substance::fetch_animations(FbxScene* fbx_scene, std::vector<anim
 		return;
 	}
 
+	// L[t[ƂɃm[h𖼑OŒTȂ悤ɁAΉFbxNodeɕׂĂ
+	const std::vector<FbxNode*> fbx_nodes{ fetch_fbx_nodes(fbx_scene) };
+	const size_t node_count{ scene_view.nodes.size() };
+
 	FbxArray<FbxString*> animation_stack_names;
 	fbx_scene->FillAnimStackNameArray(animation_stack_names);
 	const int animation_stack_count{ animation_stack_names.GetCount() };
@@ -915,23 +2235,43 @@ void geometric_substance::fetch_animations(FbxScene* fbx_scene, std::vector<anim
 		animation_clip.sampling_rate = sampling_rate > 0 ? sampling_rate : static_cast<float>(smapling_step.GetFrameRate(time_mode));
 		smapling_step = static_cast<FbxLongLong>(smapling_step.Get() * (1.0f / animation_clip.sampling_rate));
 #endif // 0
-		for (FbxTime time = start_time; time <= stop_time; time += smapling_step)
+		_ASSERT_EXPR(smapling_step.Get() > 0, L"The sampling rate is too high.");
+		const size_t keyframe_count{ stop_time < start_time ? 0 : static_cast<size_t>((stop_time.Get() - start_time.Get()) / smapling_step.Get()) + 1 };
+		animation_clip.sequence.resize(keyframe_count);
+
+		// 1̃V[̕](FbxNode::Evaluate*Transformg)͓rʂLbVAV[̃IuWFNgL̂ŁA
+		// V[̃TvO͕ɂ̃XbhŎɍsB񉻂FBXt@C(FbxManager)̒PʂŌĂяosB
+		// ł͕]sW߂邾ɂāAs̕ƕϊFBX SDKɐGȂ̂ŃL[t[ƂɃ[J[Xbhōs
+		std::vector<FbxAMatrix> evaluated_transforms(keyframe_count * node_count * 2); // L[t[Am[h̏ɑƋǏ2
+		for (size_t keyframe_index = 0; keyframe_index < keyframe_count; ++keyframe_index)
 		{
-			animation::keyframe& keyframe{ animation_clip.sequence.emplace_back() };
+			const FbxTime time{ start_time.Get() + smapling_step.Get() * static_cast<FbxLongLong>(keyframe_index) };
+			for (size_t node_index = 0; node_index < node_count; ++node_index)
+			{
+				FbxNode* fbx_node{ fbx_nodes.at(node_index) };
+				if (fbx_node)
+				{
+					FbxAMatrix* transforms{ &evaluated_transforms.at((keyframe_index * node_count + node_index) * 2) };
+					transforms[0] = fbx_node->EvaluateGlobalTransform(time);
+					transforms[1] = fbx_node->EvaluateLocalTransform(time);
+				}
+			}
+		}
+		parallel_for_each_index(keyframe_count, [&](size_t keyframe_index) {
+			animation::keyframe& keyframe{ animation_clip.sequence.at(keyframe_index) };
 
-			const size_t node_count{ scene_view.nodes.size() };
 			keyframe.nodes.resize(node_count);
 			for (size_t node_index = 0; node_index < node_count; ++node_index)
 			{
-				FbxNode* fbx_node{ fbx_scene->FindNodeByName(scene_view.nodes.at(node_index).name.c_str()) };
-				if (fbx_node)
+				if (fbx_nodes.at(node_index))
 				{
+					const FbxAMatrix* transforms{ &evaluated_transforms.at((keyframe_index * node_count + node_index) * 2) };
 					animation::keyframe::node& node{ keyframe.nodes.at(node_index) };
 					//global_transforḿAV[̃O[oWnɑ΂m[h̕ϊsB
-					node.global_transform = to_xmfloat4x4(fbx_node->EvaluateGlobalTransform(time));
+					node.global_transform = to_xmfloat4x4(transforms[0]);
 					// UNIT.27
 					// local_transform' ́Aẽ[JWnɑ΂m[h̕ϊsB
-					const FbxAMatrix& local_transform{ fbx_node->EvaluateLocalTransform(time) };
+					const FbxAMatrix& local_transform{ transforms[1] };
 					node.scaling = to_xmfloat3(local_transform.GetS());
 					node.rotation = to_xmfloat4(local_transform.GetQ());
 					node.translation = to_xmfloat3(local_transform.GetT());
@@ -947,7 +2287,7 @@ void geometric_substance::fetch_animations(FbxScene* fbx_scene, std::vector<anim
 				}
 #endif
 			}
-		}
+		});
 	}
 	for (int animation_stack_index = 0; animation_stack_index < animation_stack_count; ++animation_stack_index)
 	{
@@ -974,19 +2314,9 @@ void geometric_substance::update_animation(animation::keyframe& keyframe)
 //Aj[Vf[^̒ǉ 
 bool geometric_substance::append_animations(const char* animation_filename, float sampling_rate)
 {
-	FbxManager* fbx_manager{ FbxManager::Create() };
-	FbxScene* fbx_scene{ FbxScene::Create(fbx_manager, "") };
-
-	FbxImporter* fbx_importer{ FbxImporter::Create(fbx_manager, "") };
-	bool import_status{ false };
-	import_status = fbx_importer->Initialize(animation_filename);
-	_ASSERT_EXPR_A(import_status, fbx_importer->GetStatus().GetErrorString());
-	import_status = fbx_importer->Import(fbx_scene);
-	_ASSERT_EXPR_A(import_status, fbx_importer->GetStatus().GetErrorString());
-
-	fetch_animations(fbx_scene, animation_clips, sampling_rate/*0:ftHglgpA0:擾Ȃ*/);
+	const fbx_document document(animation_filename, false);
 
-	fbx_manager->Destroy();
+	fetch_animations(document.scene, animation_clips, sampling_rate/*0:ftHglgpA0:擾Ȃ*/);
 
 	return true;
 }
@@ -1011,6 +2341,489 @@ void geometric_substance::blend_animations(const animation::keyframe* keyframes[
 	}
 }
 
+// UNIT.99
+// ŋߎʐ`(David Eberly, "A Fast and Accurate Algorithm for Computing SLERP", 2011)B
+// sin(t)/sin = t(1 + b1(x - 1)(1 + b2(x - 1)(1 + ...)))Abi = (t^2 - i^2) / (i(2i + 1))Ax = cos 8őł؂A
+// Ō̍Ɍ덷}␳|Bt̓uh̊ԈȂ̂ŁAWbi͌ĂяoƂ1񂾂߂
+static const int SLERP_TERMS{ 8 };
+inline void slerp_coefficients(float t, float coefficients[SLERP_TERMS])
+{
+	const double correction{ 1.85298109240830 };
+	for (int i = 1; i <= SLERP_TERMS; ++i)
+	{
+		coefficients[i - 1] = static_cast<float>((i == SLERP_TERMS ? correction : 1.0) * (t * t - i * i) / (i * (2.0 * i + 1)));
+	}
+}
+template<class lanes>
+inline typename lanes::type slerp_weight(float t, const typename lanes::type coefficients[SLERP_TERMS], typename lanes::type x_minus_one)
+{
+	const typename lanes::type one{ lanes::set1(1.0f) };
+	typename lanes::type weight{ one };
+	for (int i = SLERP_TERMS - 1; i >= 0; --i)
+	{
+		weight = lanes::add(one, lanes::mul(lanes::mul(coefficients[i], x_minus_one), weight));
+	}
+	return lanes::mul(lanes::set1(t), weight);
+}
+// XP[ƈړXMVectorLerpƓŕԂB]XMQuaternionSlerpƓςȂЕ𔽓]ĒŽʂ
+template<class lanes>
+void blend_poses_kernel(const pose_soa& pose0, const pose_soa& pose1, float factor, pose_soa& pose)
+{
+	using vector = typename lanes::type;
+	const vector t{ lanes::set1(factor) };
+	const vector zero{ lanes::set1(0.0f) };
+	const vector one{ lanes::set1(1.0f) };
+	const vector sign_bit{ lanes::set1(-0.0f) };
+	float coefficients[2][SLERP_TERMS];
+	slerp_coefficients(1.0f - factor, coefficients[0]);
+	slerp_coefficients(factor, coefficients[1]);
+	vector c0[SLERP_TERMS], c1[SLERP_TERMS];
+	for (int i = 0; i < SLERP_TERMS; ++i)
+	{
+		c0[i] = lanes::set1(coefficients[0][i]);
+		c1[i] = lanes::set1(coefficients[1][i]);
+	}
+
+	for (size_t base = 0; base < pose.node_count; base += lanes::width)
+	{
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			const vector s0{ lanes::load(&pose0.scaling[axis][base]) };
+			lanes::store(&pose.scaling[axis][base], lanes::add(s0, lanes::mul(lanes::sub(lanes::load(&pose1.scaling[axis][base]), s0), t)));
+			const vector t0{ lanes::load(&pose0.translation[axis][base]) };
+			lanes::store(&pose.translation[axis][base], lanes::add(t0, lanes::mul(lanes::sub(lanes::load(&pose1.translation[axis][base]), t0), t)));
+		}
+
+		vector q0[4], q1[4];
+		vector cosine{ zero };
+		for (size_t axis = 0; axis < 4; ++axis)
+		{
+			q0[axis] = lanes::load(&pose0.rotation[axis][base]);
+			q1[axis] = lanes::load(&pose1.rotation[axis][base]);
+			cosine = lanes::add(cosine, lanes::mul(q0[axis], q1[axis]));
+		}
+		const vector sign{ lanes::logical_and(lanes::less(cosine, zero), sign_bit) };
+		const vector x_minus_one{ lanes::sub(lanes::logical_xor(cosine, sign), one) };
+		const vector w0{ slerp_weight<lanes>(1.0f - factor, c0, x_minus_one) };
+		const vector w1{ lanes::logical_xor(slerp_weight<lanes>(factor, c1, x_minus_one), sign) };
+		for (size_t axis = 0; axis < 4; ++axis)
+		{
+			lanes::store(&pose.rotation[axis][base], lanes::add(lanes::mul(q0[axis], w0), lanes::mul(q1[axis], w1)));
+		}
+	}
+}
+using blend_poses_kernel_function = void(*)(const pose_soa&, const pose_soa&, float, pose_soa&);
+void geometric_substance::blend_animations(const pose_soa* poses[2], float factor, pose_soa& pose)
+{
+	_ASSERT_EXPR(poses[0]->node_count == poses[1]->node_count, "The size of the two node arrays must be the same.");
+	static const blend_poses_kernel_function kernel{ supports_avx() ? blend_poses_kernel<avx_lanes> : blend_poses_kernel<sse_lanes> };
+
+	pose.resize(poses[0]->node_count);
+	kernel(*poses[0], *poses[1], factor, pose);
+}
+
+// m[hƂS * R * T(XMMatrixScaling * XMMatrixRotationQuaternion * XMMatrixTranslation)߂
+template<class lanes>
+void local_transforms_kernel(const pose_soa& pose, XMFLOAT4X4* local_transforms)
+{
+	using vector = typename lanes::type;
+	const vector one{ lanes::set1(1.0f) };
+	float m[12][lanes::width];
+	for (size_t base = 0; base < pose.node_count; base += lanes::width)
+	{
+		const vector x{ lanes::load(&pose.rotation[0][base]) };
+		const vector y{ lanes::load(&pose.rotation[1][base]) };
+		const vector z{ lanes::load(&pose.rotation[2][base]) };
+		const vector w{ lanes::load(&pose.rotation[3][base]) };
+		const vector x2{ lanes::add(x, x) }, y2{ lanes::add(y, y) }, z2{ lanes::add(z, z) };
+		const vector xx{ lanes::mul(x, x2) }, yy{ lanes::mul(y, y2) }, zz{ lanes::mul(z, z2) };
+		const vector xy{ lanes::mul(x, y2) }, xz{ lanes::mul(x, z2) }, yz{ lanes::mul(y, z2) };
+		const vector wx{ lanes::mul(w, x2) }, wy{ lanes::mul(w, y2) }, wz{ lanes::mul(w, z2) };
+
+		// S͉]s̊esɊ|
+		const vector sx{ lanes::load(&pose.scaling[0][base]) };
+		const vector sy{ lanes::load(&pose.scaling[1][base]) };
+		const vector sz{ lanes::load(&pose.scaling[2][base]) };
+		lanes::store(m[0], lanes::mul(lanes::sub(lanes::sub(one, yy), zz), sx));
+		lanes::store(m[1], lanes::mul(lanes::add(xy, wz), sx));
+		lanes::store(m[2], lanes::mul(lanes::sub(xz, wy), sx));
+		lanes::store(m[3], lanes::mul(lanes::sub(xy, wz), sy));
+		lanes::store(m[4], lanes::mul(lanes::sub(lanes::sub(one, xx), zz), sy));
+		lanes::store(m[5], lanes::mul(lanes::add(yz, wx), sy));
+		lanes::store(m[6], lanes::mul(lanes::add(xz, wy), sz));
+		lanes::store(m[7], lanes::mul(lanes::sub(yz, wx), sz));
+		lanes::store(m[8], lanes::mul(lanes::sub(lanes::sub(one, xx), yy), sz));
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			lanes::store(m[9 + axis], lanes::load(&pose.translation[axis][base]));
+		}
+
+		const size_t lane_count{ std::min<size_t>(lanes::width, pose.node_count - base) };
+		for (size_t lane = 0; lane < lane_count; ++lane)
+		{
+			local_transforms[base + lane] = {
+				m[0][lane], m[1][lane], m[2][lane], 0,
+				m[3][lane], m[4][lane], m[5][lane], 0,
+				m[6][lane], m[7][lane], m[8][lane], 0,
+				m[9][lane], m[10][lane], m[11][lane], 1 };
+		}
+	}
+}
+using local_transforms_kernel_function = void(*)(const pose_soa&, XMFLOAT4X4*);
+void geometric_substance::update_animation(pose_soa& pose) const
+{
+	_ASSERT_EXPR(pose.node_count <= scene_view.nodes.size(), L"The pose has more nodes than the scene.");
+	static const local_transforms_kernel_function kernel{ supports_avx() ? local_transforms_kernel<avx_lanes> : local_transforms_kernel<sse_lanes> };
+
+	XMFLOAT4X4* global_transforms{ pose.global_transforms.data() };
+	kernel(pose, global_transforms);
+
+	// e͕KqOɕł̂ŁA擪珇ɐẽO[oϊ|΂悢
+	const scene::node* nodes{ scene_view.nodes.data() };
+	for (size_t node_index = 0; node_index < pose.node_count; ++node_index)
+	{
+		const int64_t parent_index{ nodes[node_index].parent_index };
+		if (parent_index >= 0)
+		{
+			XMStoreFloat4x4(&global_transforms[node_index], XMLoadFloat4x4(&global_transforms[node_index]) * XMLoadFloat4x4(&global_transforms[parent_index]));
+		}
+	}
+}
+
+// global_transform(node_index)̓m[h̃O[oϊԂ
+// lod_proxiesnullptrłȂ΁Alod_proxies[bone_index] == bone_index̍vZAc͂̍̍sʂ
+template<class global_transform_of>
+inline void concatenate_bone_transforms(const skeleton& bind_pose, const XMFLOAT4X4& mesh_global_transform, global_transform_of global_transform, XMFLOAT4X4* bone_transforms, const int64_t* lod_proxies)
+{
+	_ASSERT_EXPR(bind_pose.bones.size() <= geometric_substance::MAX_BONES, L"The value of the 'bone_count' has exceeded MAX_BONES.");
+	const XMMATRIX inverse_mesh_transform{ XMMatrixInverse(nullptr, XMLoadFloat4x4(&mesh_global_transform)) };
+	const skeleton::bone* bones{ bind_pose.bones.data() };
+	const size_t bone_count{ bind_pose.bones.size() };
+	for (size_t bone_index = 0; bone_index < bone_count; ++bone_index)
+	{
+		if (lod_proxies && lod_proxies[bone_index] != static_cast<int64_t>(bone_index))
+		{
+			continue;
+		}
+		XMStoreFloat4x4(&bone_transforms[bone_index],
+			XMLoadFloat4x4(&bones[bone_index].offset_transform) *
+			XMLoadFloat4x4(&global_transform(bones[bone_index].node_index)) *
+			inverse_mesh_transform
+		);
+	}
+	if (lod_proxies)
+	{
+		// c̍s񂪏oĂʂ(bones͐eɕłƂ͌Ȃ)
+		for (size_t bone_index = 0; bone_index < bone_count; ++bone_index)
+		{
+			bone_transforms[bone_index] = bone_transforms[lod_proxies[bone_index]];
+		}
+	}
+}
+inline const int64_t* lod_proxies_of(const skeleton& bind_pose, bool reduced_bones)
+{
+	return reduced_bones && bind_pose.lod_proxies.size() == bind_pose.bones.size() ? bind_pose.lod_proxies.data() : nullptr;
+}
+void geometric_substance::make_bone_transforms(const mesh& mesh, const animation::keyframe& keyframe, XMFLOAT4X4* bone_transforms, bool reduced_bones)
+{
+	const animation::keyframe::node* nodes{ keyframe.nodes.data() };
+	concatenate_bone_transforms(mesh.bind_pose, keyframe.nodes.at(mesh.node_index).global_transform,
+		[nodes](int64_t node_index) -> const XMFLOAT4X4& { return nodes[node_index].global_transform; }, bone_transforms, lod_proxies_of(mesh.bind_pose, reduced_bones));
+}
+void geometric_substance::make_bone_transforms(const mesh& mesh, const pose_soa& pose, XMFLOAT4X4* bone_transforms, bool reduced_bones)
+{
+	const XMFLOAT4X4* global_transforms{ pose.global_transforms.data() };
+	concatenate_bone_transforms(mesh.bind_pose, pose.global_transforms.at(mesh.node_index),
+		[global_transforms](int64_t node_index) -> const XMFLOAT4X4& { return global_transforms[node_index]; }, bone_transforms, lod_proxies_of(mesh.bind_pose, reduced_bones));
+}
+
+void animation::sample(float time, keyframe& pose) const
+{
+	_ASSERT_EXPR(sequence.size() > 0, L"The animation clip has no keyframes.");
+	const float frame{ std::clamp(time * sampling_rate, 0.0f, static_cast<float>(sequence.size() - 1)) };
+	const size_t frame_index{ static_cast<size_t>(frame) };
+	const float factor{ frame - frame_index };
+	const keyframe& keyframe0{ sequence.at(frame_index) };
+	const keyframe& keyframe1{ sequence.at(std::min<size_t>(frame_index + 1, sequence.size() - 1)) };
+
+	const size_t node_count{ keyframe0.nodes.size() };
+	pose.nodes.resize(node_count);
+	for (size_t node_index = 0; node_index < node_count; ++node_index)
+	{
+		const keyframe::node& node0{ keyframe0.nodes.at(node_index) };
+		const keyframe::node& node1{ keyframe1.nodes.at(node_index) };
+		keyframe::node& node{ pose.nodes.at(node_index) };
+		XMStoreFloat3(&node.scaling, XMVectorLerp(XMLoadFloat3(&node0.scaling), XMLoadFloat3(&node1.scaling), factor));
+		XMStoreFloat4(&node.rotation, XMQuaternionSlerp(XMLoadFloat4(&node0.rotation), XMLoadFloat4(&node1.rotation), factor));
+		XMStoreFloat3(&node.translation, XMVectorLerp(XMLoadFloat3(&node0.translation), XMLoadFloat3(&node1.translation), factor));
+	}
+}
+
+// smallest-three: Βlő̐ȂAc3[-1/2, 1/2]͈̔͂15bitŎBȂ̈ʒu[0][1]̍ŏbitɓ
+static const float SMALLEST_THREE_RANGE{ 0.70710678f };
+inline void encode_quaternion(const XMFLOAT4& rotation, uint16_t encoded[3])
+{
+	XMFLOAT4 normalized;
+	XMStoreFloat4(&normalized, XMQuaternionNormalize(XMLoadFloat4(&rotation)));
+	const float components[4]{ normalized.x, normalized.y, normalized.z, normalized.w };
+	int largest{ 0 };
+	for (int component_index = 1; component_index < 4; ++component_index)
+	{
+		if (std::fabs(components[component_index]) > std::fabs(components[largest]))
+		{
+			largest = component_index;
+		}
+	}
+	// q-q͓]Ȃ̂ŁAȂɂȂ
+	const float sign{ components[largest] < 0 ? -1.0f : 1.0f };
+	for (int component_index = 0, encoded_index = 0; component_index < 4; ++component_index)
+	{
+		if (component_index != largest)
+		{
+			const float value{ std::clamp(components[component_index] * sign / SMALLEST_THREE_RANGE, -1.0f, 1.0f) };
+			encoded[encoded_index++] = static_cast<uint16_t>(std::lround((value * 0.5f + 0.5f) * 32767.0f));
+		}
+	}
+	encoded[0] |= static_cast<uint16_t>((largest & 1) << 15);
+	encoded[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+}
+inline XMVECTOR decode_quaternion(const uint16_t encoded[3])
+{
+	const int largest{ (encoded[0] >> 15) | ((encoded[1] >> 15) << 1) };
+	float components[4];
+	float sum_of_squares{ 0 };
+	for (int component_index = 0, encoded_index = 0; component_index < 4; ++component_index)
+	{
+		if (component_index != largest)
+		{
+			const float value{ ((encoded[encoded_index++] & 0x7fff) / 32767.0f * 2.0f - 1.0f) * SMALLEST_THREE_RANGE };
+			components[component_index] = value;
+			sum_of_squares += value * value;
+		}
+	}
+	components[largest] = std::sqrt(std::max<float>(0.0f, 1.0f - sum_of_squares));
+	return XMVectorSet(components[0], components[1], components[2], components[3]);
+}
+inline uint16_t to_unorm16(float value, float minimum, float extent)
+{
+	return extent > 0 ? static_cast<uint16_t>(std::lround(std::clamp((value - minimum) / extent, 0.0f, 1.0f) * 65535.0f)) : 0;
+}
+inline float from_unorm16(uint16_t value, float minimum, float extent)
+{
+	return minimum + extent * (value / 65535.0f);
+}
+inline XMVECTOR decode_key(const compressed_animation::track& track, size_t channel, const uint16_t encoded[3])
+{
+	if (channel == 1)
+	{
+		return decode_quaternion(encoded);
+	}
+	return XMVectorSet(from_unorm16(encoded[0], track.minimum.x, track.extent.x), from_unorm16(encoded[1], track.minimum.y, track.extent.y), from_unorm16(encoded[2], track.minimum.z, track.extent.z), 0);
+}
+inline XMVECTOR interpolate_key(size_t channel, FXMVECTOR value0, FXMVECTOR value1, float factor)
+{
+	return channel == 1 ? XMQuaternionSlerp(value0, value1, factor) : XMVectorLerp(value0, value1, factor);
+}
+inline float key_error(size_t channel, FXMVECTOR value, FXMVECTOR expected)
+{
+	if (channel == 1)
+	{
+		// PʃNH[^jI̍̒d]p̍4asin(d/2)ɂȂ
+		const XMVECTOR aligned{ XMVectorGetX(XMVector4Dot(value, expected)) < 0 ? XMVectorNegate(expected) : expected };
+		return 4.0f * std::asin(std::min<float>(1.0f, XMVectorGetX(XMVector4Length(XMVectorSubtract(value, aligned))) * 0.5f));
+	}
+	return XMVectorGetX(XMVector3Length(XMVectorSubtract(value, expected)));
+}
+// decoded(ʎqĖ߂l)̑ÕL[̕Ԃsamplesmax_errorȓɍČłȂt[L[ƂĎcB
+// ŏ̃t[͕KL[ɂȂBSt[ŏ̃L[ōČł΃L[1ɂȂ
+std::vector<uint32_t> reduce_keys(size_t channel, const std::vector<XMFLOAT4>& samples, const std::vector<XMFLOAT4>& decoded, float max_error)
+{
+	const uint32_t frame_count{ static_cast<uint32_t>(samples.size()) };
+	std::vector<uint32_t> keys{ 0 };
+	bool constant{ true };
+	for (uint32_t frame = 1; frame < frame_count && constant; ++frame)
+	{
+		constant = key_error(channel, XMLoadFloat4(&decoded.at(0)), XMLoadFloat4(&samples.at(frame))) <= max_error;
+	}
+	if (constant)
+	{
+		return keys;
+	}
+	for (uint32_t key = 0; key + 1 < frame_count;)
+	{
+		uint32_t next_key{ key + 1 };
+		for (uint32_t candidate = key + 2; candidate < frame_count && candidate - key <= compressed_animation::MAX_KEY_INTERVAL; ++candidate)
+		{
+			bool reproducible{ true };
+			for (uint32_t frame = key + 1; frame < candidate && reproducible; ++frame)
+			{
+				const float factor{ static_cast<float>(frame - key) / static_cast<float>(candidate - key) };
+				const XMVECTOR value{ interpolate_key(channel, XMLoadFloat4(&decoded.at(key)), XMLoadFloat4(&decoded.at(candidate)), factor) };
+				reproducible = key_error(channel, value, XMLoadFloat4(&samples.at(frame))) <= max_error;
+			}
+			if (!reproducible)
+			{
+				break;
+			}
+			next_key = candidate;
+		}
+		keys.push_back(next_key);
+		key = next_key;
+	}
+	return keys;
+}
+compressed_animation::compressed_animation(const animation& animation_clip, const tolerance& max_error) :
+	name(animation_clip.name), sampling_rate(animation_clip.sampling_rate), frame_count(static_cast<uint32_t>(animation_clip.sequence.size()))
+{
+	_ASSERT_EXPR(frame_count <= 0x10000, L"The animation clip has too many keyframes to compress.");
+	const size_t node_count{ frame_count > 0 ? animation_clip.sequence.at(0).nodes.size() : 0 };
+	tracks.resize(node_count * 3);
+
+	std::vector<XMFLOAT4> samples(frame_count);
+	std::vector<XMFLOAT4> decoded(frame_count);
+	std::vector<uint16_t> encoded(frame_count * 3);
+	for (size_t node_index = 0; node_index < node_count; ++node_index)
+	{
+		for (size_t channel = 0; channel < 3; ++channel)
+		{
+			track& track{ tracks.at(node_index * 3 + channel) };
+			for (uint32_t frame = 0; frame < frame_count; ++frame)
+			{
+				const animation::keyframe::node& node{ animation_clip.sequence.at(frame).nodes.at(node_index) };
+				samples.at(frame) = channel == 0 ? XMFLOAT4(node.scaling.x, node.scaling.y, node.scaling.z, 0) :
+					channel == 1 ? node.rotation : XMFLOAT4(node.translation.x, node.translation.y, node.translation.z, 0);
+			}
+			if (channel != 1)
+			{
+				XMVECTOR minimum{ XMLoadFloat4(&samples.at(0)) };
+				XMVECTOR maximum{ minimum };
+				for (const XMFLOAT4& sample : samples)
+				{
+					minimum = XMVectorMin(minimum, XMLoadFloat4(&sample));
+					maximum = XMVectorMax(maximum, XMLoadFloat4(&sample));
+				}
+				XMStoreFloat3(&track.minimum, minimum);
+				XMStoreFloat3(&track.extent, XMVectorSubtract(maximum, minimum));
+			}
+			for (uint32_t frame = 0; frame < frame_count; ++frame)
+			{
+				uint16_t* value{ &encoded.at(frame * 3) };
+				const XMFLOAT4& sample{ samples.at(frame) };
+				if (channel == 1)
+				{
+					encode_quaternion(sample, value);
+				}
+				else
+				{
+					value[0] = to_unorm16(sample.x, track.minimum.x, track.extent.x);
+					value[1] = to_unorm16(sample.y, track.minimum.y, track.extent.y);
+					value[2] = to_unorm16(sample.z, track.minimum.z, track.extent.z);
+				}
+				XMStoreFloat4(&decoded.at(frame), decode_key(track, channel, value));
+			}
+
+			const std::vector<uint32_t> keys{ reduce_keys(channel, samples, decoded, channel == 0 ? max_error.scaling : channel == 1 ? max_error.rotation : max_error.translation) };
+			track.first_key = static_cast<uint32_t>(key_frames.size());
+			track.key_count = static_cast<uint32_t>(keys.size());
+			for (uint32_t key : keys)
+			{
+				key_frames.push_back(static_cast<uint16_t>(key));
+				key_values.insert(key_values.end(), encoded.begin() + key * 3, encoded.begin() + key * 3 + 3);
+			}
+		}
+	}
+}
+void compressed_animation::sample(float time, animation::keyframe& pose) const
+{
+	const size_t node_count{ this->node_count() };
+	pose.nodes.resize(node_count);
+	const float frame{ std::clamp(time * sampling_rate, 0.0f, frame_count > 0 ? static_cast<float>(frame_count - 1) : 0.0f) };
+	for (size_t node_index = 0; node_index < node_count; ++node_index)
+	{
+		animation::keyframe::node& node{ pose.nodes.at(node_index) };
+		for (size_t channel = 0; channel < 3; ++channel)
+		{
+			const track& track{ tracks.at(node_index * 3 + channel) };
+			// frame2̃L[TBframeŌ̃L[Ȃ炻̃L[̒l̂܂
+			const uint16_t* first_key{ key_frames.data() + track.first_key };
+			const uint16_t* last_key{ first_key + track.key_count };
+			const uint16_t* next_key{ std::upper_bound(first_key, last_key, frame, [](float frame, uint16_t key_frame) { return frame < key_frame; }) };
+			const size_t key0{ track.first_key + static_cast<size_t>(next_key - first_key) - 1 };
+			XMVECTOR value{ decode_key(track, channel, &key_values.at(key0 * 3)) };
+			if (next_key != last_key)
+			{
+				const float factor{ (frame - key_frames.at(key0)) / (*next_key - key_frames.at(key0)) };
+				value = interpolate_key(channel, value, decode_key(track, channel, &key_values.at((key0 + 1) * 3)), factor);
+			}
+			switch (channel)
+			{
+			case 0:
+				XMStoreFloat3(&node.scaling, value);
+				break;
+			case 1:
+				XMStoreFloat4(&node.rotation, value);
+				break;
+			default:
+				XMStoreFloat3(&node.translation, value);
+				break;
+			}
+		}
+	}
+}
+inline XMVECTOR channel_value(const animation::keyframe::node& node, size_t channel)
+{
+	return channel == 0 ? XMLoadFloat3(&node.scaling) : channel == 1 ? XMLoadFloat4(&node.rotation) : XMLoadFloat3(&node.translation);
+}
+bool compressed_animation::reproduces(const animation& animation_clip, const tolerance& max_error) const
+{
+	static const float ROTATION_QUANTIZATION_ERROR{ 0.0002f }; // smallest-three15bitōő0.00013WAق
+	static const float ROUNDING_ERROR{ 0.00001f }; // bt[ԍɖ߂Ƃ̊ۂ߂ŕԂ̌W킸ɂ镪(ړƃXP[͒l̑傫ɔႳ)
+	if (animation_clip.sequence.size() != frame_count)
+	{
+		return false;
+	}
+	animation::keyframe baked_pose;
+	animation::keyframe compressed_pose;
+	for (uint32_t frame = 0; frame < frame_count; ++frame)
+	{
+		const float time{ frame / sampling_rate };
+		const animation::keyframe& keyframe{ animation_clip.sequence.at(frame) };
+		animation_clip.sample(time, baked_pose);
+		sample(time, compressed_pose);
+		for (size_t node_index = 0; node_index < node_count(); ++node_index)
+		{
+			for (size_t channel = 0; channel < 3; ++channel)
+			{
+				const XMVECTOR expected{ channel_value(keyframe.nodes.at(node_index), channel) };
+				const float quantization_error{ channel == 1 ? ROTATION_QUANTIZATION_ERROR : 0.5f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&tracks.at(node_index * 3 + channel).extent))) / 65535.0f };
+				const float rounding_error{ ROUNDING_ERROR * (channel == 1 ? 1.0f : 1.0f + XMVectorGetX(XMVector3Length(expected))) };
+				const float bound{ std::max(channel == 0 ? max_error.scaling : channel == 1 ? max_error.rotation : max_error.translation, quantization_error) + rounding_error };
+				if (key_error(channel, channel_value(baked_pose.nodes.at(node_index), channel), expected) > bound ||
+					key_error(channel, channel_value(compressed_pose.nodes.at(node_index), channel), expected) > bound)
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+void geometric_substance::compress_animations(const compressed_animation::tolerance& max_error, bool discard_keyframes)
+{
+	compressed_animation_clips.resize(animation_clips.size());
+	parallel_for_each_index(animation_clips.size(), [&](size_t clip_index) {
+		compressed_animation_clips.at(clip_index) = compressed_animation(animation_clips.at(clip_index), max_error);
+		// fobOrhł͏ĂтɁÃNbve덷ōČłĂ邩m߂
+		_ASSERT_EXPR(compressed_animation_clips.at(clip_index).reproduces(animation_clips.at(clip_index), max_error), L"The compressed animation clip is out of tolerance.");
+	});
+	if (discard_keyframes)
+	{
+		for (animation& animation_clip : animation_clips)
+		{
+			std::vector<animation::keyframe>().swap(animation_clip.sequence);
+		}
+	}
+}
 
 std::unordered_map<std::string, std::shared_ptr<geometric_substance>> geometric_substance::_geometric_substances;
 std::mutex geometric_substance::_mutex;
@@ -27,6 +27,12 @@
 #include <memory>
 #include <unordered_map>
 #include <mutex>
+#include <filesystem>
+#include <algorithm>
+#include <cfloat>
+
+#include "mesh_optimizer.h"
+
 
 namespace DirectX
 {
@@ -101,18 +107,54 @@ struct skeleton
 		}
 	};
 	std::vector<bone> bones;
+	// unique_idbones̈ʒuBboneŝŃVACYALbVǂ񂾂Ƃrebuild_indicesō蒼
+	std::unordered_map<uint64_t, int64_t> indices;
+	void rebuild_indices()
+	{
+		indices.clear();
+		for (size_t bone_index = 0; bone_index < bones.size(); ++bone_index)
+		{
+			indices.emplace(bones.at(bone_index).unique_id, static_cast<int64_t>(bone_index));
+		}
+	}
 	int64_t indexof(uint64_t unique_id) const
 	{
-		int64_t index{ 0 };
-		for (const bone& bone : bones)
+		const auto index{ indices.find(unique_id) };
+		return index != indices.end() ? index->second : -1;
+	}
+	// UNIT.99 Aj[VLODŏkނƂɂ]鍜̃}XN(0:]Ȃ)BȂSĂ̍]B
+	// ]Ȃ́Acԋ߂c̃{[ŝ܂܎g(cɑ΂ăoCh|[Ŷ܂ܕtĂ)B
+	// smask_lod_bonesō̂ŃVACYȂ
+	std::vector<uint8_t> lod_mask;
+	std::vector<int64_t> lod_proxies; // ƂɁAkނƂɃ{[s؂鍜̈ʒu
+	// keep(bone, height)true̍cBheight͈Ԑ[q܂ł̒i([̍0)BêȂ͏Ɏc
+	void mask_lod_bones(const std::function<bool(const bone&, size_t height)>& keep)
+	{
+		const size_t bone_count{ bones.size() };
+		std::vector<size_t> heights(bone_count, 0);
+		for (size_t bone_index = 0; bone_index < bone_count; ++bone_index)
 		{
-			if (bone.unique_id == unique_id)
+			size_t height{ 1 };
+			for (int64_t parent_index = bones.at(bone_index).parent_index; parent_index >= 0; parent_index = bones.at(parent_index).parent_index, ++height)
 			{
-				return index;
+				heights.at(parent_index) = std::max(heights.at(parent_index), height);
 			}
-			++index;
 		}
-		return -1;
+		lod_mask.resize(bone_count);
+		lod_proxies.resize(bone_count);
+		for (size_t bone_index = 0; bone_index < bone_count; ++bone_index)
+		{
+			lod_mask.at(bone_index) = bones.at(bone_index).is_orphan() || keep(bones.at(bone_index), heights.at(bone_index));
+		}
+		for (size_t bone_index = 0; bone_index < bone_count; ++bone_index)
+		{
+			int64_t proxy_index{ static_cast<int64_t>(bone_index) };
+			while (!lod_mask.at(proxy_index))
+			{
+				proxy_index = bones.at(proxy_index).parent_index;
+			}
+			lod_proxies.at(bone_index) = proxy_index;
+		}
 	}
 #if 0
 	int64_t indexof(string name) const
@@ -134,6 +176,10 @@ struct skeleton
 	void serialize(T& archive)
 	{
 		archive(bones);
+		if constexpr (T::is_loading::value)
+		{
+			rebuild_indices();
+		}
 	}
 };
 // UNIT.25
@@ -171,6 +217,11 @@ struct animation
 	};
 	std::vector<keyframe> sequence;
 
+	// UNIT.99
+	// timeb̎pÕL[t[scalingErotationEtranslationԂposeɏށB
+	// global_transform͏Ȃ̂ŁAgeometric_substance::update_animationō蒼
+	void sample(float time, keyframe& pose) const;
+
 	// UNIT.30
 	template<class T>
 	void serialize(T& archive)
@@ -179,6 +230,155 @@ struct animation
 	}
 };
 
+// UNIT.99
+// pSoA(Structure of Arrays)`ŕׂ́Bgeometric_substanceSIMDblend_animationsEupdate_animation
+// m[h4(SSE)܂8(AVX)܂Ƃ߂ďB
+// ezSIMD̒[ǂ݉z悤ɗ]ɊmۂA]͒Pʎp(XP[1A]Ȃ)Ŗ߂
+struct pose_soa
+{
+	static const size_t PADDING{ 8 };
+
+	std::vector<float> scaling[3];
+	std::vector<float> rotation[4]; // ]NH[^jI(x, y, z, w)
+	std::vector<float> translation[3];
+	// update_animationōm[h̃O[oϊBs̘A͐eq1ŝAoŜ܂܎
+	std::vector<DirectX::XMFLOAT4X4> global_transforms;
+	size_t node_count{ 0 };
+
+	void resize(size_t count)
+	{
+		node_count = count;
+		const size_t padded_count{ (count + PADDING - 1) / PADDING * PADDING };
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			scaling[axis].resize(padded_count, 1.0f);
+			translation[axis].resize(padded_count, 0.0f);
+		}
+		for (size_t axis = 0; axis < 4; ++axis)
+		{
+			rotation[axis].resize(padded_count, axis == 3 ? 1.0f : 0.0f);
+		}
+		global_transforms.resize(count);
+	}
+	void set(size_t index, const animation::keyframe::node& node)
+	{
+		scaling[0].at(index) = node.scaling.x;
+		scaling[1].at(index) = node.scaling.y;
+		scaling[2].at(index) = node.scaling.z;
+		rotation[0].at(index) = node.rotation.x;
+		rotation[1].at(index) = node.rotation.y;
+		rotation[2].at(index) = node.rotation.z;
+		rotation[3].at(index) = node.rotation.w;
+		translation[0].at(index) = node.translation.x;
+		translation[1].at(index) = node.translation.y;
+		translation[2].at(index) = node.translation.z;
+		global_transforms.at(index) = node.global_transform;
+	}
+	void get(size_t index, animation::keyframe::node& node) const
+	{
+		node.scaling = { scaling[0].at(index), scaling[1].at(index), scaling[2].at(index) };
+		node.rotation = { rotation[0].at(index), rotation[1].at(index), rotation[2].at(index), rotation[3].at(index) };
+		node.translation = { translation[0].at(index), translation[1].at(index), translation[2].at(index) };
+		node.global_transform = global_transforms.at(index);
+	}
+	// animation::samplecompressed_animation::sampleōL[t[ǂݍ
+	void assign(const animation::keyframe& keyframe)
+	{
+		resize(keyframe.nodes.size());
+		for (size_t node_index = 0; node_index < node_count; ++node_index)
+		{
+			set(node_index, keyframe.nodes.at(node_index));
+		}
+	}
+	// renderAcast_shadowAjointɓnL[t[ɏo
+	void store(animation::keyframe& keyframe) const
+	{
+		keyframe.nodes.resize(node_count);
+		for (size_t node_index = 0; node_index < node_count; ++node_index)
+		{
+			get(node_index, keyframe.nodes.at(node_index));
+		}
+	}
+};
+
+// UNIT.99
+// animationkNbvBglobal_transform͎Am[hƂ̃XP[E]Eړ̃gbNB
+// ]smallest-three(48bit)AXP[ƈړ̓gbNƂ͈̔͂16bitɗʎqA
+// ÕL[̕Ԃŋe덷ɍČłL[t[͎菜(̃gbN̓L[1ɂȂ)B
+// global_transforḿAsampleŏ񂾎pgeometric_substance::update_animationō蒼
+struct compressed_animation
+{
+	// ԂgbNƌ̃L[t[̍̏B]͗ʎqōő0.00013WAقǂ
+	struct tolerance
+	{
+		float scaling{ 0.0001f };
+		float rotation{ 0.0005f }; // WA
+		float translation{ 0.001f }; // f̒P
+	};
+	// 1̃L[菜ĂÃL[܂ł̃t[藣Ȃ(kɂ鎞Ԃ}邽)
+	static const uint16_t MAX_KEY_INTERVAL{ 64 };
+
+	std::string name;
+	float sampling_rate{ 0 };
+	uint32_t frame_count{ 0 };
+
+	// m[hƂscalingArotationAtranslation̏3{
+	struct track
+	{
+		uint32_t first_key{ 0 };
+		uint32_t key_count{ 0 };
+		// XP[ƈړ̗ʎq͈̔́Blminimum + extent * (ʎql / 65535)
+		DirectX::XMFLOAT3 minimum{ 0, 0, 0 };
+		DirectX::XMFLOAT3 extent{ 0, 0, 0 };
+
+		template<class T>
+		void serialize(T& archive)
+		{
+			archive(first_key, key_count, minimum, extent);
+		}
+	};
+	std::vector<track> tracks;
+	std::vector<uint16_t> key_frames; // L[̃t[ԍBgbNƂɏ
+	std::vector<uint16_t> key_values; // L[Ƃ3
+
+	compressed_animation() = default;
+	compressed_animation(const animation& animation_clip, const tolerance& max_error);
+
+	size_t node_count() const
+	{
+		return tracks.size() / 3;
+	}
+	float duration() const
+	{
+		return frame_count > 0 ? (frame_count - 1) / sampling_rate : 0;
+	}
+	// timeb̎pÕL[Ԃpose.nodesscalingErotationEtranslationɏށBglobal_transform͏Ȃ
+	void sample(float time, animation::keyframe& pose) const;
+	// kanimation_clip̊eL[t[̎ŁAanimation::samplesample̎pǂ̃L[t[max_errorȓɂtrueԂB
+	// L[ƂĎct[͗ʎql̂̂Ȃ̂ŁAʎq̌덷܂ł͋
+	bool reproduces(const animation& animation_clip, const tolerance& max_error) const;
+	size_t size_in_bytes() const
+	{
+		return sizeof(*this) + name.size() + tracks.size() * sizeof(track) + (key_frames.size() + key_values.size()) * sizeof(uint16_t);
+	}
+
+	template<class T>
+	void serialize(T& archive)
+	{
+		archive(name, sampling_rate, frame_count, tracks, key_frames, key_values);
+	}
+};
+
+// animation_sequencerNbv̒m邽
+inline size_t keyframe_count(const animation& animation_clip)
+{
+	return animation_clip.sequence.size();
+}
+inline size_t keyframe_count(const compressed_animation& animation_clip)
+{
+	return animation_clip.frame_count;
+}
+
 // UNIT.99
 template <class T>
 struct animation_sequencer
@@ -189,6 +389,7 @@ private:
 
 	float _tick = 0.0f;
 	size_t _frame = 0;
+	float _time = 0.0f; // _frameɑΉĐʒu(b)Bsample͂̎̎pԂ
 	bool _loop_time = false;
 
 public:
@@ -207,19 +408,24 @@ public:
 		{
 			_frame = 0;
 			_tick = 0;
+			_time = 0;
 		}
 	}
 	T clip() const
 	{
 		return _clip;
 	}
-	bool tictac(const std::vector<animation>& animation_clips, float delta_time)
+	// animation_clipsstd::vector<animation>std::vector<compressed_animation>
+	template<class C>
+	bool tictac(const std::vector<C>& animation_clips, float delta_time)
 	{
-		_frame = static_cast<size_t>(_tick * animation_clips.at(static_cast<size_t>(_clip)).sampling_rate);
+		const float sampling_rate = animation_clips.at(static_cast<size_t>(_clip)).sampling_rate;
+		_frame = static_cast<size_t>(_tick * sampling_rate);
+		_time = _tick;
 		_prev_clip = _clip;
 
 		bool has_ended = false;
-		size_t end_of_frame = animation_clips.at(static_cast<size_t>(_clip)).sequence.size();
+		size_t end_of_frame = keyframe_count(animation_clips.at(static_cast<size_t>(_clip)));
 		if (_frame < end_of_frame)
 		{
 			// playbacking
@@ -232,11 +438,13 @@ public:
 				// loop playback
 				_frame = 0;
 				_tick = 0;
+				_time = 0;
 			}
 			else
 			{
 				// stops on last frame
 				_frame = end_of_frame - 1;
+				_time = _frame / sampling_rate;
 				has_ended = true;
 			}
 		}
@@ -250,6 +458,17 @@ public:
 	{
 		return _frame;
 	}
+	// keyframeƈႢAL[t[̊Ԃ̎łԂpԂ̂ŁAႢsampling_rateœǂݍ񂾃Nbvł炩ɂȂB
+	// global_transform͏Ȃ̂ŁAposegeometric_substance::update_animationɓnĂ`Ɏg
+	template<class C>
+	void sample(const std::vector<C>& animation_clips, animation::keyframe& pose) const
+	{
+		animation_clips.at(static_cast<size_t>(_clip)).sample(_time, pose);
+	}
+	float time() const
+	{
+		return _time;
+	}
 
 };
 
@@ -278,18 +497,20 @@ class geometric_substance // UNIT.99
 			}
 		};
 		std::vector<node> nodes;
-		int64_t indexof(uint64_t unique_id) const
+		// unique_idnodes̈ʒuBnodeŝŃVACYALbVǂ񂾂Ƃrebuild_indicesō蒼
+		std::unordered_map<uint64_t, int64_t> indices;
+		void rebuild_indices()
 		{
-			int64_t index{ 0 };
-			for (const node& node : nodes)
+			indices.clear();
+			for (size_t node_index = 0; node_index < nodes.size(); ++node_index)
 			{
-				if (node.unique_id == unique_id)
-				{
-					return index;
-				}
-				++index;
+				indices.emplace(nodes.at(node_index).unique_id, static_cast<int64_t>(node_index));
 			}
-			return -1;
+		}
+		int64_t indexof(uint64_t unique_id) const
+		{
+			const auto index{ indices.find(unique_id) };
+			return index != indices.end() ? index->second : -1;
 		}
 #if 0
 		int64_t indexof(string name) const
@@ -311,6 +532,10 @@ class geometric_substance // UNIT.99
 		void serialize(T& archive)
 		{
 			archive(nodes);
+			if constexpr (T::is_loading::value)
+			{
+				rebuild_indices();
+			}
 		}
 	};
 
@@ -359,6 +584,40 @@ public:
 		}
 	};
 	static const int MAX_BONES{ 256 }; // UNIT.23
+
+	// _̊i[`(AZbgƂɏĂݎɑI)
+	// compact:̓AZû܂ܓWJł`ɋl߁A@EڐEUVE{[̉e68oCg28oCgɂB
+	// VF[_[猩ľ^͕ςȂ̂ŁA_VF[_[̓CAEgւĎgBʒufloat̂܂
+	// compact_float_texcoord:compactƓUVfloat̂܂܎(32oCg)B^Cn`̂悤UV͈̔͂L
+	// FLOAT16ł͐xȂ̂ŁAcompactw肵ĂUVHALF_TEXCOORD_LIMIT𒴂AZbg͏ĂƂɂɂ
+	enum class vertex_format { standard, compact, compact_float_texcoord };
+	static bool is_compact(vertex_format format) { return format == vertex_format::compact || format == vertex_format::compact_float_texcoord; }
+	// FLOAT16[-2, 2]𒴂ƊԊu1/512eȂA1024sNZ̃eNX`1eNZȏジ
+	static constexpr float HALF_TEXCOORD_LIMIT{ 2.0f };
+	struct compact_vertex_extra_attribute
+	{
+		int16_t normal[4]; // SNORM16BwR32G32B32_FLOAT̂Ƃɓ̓AZu₤lƓ1ɂ
+		int16_t tangent[4]; // SNORM16
+		uint16_t texcoord[2]; // FLOAT16
+	};
+	struct compact_float_texcoord_vertex_extra_attribute
+	{
+		int16_t normal[4]; // SNORM16
+		int16_t tangent[4]; // SNORM16
+		DirectX::XMFLOAT2 texcoord;
+	};
+	struct compact_vertex_bone_influence
+	{
+		uint8_t bone_weights[MAX_BONE_INFLUENCES]; // UNORM8
+		uint8_t bone_indices[MAX_BONE_INFLUENCES]; // MAX_BONES256Ȃ̂8rbgɎ܂
+	};
+	static_assert(MAX_BONES <= 256, "Bone indices of the compact vertex format are 8 bits.");
+	static compact_vertex_extra_attribute compress(const vertex_extra_attribute& vertex);
+	static compact_vertex_bone_influence compress(const vertex_bone_influence& vertex);
+	static compact_float_texcoord_vertex_extra_attribute compress_float_texcoord(const vertex_extra_attribute& vertex);
+	static vertex_extra_attribute decompress(const compact_vertex_extra_attribute& vertex);
+	static vertex_extra_attribute decompress(const compact_float_texcoord_vertex_extra_attribute& vertex);
+	static vertex_bone_influence decompress(const compact_vertex_bone_influence& vertex);
 	struct constants
 	{
 		DirectX::XMFLOAT4X4 world;
@@ -431,14 +690,18 @@ public:
 				DirectX::XMLoadFloat4x4(&geometric_transform) *
 				DirectX::XMLoadFloat4x4(&default_global_transform) *
 				DirectX::XMLoadFloat4x4(&world_transform) };
-			// ϊsgăoEfBO{bNX̍ŏ_ϊ
-			DirectX::XMStoreFloat3(&world_bounding_box[0], DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&bounding_box[0]), concatenated_matrix));
-			// ϊsgăoEfBO{bNX̍ő_ϊ
-			DirectX::XMStoreFloat3(&world_bounding_box[1], DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&bounding_box[1]), concatenated_matrix));
-
-			if (world_bounding_box[0].x > world_bounding_box[1].x) std::swap<float>(world_bounding_box[0].x, world_bounding_box[1].x);
-			if (world_bounding_box[0].y > world_bounding_box[1].y) std::swap<float>(world_bounding_box[0].y, world_bounding_box[1].y);
-			if (world_bounding_box[0].z > world_bounding_box[1].z) std::swap<float>(world_bounding_box[0].z, world_bounding_box[1].z);
+			// ]܂ޕϊł2ł͈͂߂Ȃ̂ŁASƔa8ׂĂ͂AABB߂
+			// Va = |M| * a (Arvo, Graphics Gems 1990)
+			const DirectX::XMVECTOR center{ DirectX::XMVectorScale(DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&bounding_box[0]), DirectX::XMLoadFloat3(&bounding_box[1])), 0.5f) };
+			const DirectX::XMVECTOR extent{ DirectX::XMVectorScale(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&bounding_box[1]), DirectX::XMLoadFloat3(&bounding_box[0])), 0.5f) };
+			DirectX::XMMATRIX absolute_matrix{ concatenated_matrix };
+			absolute_matrix.r[0] = DirectX::XMVectorAbs(absolute_matrix.r[0]);
+			absolute_matrix.r[1] = DirectX::XMVectorAbs(absolute_matrix.r[1]);
+			absolute_matrix.r[2] = DirectX::XMVectorAbs(absolute_matrix.r[2]);
+			const DirectX::XMVECTOR world_center{ DirectX::XMVector3TransformCoord(center, concatenated_matrix) };
+			const DirectX::XMVECTOR world_extent{ DirectX::XMVector3TransformNormal(extent, absolute_matrix) };
+			DirectX::XMStoreFloat3(&world_bounding_box[0], DirectX::XMVectorSubtract(world_center, world_extent));
+			DirectX::XMStoreFloat3(&world_bounding_box[1], DirectX::XMVectorAdd(world_center, world_extent));
 		}
 
 		template<class T>
@@ -477,6 +740,9 @@ public:
 
 
 	std::vector<animation> animation_clips;
+	// UNIT.99 animation_clipsḱB.substanceɏĂƂɍĕۑAǂݍݎ͂̂܂ܓǂށB
+	// ꂪƂanimation_clips͖Osampling_rateAL[t[͋(.substanceɂȂ)
+	std::vector<compressed_animation> compressed_animation_clips;
 
 	//pCvCXe[gꊇǗ邱ƂŁAR[h̕GAeiXコ܂
 	struct pipeline_state
@@ -497,6 +763,60 @@ public:
 		material_constants material_data;
 		ID3D11ShaderResourceView* shader_resource_views[4];
 	};
+	// UNIT.99
+	// CX^X(LN^[)Ƃ̃XLjOp{[s̃LbVBrenderAcast_shadowɓnƁA
+	// keyframeframe_indexOƓ(e̊eJXP[hA{`Akp[eBN̊epX)̓{[s蒼A
+	// bVƂɃAbv[hς݂̒萔obt@oCh邾ɂB
+	// keyframewpĎg񂷏ꍇ̂ŁAĂяo͎pXV邽тframe_indexi߂
+	struct skinning_palette
+	{
+		uint64_t frame_index{ 0 };
+		// Aj[VLOD(select_animation_lodőI)
+		uint32_t update_interval{ 1 };
+		bool reduced_bones{ false };
+		bool visible{ true };
+		// Ƀ{[sƂ(update_skinning_paletterenderAcast_shadow̍ŏ̃pX)Ɏp]ȂtrueB
+		// false̊Ԃ͒O2̕]̕Ԃōςނ̂ŁAĂяo͎pȂĂ悢
+		bool evaluation_due() const
+		{
+			return update_interval <= 1 || evaluated_bone_transforms[1].empty() || evaluated_reduced_bones != reduced_bones || frames_since_evaluation + 1 >= update_interval;
+		}
+	private:
+		// update_skinning_palette(CPU)ō{[sBXLbV̏bone_count
+		std::vector<DirectX::XMFLOAT4X4> bone_transforms;
+		// update_interval2ȏ̂ƂɕԂAO2̕]([1]V)
+		std::vector<DirectX::XMFLOAT4X4> evaluated_bone_transforms[2];
+		uint32_t frames_since_evaluation{ 0 };
+		bool evaluated_reduced_bones{ false };
+		const animation::keyframe* prepared_keyframe{ nullptr };
+		uint64_t prepared_frame_index{ 0 };
+		// 萔obt@ɏ񂾂Ƃkeyframeframe_index
+		const animation::keyframe* uploaded_keyframe{ nullptr };
+		uint64_t uploaded_frame_index{ 0 };
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>> constant_buffers; // meshes̏BXLbVȊOnull
+		friend class geometric_substance;
+	};
+	// palettẽ{[sCPUō(D3DĂ΂Ȃ)BʁXpaletteȂ烏[J[XbhɌĂׂB
+	// Ă΂ȂꍇAĂ񂾌keyframeframe_indexςꍇ́Arendercast_shadow̍ŏ̃pXōB
+	// palette.visiblefalse(ʊO)Ȃ牽Ȃ(e`ꍇrendercast_shadowō)
+	void update_skinning_palette(const animation::keyframe* keyframe, skinning_palette& palette) const;
+
+	// UNIT.99 Aj[VLOD̒iKB_̋distance̍ŏ̒iKgAǂɂȂ΍Ō̒iKg
+	struct animation_lod
+	{
+		float distance;
+		uint32_t update_interval; // {[s]t[̊ԊuBԂ̃t[͒O2̕]Ԃ(update_interval-1t[x)
+		bool reduced_bones; // skeleton::lod_maskŎc]
+	};
+	std::vector<animation_lod> animation_lods{ { 20.0f, 1, false }, { 40.0f, 2, false }, { 80.0f, 4, true }, { FLT_MAX, 8, true } };
+	// SẴXLbVskeleton::mask_lod_bonesĂ
+	void mask_lod_bones(const std::function<bool(const skeleton::bone&, size_t height)>& keep);
+	// worldɒufAABB̒Seye_position̋paletteLODIсAvisible(̓O)palette.visibleɒuB
+	// ̔collision_detectionɈˑȂ悤Ăяo(AN^[)ōsBtransform_bounding_boxAABBgƂ悢B
+	// AABB̓oCh|[Ŷ̂Ȃ̂ŁAAj[Vő傫͂ݏof͑߂ɉʊOƔ肳邱Ƃ
+	void select_animation_lod(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4& eye_position, bool visible, skinning_palette& palette) const;
+	// SbVAABB͂ރ[hԂAABB
+	void transform_bounding_box(const DirectX::XMFLOAT4X4& world, DirectX::XMFLOAT3 world_bounding_box[2]) const;
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> vertex_shaders[4];
@@ -506,27 +826,158 @@ private:
 	
 	Microsoft::WRL::ComPtr<ID3D11GeometryShader> geometry_shader;
 
+	// UNIT.99 XLbṼ{[sXbg1ɃoChB萔obt@ɂbone_count̍s񂾂
+	// (VF[_[͒_QƂ{[ǂ܂Ȃ̂ŁAc͕ŝ܂܂ł悢)
+	void bind_bone_transforms(ID3D11DeviceContext* immediate_context, const mesh& mesh, const animation::keyframe* keyframe, skinning_palette* palette);
+	// UNIT.99 update_skinning_palette̖{́Bpalette.visibleɂ炸
+	void prepare_skinning_palette(const animation::keyframe* keyframe, skinning_palette& palette) const;
 
-	void create_com_objects(ID3D11Device* device, const char* fbx_filename);
+	vertex_format format{ vertex_format::standard };
+	uint32_t vertex_strides[3]{ sizeof(vertex_position), sizeof(vertex_extra_attribute), sizeof(vertex_bone_influence) };
+
+	// _ƃCfbNX̓]
+	struct vertex_streams
+	{
+		const vertex_position* positions{ nullptr };
+		const vertex_extra_attribute* extra_attributes{ nullptr };
+		const vertex_bone_influence* bone_influences{ nullptr };
+		size_t vertex_count{ 0 };
+		const uint32_t* indices{ nullptr };
+		size_t index_count{ 0 };
+		// compactŏĂ.substanceǂ񂾏ꍇ͂g
+		const compact_vertex_extra_attribute* compact_extra_attributes{ nullptr };
+		const compact_vertex_bone_influence* compact_bone_influences{ nullptr };
+		const compact_float_texcoord_vertex_extra_attribute* compact_float_texcoord_extra_attributes{ nullptr }; // compact_float_texcoord̏ꍇ
+	};
+	// LbV(.cereal/.substance)̌ɂȂ́BLbṼwb_[ɋL^AǂݍݎɈvȂΎ̂Ăč蒼
+	struct source_signature
+	{
+		uint64_t source_stamp{ 0 }; // stamp_sources̒l
+		uint64_t source_hash{ 0 }; // hash_sources̒lBLbVsource_stampvĂԂ͋߂Ȃ(resolve_source_hash)
+		bool triangulate{ false };
+		float sampling_rate{ 0 };
+		std::vector<std::string> animation_filenames;
+		// e͓ŁALbVɋL^source_stampÂ(Ύeǂ܂ɍς)BL^Ȃ
+		bool stale_stamp{ false };
+
+		// ̃t@CĂȂ(source_stamp0)ꍇ͓eƍłȂ̂ŁAǂݍ݂̎w肾ׂB
+		// 傫ƍXVLbV̋L^ƓȂeƂ݂ȂAႤƂt@CǂŃnbVŔׂ
+		bool accepts(const source_signature& cached, const char* fbx_filename)
+		{
+			if (triangulate != cached.triangulate || sampling_rate != cached.sampling_rate || animation_filenames != cached.animation_filenames)
+			{
+				return false;
+			}
+			if (source_stamp == 0)
+			{
+				return true;
+			}
+			if (source_stamp == cached.source_stamp)
+			{
+				source_hash = cached.source_hash;
+				stale_stamp = false;
+				return true;
+			}
+			stale_stamp = resolve_source_hash(fbx_filename) == cached.source_hash;
+			return stale_stamp;
+		}
+		// LbVɕۑOɌĂԁB܂߂ĂȂΌ̃t@Cǂsource_hash߂
+		uint64_t resolve_source_hash(const char* fbx_filename)
+		{
+			if (source_hash == 0 && source_stamp != 0)
+			{
+				source_hash = hash_sources(fbx_filename, animation_filenames);
+			}
+			return source_hash;
+		}
+
+		template<class T>
+		void serialize(T& archive)
+		{
+			archive(source_stamp, source_hash, triangulate, sampling_rate, animation_filenames);
+		}
+	};
+	source_signature signature;
+
+	// .cereal:FBXo܂܂̃f[^B擪CEREAL_MAGICACEREAL_VERSIONAsource_signatureu
+	static const uint32_t CEREAL_MAGIC{ 'G' | 'S' << 8 | 'C' << 16 | 'R' << 24 };
+	static const uint32_t CEREAL_VERSION{ 2 };
+	bool load_cereal(const std::filesystem::path& filename, const char* fbx_filename);
+	void save_cereal(const std::filesystem::path& filename) const;
+
+	// mapped_streamsnƁAmeshes̒_z̑ɂ(meshesƓ)obt@
+	void create_com_objects(ID3D11Device* device, const char* fbx_filename, const std::vector<vertex_streams>* mapped_streams = nullptr);
+
+	// .substance:}bvĂ̂܂ܓǂ߂镽RȌ`̃LbV(flat_archive.h)
+	// _ƃCfbNX̓}bvy[W璼GPU֓]Aavoid_create_com_objects̏ꍇmeshes̔zɕʂB
+	// t@CȂAł\̂̑傫ȂAsignatureƈvȂAĂꍇfalseԂB
+	// GPU֓]ꍇrequire_vertex_format̏ꍇ͒_`formatƈقȂƂfalseԂAĂ(compact̎wɂcompact_float_texcoordŏĂt@Cg)
+	bool load_substance(const std::filesystem::path& filename, ID3D11Device* device, const char* fbx_filename, bool avoid_create_com_objects, bool require_vertex_format = false);
+	void save_substance(const std::filesystem::path& filename) const;
+	// ǂݍ.substancesource_stamp̒lɏ(signature.stale_stamp̏ꍇ)
+	void restamp_substance(const std::filesystem::path& filename) const;
+	// _̗nځATuZbgƂ̒_LbVƃI[o[h[̍œKA_tFb`̕בւ
+	void bake_meshes(const char* fbx_filename);
 
 	void spawn(ID3D11Device* device, const char* fbx_filename, bool triangulate, float sampling_rate, bool avoid_create_com_objects,
 		std::function<void(mesh&, mesh::subset& subset)> callback);
 
 public:
-	geometric_substance(ID3D11Device* device, const char* fbx_filename, const std::vector<std::string>& animation_filenames = {}, bool triangulate = false, float sampling_rate = 0, bool avoid_create_com_objects = false/*UNIT.99*/);
+	// require_vertex_format:avoid_create_com_objectsł.substancevertex_formatŏĂ(bake_tool)B
+	// falseȂCPUŎgȂ̂ŁAǂ̌`.substancełǂ
+	geometric_substance(ID3D11Device* device, const char* fbx_filename, const std::vector<std::string>& animation_filenames = {}, bool triangulate = false, float sampling_rate = 0, bool avoid_create_com_objects = false/*UNIT.99*/,
+		vertex_format vertex_format = vertex_format::standard, bool require_vertex_format = false);
 
 	virtual ~geometric_substance() = default;
+
+	static const uint32_t SUBSTANCE_VERSION{ 9 }; // 2:_̗nځA3:Op`ƒ_̕בւA4:_`A5:source_signatureA6:compact_float_texcoordA7:kNbvA8:kNbvΌ̃L[t[ȂA9:source_stamp
+	// FBXƃAj[Vt@C̓e狁߂nbVBǂꂩJȂꍇ0
+	static uint64_t hash_sources(const char* fbx_filename, const std::vector<std::string>& animation_filenames);
+	// FBXƃAj[Vt@C̑傫ƍXV狁߂lBt@Cǂ܂Ȃ̂ŋN̂тɋ߂Ă悢BǂꂩȂꍇ0
+	static uint64_t stamp_sources(const char* fbx_filename, const std::vector<std::string>& animation_filenames);
+	// .substanceɏĂƂ̒_LbV̌(SbṼTuZbg̍v)B0:œKOA1:œK
+	vertex_cache_statistics baked_vertex_cache_statistics[2];
+	// ǂݍݕ̔rB.substanceɏĂ̂ƓbVɂāAseconds[0]cereal̃A[JCuAseconds[1].substance
+	// GPŨobt@I܂ł̕bԂ(nڂƕבւ̌ʂ͊܂܂Ȃ)Bǂ߂Ȃ͕̒lɂȂ
+	static void benchmark_loading(ID3D11Device* device, const char* fbx_filename, float seconds[2], vertex_format vertex_format = vertex_format::standard);
 	//shadow_castingtOϐIɂƁA_ʒuoCh
 
 	void render(ID3D11DeviceContext* immediate_context, const DirectX::XMFLOAT4X4& world, const animation::keyframe* keyframe/*UNIT.25*/,
-		std::function<int(const mesh&, const material&, shader_resources&, pipeline_state&)> callback = [](const mesh&, const material&, shader_resources&, pipeline_state&) { return 0; }/*UNIT.99*/);
-	void cast_shadow(ID3D11DeviceContext* immediate_context, const DirectX::XMFLOAT4X4& world, const animation::keyframe* keyframe);
+		std::function<int(const mesh&, const material&, shader_resources&, pipeline_state&)> callback = [](const mesh&, const material&, shader_resources&, pipeline_state&) { return 0; }/*UNIT.99*/,
+		skinning_palette* palette = nullptr);
+	// visibilitynƁAmeshes̏ɑΉrbgĂȂbV`悵Ȃ(cull_frustum_aabbs̏o)B
+	// instance_count̓JXP[h̐Bcascaded_shadow_map::make_per_cascadeĂԏꍇ1ɂB
+	void cast_shadow(ID3D11DeviceContext* immediate_context, const DirectX::XMFLOAT4X4& world, const animation::keyframe* keyframe,
+		const std::vector<uint64_t>* visibility = nullptr, UINT instance_count = 4, skinning_palette* palette = nullptr);
 	// Aj[V
 	void update_animation(animation::keyframe& keyframe);
 	bool append_animations(const char* animation_filename, float sampling_rate /*0: default*/);
 	void blend_animations(const animation::keyframe* keyframes[2], float factor, animation::keyframe& keyframe);
+	// UNIT.99 SoAŁBm[h4(SSE)܂8(AVX)B
+	// blend_animations̉]͑ŋߎʐ`(Eberly 2011)ŁAXMQuaternionSlerpƂ̍͐2e-5ȉ
+	void update_animation(pose_soa& pose) const;
+	static void blend_animations(const pose_soa* poses[2], float factor, pose_soa& pose);
+	// XLjOp̃{[s(offset_transform * {[global_transform * bVglobal_transform̋ts)bone_transforms
+	// mesh.bind_pose.bones.size()ށBbV̋ts̓{[Ƃł͂Ȃ1񂾂߂
+	// reduced_bonestrueȂskeleton::lod_maskŎcvZAc͑c̍sʂ
+	static void make_bone_transforms(const mesh& mesh, const animation::keyframe& keyframe, DirectX::XMFLOAT4X4* bone_transforms, bool reduced_bones = false);
+	static void make_bone_transforms(const mesh& mesh, const pose_soa& pose, DirectX::XMFLOAT4X4* bone_transforms, bool reduced_bones = false);
+	// animation_clipskcompressed_animation_clipsɒuBdiscard_keyframesw肷animation_clips̃L[t[̂ĂB
+	// ̂Ăanimation_sequencer::keyframegȂ̂ŁAcompressed_animation::sampleupdate_animationŎp
+	void compress_animations(const compressed_animation::tolerance& max_error = {}, bool discard_keyframes = false);
 	
 	DirectX::XMFLOAT4 joint(const char* mesh_name, const char* bone_name, const DirectX::XMFLOAT4X4& transform, const animation::keyframe* keyframe) const
+	{
+		return joint(resolve_joint(mesh_name, bone_name), transform, keyframe);
+	}
+	// UNIT.99 OŒTɁAǂݍ݌Ɉxresolve_jointŋ߂Ďg񂷍̎QƁB
+	// m[ḧʒuȂ̂ŁAfgԂ͂ƗL
+	struct joint_handle
+	{
+		int64_t node_index{ -1 };
+		bool valid() const { return node_index >= 0; }
+	};
+	joint_handle resolve_joint(const char* mesh_name, const char* bone_name) const
 	{
 		for (const geometric_substance::mesh& mesh : meshes)
 		{
@@ -534,26 +985,51 @@ public:
 			for (const skeleton::bone& bone : mesh.bind_pose.bones)
 			{
 				if (bone.name != bone_name) continue;
-
-				const animation::keyframe::node& node = keyframe->nodes.at(bone.node_index);
-				DirectX::XMFLOAT4 joint_position = { node.global_transform._41, node.global_transform._42, node.global_transform._43, 1.0f };
-				DirectX::XMStoreFloat4(&joint_position, DirectX::XMVector3Transform(DirectX::XMLoadFloat4(&joint_position), DirectX::XMLoadFloat4x4(&transform)));
-				return joint_position;
+				return { bone.node_index };
 			}
 		}
 		_ASSERT_EXPR(FALSE, L"Could not find a joint by 'bone-name'.");
-		return { 0, 0, 0, 1 };
+		return {};
+	}
+	// keyframe̎pł̍̈ʒutransformŕϊĕԂBT͂Ȃ
+	DirectX::XMFLOAT4 joint(joint_handle handle, const DirectX::XMFLOAT4X4& transform, const animation::keyframe* keyframe) const
+	{
+		DirectX::XMFLOAT4 joint_position;
+		joints(&handle, 1, transform, keyframe, &joint_position);
+		return joint_position;
+	}
+	// handlescount̍̈ʒu܂Ƃ߂joint_positionsɏށBȎQƂ{ 0, 0, 0, 1 }ɂȂ
+	void joints(const joint_handle* handles, size_t count, const DirectX::XMFLOAT4X4& transform, const animation::keyframe* keyframe, DirectX::XMFLOAT4* joint_positions) const
+	{
+		_ASSERT_EXPR(keyframe, L"'keyframe' must not be null.");
+		const DirectX::XMMATRIX M{ DirectX::XMLoadFloat4x4(&transform) };
+		const animation::keyframe::node* nodes{ keyframe->nodes.data() };
+		const int64_t node_count{ static_cast<int64_t>(keyframe->nodes.size()) };
+		for (size_t joint_index = 0; joint_index < count; ++joint_index)
+		{
+			const int64_t node_index{ handles[joint_index].node_index };
+			if (node_index < 0 || node_index >= node_count)
+			{
+				joint_positions[joint_index] = { 0, 0, 0, 1 };
+				continue;
+			}
+			const DirectX::XMFLOAT4X4& global_transform{ nodes[node_index].global_transform };
+			DirectX::XMStoreFloat4(&joint_positions[joint_index], DirectX::XMVector3Transform(DirectX::XMVectorSet(global_transform._41, global_transform._42, global_transform._43, 1.0f), M));
+		}
 	}
 
 protected:
 	scene scene_view;
 
+	// V[ǂނ̂͂̃XbhōsAǂ񂾒l̒_̑gݗĂbVƂɃ[J[Xbhŕɍs
 	void fetch_meshes(FbxScene* fbx_scene, std::vector<mesh>& meshes);
 	void fetch_materials(FbxScene* fbx_scene, std::unordered_map<uint64_t, material>& materials);
 	
 	void fetch_skeleton(FbxMesh* fbx_mesh, skeleton& bind_pose);
+	std::vector<FbxNode*> fetch_fbx_nodes(FbxScene* fbx_scene) const;
 	
 	//  samplinr_rate̐̏ꍇAAj[Vf[^̓[hȂ
+	// scene_viewǂނŃo[Ȃ̂ŁAʁXFBXt@C̃V[ȂɌĂׂ(V[͎ɒŃTvOAs̕L[t[Ƃɕɍs)
 	void fetch_animations(FbxScene* fbx_scene, std::vector<animation>& animation_clips, float sampling_rate/*l0̏ꍇAAj[Vf[^̓ftHg̃t[[gŃTvO.*/);
 	
 	void fetch_scene(const char* fbx_filename, bool triangulate, float sampling_rate/*l0̏ꍇAAj[Vf[^̓ftHg̃t[[gŃTvO*/);
@@ -566,15 +1042,24 @@ public:
 #if 0
 	static std::shared_ptr<geometric_substance> _at(const char* name) { return _geometric_substances.at(name); }
 #endif
-	static std::shared_ptr<geometric_substance> _emplace(ID3D11Device* device, const char* name, const std::vector<std::string>& animation_filenames = {}, bool triangulate = false, float sampling_rate = 0, bool avoid_create_com_objects = false)
+	static std::shared_ptr<geometric_substance> _emplace(ID3D11Device* device, const char* name, const std::vector<std::string>& animation_filenames = {}, bool triangulate = false, float sampling_rate = 0, bool avoid_create_com_objects = false, vertex_format vertex_format = vertex_format::standard)
 	{
 		if (_geometric_substances.find(name) == _geometric_substances.end())
 		{
 			std::lock_guard<std::mutex> lock(_mutex);
-			_geometric_substances.emplace(std::make_pair(name, std::make_shared<geometric_substance>(device, name, animation_filenames, triangulate, sampling_rate, avoid_create_com_objects)));
+			_geometric_substances.emplace(std::make_pair(name, std::make_shared<geometric_substance>(device, name, animation_filenames, triangulate, sampling_rate, avoid_create_com_objects, vertex_format)));
 		}
 		return _geometric_substances.at(name);
 	}
+	// LbVׂ̂ẴAZbg𖼑OƂƂɗ񋓂
+	static void _enumerate(std::function<void(const std::string& name, const geometric_substance& substance)> callback)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (const std::pair<const std::string, std::shared_ptr<geometric_substance>>& element : _geometric_substances)
+		{
+			callback(element.first, *element.second);
+		}
+	}
 	static void _exterminate()
 	{
 		std::lock_guard<std::mutex> lock(_mutex);
@@ -0,0 +1,204 @@
+#include "heightfield.h"
+#include "collision_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+void heightfield::build(const collision_mesh& collision_mesh, const XMFLOAT4X4& world_transform, float cell_size, float tolerance, job_system* jobs)
+{
+	this->world_transform = world_transform;
+	this->cell_size = cell_size;
+	this->tolerance = tolerance;
+
+	// [hԂ̎Op`߁AŜAABB𓾂
+	XMFLOAT3 bounding_box[2]{ { +FLT_MAX, +FLT_MAX, +FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+	std::vector<XMFLOAT3> steep_triangle_bounding_boxes;
+	for (const collision_mesh::mesh& mesh : collision_mesh.meshes)
+	{
+		const XMMATRIX concatenated_matrix{
+			XMLoadFloat4x4(&mesh.geometric_transform) *
+			XMLoadFloat4x4(&mesh.default_global_transform) *
+			XMLoadFloat4x4(&world_transform) };
+		const XMMATRIX normal_matrix{ XMMatrixTranspose(XMMatrixInverse(nullptr, concatenated_matrix)) };
+
+		for (size_t index = 0; index + 2 < mesh.indices.size(); index += 3)
+		{
+			// intersect_ray_triangles(RHS)Ɠ
+			const XMVECTOR A{ XMLoadFloat3(&mesh.vertex_positions.at(mesh.indices.at(index + 0))) };
+			const XMVECTOR B{ XMLoadFloat3(&mesh.vertex_positions.at(mesh.indices.at(index + 1))) };
+			const XMVECTOR C{ XMLoadFloat3(&mesh.vertex_positions.at(mesh.indices.at(index + 2))) };
+			XMFLOAT3 vertices[3];
+			XMStoreFloat3(&vertices[0], XMVector3TransformCoord(A, concatenated_matrix));
+			XMStoreFloat3(&vertices[1], XMVector3TransformCoord(B, concatenated_matrix));
+			XMStoreFloat3(&vertices[2], XMVector3TransformCoord(C, concatenated_matrix));
+
+			XMFLOAT3 triangle_bounding_box[2]{ vertices[0], vertices[0] };
+			for (const XMFLOAT3& vertex : vertices)
+			{
+				triangle_bounding_box[0] = { std::min<float>(triangle_bounding_box[0].x, vertex.x), std::min<float>(triangle_bounding_box[0].y, vertex.y), std::min<float>(triangle_bounding_box[0].z, vertex.z) };
+				triangle_bounding_box[1] = { std::max<float>(triangle_bounding_box[1].x, vertex.x), std::max<float>(triangle_bounding_box[1].y, vertex.y), std::max<float>(triangle_bounding_box[1].z, vertex.z) };
+			}
+			bounding_box[0] = { std::min<float>(bounding_box[0].x, triangle_bounding_box[0].x), std::min<float>(bounding_box[0].y, triangle_bounding_box[0].y), std::min<float>(bounding_box[0].z, triangle_bounding_box[0].z) };
+			bounding_box[1] = { std::max<float>(bounding_box[1].x, triangle_bounding_box[1].x), std::max<float>(bounding_box[1].y, triangle_bounding_box[1].y), std::max<float>(bounding_box[1].z, triangle_bounding_box[1].z) };
+
+			// ォ瓖肤}Ζ(R)͍sAɂȂ̂ŁAĂZ𖢉ɂB
+			// ̖(V̗)͐^ւ̌ɓȂ̂ŖĂ悢B
+			const XMVECTOR N{ XMVector3Normalize(XMVector3TransformNormal(XMVector3Cross(XMVectorSubtract(B, A), XMVectorSubtract(C, A)), normal_matrix)) };
+			const float normal_y{ XMVectorGetY(N) };
+			const float steep_slope_threshold{ 0.5f }; // 60x}Ȗ
+			if (normal_y >= 0.0f && normal_y < steep_slope_threshold)
+			{
+				steep_triangle_bounding_boxes.emplace_back(triangle_bounding_box[0]);
+				steep_triangle_bounding_boxes.emplace_back(triangle_bounding_box[1]);
+			}
+		}
+	}
+
+	heights.clear();
+	cells.clear();
+	column_count = row_count = 0;
+	if (bounding_box[0].x > bounding_box[1].x)
+	{
+		return;
+	}
+
+	// iqɕ񂾒_(Ίp܂)̐^ɕW{dȂȂ悤A_x, zňقȂ锼[ȗʂ炷
+	// (ӂ̐^ʂ́A̎Op`̔蔲邱Ƃ)
+	origin = { bounding_box[0].x - cell_size * 0.37f, bounding_box[0].z - cell_size * 0.61f };
+	column_count = std::max<uint32_t>(1, static_cast<uint32_t>(std::ceil((bounding_box[1].x - origin.x) / cell_size)));
+	row_count = std::max<uint32_t>(1, static_cast<uint32_t>(std::ceil((bounding_box[1].z - origin.y) / cell_size)));
+
+	// Z̔̊Ԋuōŏʂ𒲂ׂBԖڂ̕W{iq_ɂȂAc͕Ԍ덷̌؂ɎgB
+	const uint32_t sample_column_count{ column_count * 2 + 1 };
+	const uint32_t sample_row_count{ row_count * 2 + 1 };
+	const float ray_height{ bounding_box[1].y + 1.0f };
+	collision_mesh::ray_batch rays;
+	rays.resize(static_cast<size_t>(sample_column_count) * sample_row_count);
+	for (uint32_t row = 0; row < sample_row_count; ++row)
+	{
+		for (uint32_t column = 0; column < sample_column_count; ++column)
+		{
+			rays.set(static_cast<size_t>(row) * sample_column_count + column,
+				{ origin.x + column * cell_size * 0.5f, ray_height, origin.y + row * cell_size * 0.5f, 1.0f }, { 0.0f, -1.0f, 0.0f, 0.0f });
+		}
+	}
+	std::vector<collision_mesh::raycast_hit> hits;
+	collision_mesh.raycast(rays, world_transform, hits, false/*ŏʂ𓾂邽*/, jobs);
+
+	auto sample = [&](uint32_t column, uint32_t row) -> const collision_mesh::raycast_hit& {
+		return hits.at(static_cast<size_t>(row) * sample_column_count + column);
+	};
+
+	heights.resize(static_cast<size_t>(column_count + 1) * (row_count + 1));
+	for (uint32_t row = 0; row <= row_count; ++row)
+	{
+		for (uint32_t column = 0; column <= column_count; ++column)
+		{
+			const collision_mesh::raycast_hit& hit{ sample(column * 2, row * 2) };
+			heights.at(static_cast<size_t>(row) * (column_count + 1) + column) = hit.mesh_index < 0 ? NAN : hit.closest_point.y;
+		}
+	}
+
+	cells.resize(static_cast<size_t>(column_count) * row_count);
+	for (uint32_t row = 0; row < row_count; ++row)
+	{
+		for (uint32_t column = 0; column < column_count; ++column)
+		{
+			const collision_mesh::raycast_hit& center{ sample(column * 2 + 1, row * 2 + 1) };
+			if (center.mesh_index < 0)
+			{
+				continue;
+			}
+
+			const float h00{ heights.at(static_cast<size_t>(row) * (column_count + 1) + column) };
+			const float h10{ heights.at(static_cast<size_t>(row) * (column_count + 1) + column + 1) };
+			const float h01{ heights.at(static_cast<size_t>(row + 1) * (column_count + 1) + column) };
+			const float h11{ heights.at(static_cast<size_t>(row + 1) * (column_count + 1) + column + 1) };
+
+			// 9̕W{ׂēbVE}eA̖ʂɂAԂe덷Ɏ܂ꍇ̂݉ł
+			bool resolvable{ true };
+			for (uint32_t v = 0; v <= 2 && resolvable; ++v)
+			{
+				for (uint32_t u = 0; u <= 2 && resolvable; ++u)
+				{
+					const collision_mesh::raycast_hit& hit{ sample(column * 2 + u, row * 2 + v) };
+					if (hit.mesh_index != center.mesh_index || hit.material_id != center.material_id)
+					{
+						resolvable = false;
+						break;
+					}
+					const float s{ u * 0.5f };
+					const float t{ v * 0.5f };
+					const float interpolated_height{ (h00 * (1 - s) + h10 * s) * (1 - t) + (h01 * (1 - s) + h11 * s) * t };
+					if (fabsf(interpolated_height - hit.closest_point.y) > tolerance)
+					{
+						resolvable = false;
+					}
+				}
+			}
+			if (resolvable)
+			{
+				cells.at(static_cast<size_t>(row) * column_count + column) = { center.mesh_index, center.triangle_index };
+			}
+		}
+	}
+
+	for (size_t index = 0; index < steep_triangle_bounding_boxes.size(); index += 2)
+	{
+		const XMFLOAT3& min{ steep_triangle_bounding_boxes.at(index) };
+		const XMFLOAT3& max{ steep_triangle_bounding_boxes.at(index + 1) };
+		const uint32_t first_column{ std::min<uint32_t>(column_count - 1, static_cast<uint32_t>(std::max<float>(0.0f, (min.x - origin.x) / cell_size))) };
+		const uint32_t last_column{ std::min<uint32_t>(column_count - 1, static_cast<uint32_t>(std::max<float>(0.0f, (max.x - origin.x) / cell_size))) };
+		const uint32_t first_row{ std::min<uint32_t>(row_count - 1, static_cast<uint32_t>(std::max<float>(0.0f, (min.z - origin.y) / cell_size))) };
+		const uint32_t last_row{ std::min<uint32_t>(row_count - 1, static_cast<uint32_t>(std::max<float>(0.0f, (max.z - origin.y) / cell_size))) };
+		for (uint32_t row = first_row; row <= last_row; ++row)
+		{
+			for (uint32_t column = first_column; column <= last_column; ++column)
+			{
+				cells.at(static_cast<size_t>(row) * column_count + column) = {};
+			}
+		}
+	}
+}
+
+heightfield::answer heightfield::raycast_down(const XMFLOAT4& position, _Out_ XMFLOAT4& closest_point, _Out_ int& mesh_index, _Out_ int& triangle_index) const
+{
+	if (cells.empty())
+	{
+		return answer::unresolved;
+	}
+
+	const float x{ (position.x - origin.x) / cell_size };
+	const float z{ (position.z - origin.y) / cell_size };
+	if (!(x >= 0.0f && x <= column_count && z >= 0.0f && z <= row_count))
+	{
+		// Obhׂ͂Ă̎Op`𕢂Ă̂ŁAOł͉ɂȂ
+		return answer::miss;
+	}
+	const uint32_t column{ std::min<uint32_t>(column_count - 1, static_cast<uint32_t>(x)) };
+	const uint32_t row{ std::min<uint32_t>(row_count - 1, static_cast<uint32_t>(z)) };
+	const cell& cell{ cells[static_cast<size_t>(row) * column_count + column] };
+	if (cell.mesh_index < 0)
+	{
+		return answer::unresolved;
+	}
+
+	const float s{ x - column };
+	const float t{ z - row };
+	const float* h0{ &heights[static_cast<size_t>(row) * (column_count + 1) + column] };
+	const float* h1{ h0 + column_count + 1 };
+	const float height{ (h0[0] * (1 - s) + h0[1] * s) * (1 - t) + (h1[0] * (1 - s) + h1[1] * s) * t };
+
+	// ̎n_ŏʂ艺ɂ(A̒Ȃ)ꍇ́Aɂʂ̖ʂɓ\
+	if (position.y <= height + tolerance)
+	{
+		return answer::unresolved;
+	}
+
+	closest_point = { position.x, height, position.z, 1.0f };
+	mesh_index = cell.mesh_index;
+	triangle_index = cell.triangle_index;
+	return answer::hit;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// UNIT.99
+#include <directxmath.h>
+#include <vector>
+#include <cstdint>
+
+class collision_mesh;
+class job_system;
+
+// ^(0, -1, 0)̌ɓ邽߂2Obh̍}bv
+// iq_Ƃɍŏʂ̍AZƂɑ\̎Op`(bVƃ}eA̓p)B
+// RǁAA̓V䉺ȂǁAo`ԂŐȂӏ́uvƂĈAĂяoŎOp`̔ɔCB
+class heightfield
+{
+public:
+	struct cell
+	{
+		int32_t mesh_index{ -1 }; // -1̏ꍇ͖̃Z
+		int32_t triangle_index{ -1 };
+
+		template<class T>
+		void serialize(T& archive)
+		{
+			archive(mesh_index, triangle_index);
+		}
+	};
+
+	DirectX::XMFLOAT4X4 world_transform{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 }; // \zɎg[hϊ
+	DirectX::XMFLOAT2 origin{}; // Obȟ_(x, z)
+	float cell_size{ 1.0f };
+	float tolerance{ 0.01f }; // ԂƎۂ̖ʂƂ̋e덷
+	uint32_t column_count{ 0 };
+	uint32_t row_count{ 0 };
+	std::vector<float> heights; // (column_count + 1) * (row_count + 1)̊iq_̍
+	std::vector<cell> cells; // column_count * row_count
+
+	// ׂĂ̊֐̈̍Wn̓[h.
+	// jobsnƕW{̌job_systemŕɔ肷
+	void build(const collision_mesh& collision_mesh, const DirectX::XMFLOAT4X4& world_transform, float cell_size, float tolerance, job_system* jobs = nullptr);
+
+	template<class T>
+	void serialize(T& archive)
+	{
+		archive(world_transform, origin, cell_size, tolerance, column_count, row_count, heights, cells);
+	}
+
+	enum class answer { hit, miss, unresolved };
+	answer raycast_down(const DirectX::XMFLOAT4& position, _Out_ DirectX::XMFLOAT4& closest_point, _Out_ int& mesh_index, _Out_ int& triangle_index) const;
+
+	bool built_with(const DirectX::XMFLOAT4X4& transform) const
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				if (world_transform.m[row][column] != transform.m[row][column])
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+};
@@ -0,0 +1,117 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+// WuĂXbhł͗Ă
+static thread_local bool inside_job{ false };
+
+size_t job_system::default_worker_count()
+{
+	return std::max<size_t>(1, std::thread::hardware_concurrency()) - 1;
+}
+
+job_system::job_system(size_t worker_count)
+{
+	for (size_t worker_index = 0; worker_index < worker_count; ++worker_index)
+	{
+		_workers.emplace_back(&job_system::worker_main, this);
+	}
+}
+
+job_system::~job_system()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_exiting = true;
+	}
+	_wake_condition.notify_all();
+	for (std::thread& worker : _workers)
+	{
+		worker.join();
+	}
+}
+
+void job_system::parallel_for(size_t count, size_t grain, const std::function<void(size_t first, size_t last)>& function)
+{
+	grain = std::max<size_t>(1, grain);
+	if (count == 0)
+	{
+		return;
+	}
+	if (_workers.empty() || count <= grain || inside_job)
+	{
+		function(0, count);
+		return;
+	}
+
+	// _batch1Ȃ̂ŁAʂ̃Xbhparallel_forob`ւȂ悤ɁAI܂Ŏ̌Ăяo҂
+	std::lock_guard<std::mutex> submit_lock(_submit_mutex);
+	batch current;
+	current.function = &function;
+	current.count = count;
+	current.grain = grain;
+	current.job_count = (count + grain - 1) / grain;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_batch = &current;
+		++_generation;
+	}
+	_wake_condition.notify_all();
+
+	work(current);
+
+	// xċN[J[̃ob`̃WuȂ悤ɁAob`OĂ߂
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done_condition.wait(lock, [&]() { return current.completed_job_count == current.job_count && _busy_worker_count == 0; });
+	_batch = nullptr;
+}
+
+void job_system::work(batch& current)
+{
+	inside_job = true;
+	for (size_t job_index = current.next_job++; job_index < current.job_count; job_index = current.next_job++)
+	{
+		const size_t first{ job_index * current.grain };
+		(*current.function)(first, std::min(first + current.grain, current.count));
+		if (++current.completed_job_count == current.job_count)
+		{
+			// ҂Ăparallel_for𒲂ׂĂ疰܂ł̊ԂɒʒmȂ悤ɁAbNʂĂN
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+			}
+			_done_condition.notify_all();
+		}
+	}
+	inside_job = false;
+}
+
+void job_system::worker_main()
+{
+	uint64_t generation{ 0 };
+	for (;;)
+	{
+		batch* current{ nullptr };
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake_condition.wait(lock, [&]() { return _exiting || _generation != generation; });
+			if (_exiting)
+			{
+				return;
+			}
+			generation = _generation;
+			current = _batch;
+			if (current == nullptr)
+			{
+				// NOɃob`IĂ
+				continue;
+			}
+			++_busy_worker_count;
+		}
+		work(*current);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			--_busy_worker_count;
+		}
+		_done_condition.notify_all();
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// UNIT.99
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 풓郏[J[XbhɃt[Ƃ̕񏈗zB
+// Xbh̐̓RXgN^1񂾂ŝŁAt[Ăłstd::asynĉ悤ɃXbh蒼ȂB
+class job_system
+{
+public:
+	// ł͌ĂяõXbh̕_RA[J[
+	job_system(size_t worker_count = default_worker_count());
+	virtual ~job_system();
+	job_system(const job_system&) = delete;
+	job_system& operator =(const job_system&) = delete;
+	job_system(job_system&&) noexcept = delete;
+	job_system& operator =(job_system&&) noexcept = delete;
+
+	// [0, count)grain̃WuɕA[J[ƌĂяõXbhŎ荇ďBׂẴWuI܂Ŗ߂ȂB
+	// functionɂ[first, last)͈̔͂nBWu̒Ă񂾏ꍇ́A҂킹ŋl܂Ȃ悤ɂ̏ŒɏB
+	// [J[ob`͈x1Ȃ̂ŁA[J[ȊÕ̕Xbh瓯ɌĂ񂾏ꍇ́ǍĂяoI܂ő҂
+	void parallel_for(size_t count, size_t grain, const std::function<void(size_t first, size_t last)>& function);
+
+	size_t worker_count() const { return _workers.size(); }
+	static size_t default_worker_count();
+
+private:
+	// 1parallel_for̕BĂяõX^bNɒuÃ[J[ȂȂ܂parallel_for߂Ȃ
+	struct batch
+	{
+		const std::function<void(size_t, size_t)>* function{ nullptr };
+		size_t count{ 0 };
+		size_t grain{ 1 };
+		size_t job_count{ 0 };
+		std::atomic<size_t> next_job{ 0 };
+		std::atomic<size_t> completed_job_count{ 0 };
+	};
+	void work(batch& current);
+	void worker_main();
+
+	std::vector<std::thread> _workers;
+	std::mutex _submit_mutex; // _batchgparallel_for1ɍi
+	std::mutex _mutex;
+	std::condition_variable _wake_condition;
+	std::condition_variable _done_condition;
+	batch* _batch{ nullptr };
+	uint64_t _generation{ 0 }; // parallel_for̂тɐi߁AĂ郏[J[ɐVob`m点
+	size_t _busy_worker_count{ 0 };
+	bool _exiting{ false };
+};
@@ -14,6 +14,7 @@
 
 #include "event.h"
 
+#include <random>
 
 using namespace DirectX;
 
@@ -56,16 +57,34 @@ bool main_scene::initialize(ID3D11Device* device, UINT64 width, UINT height, con
 	shader_resource_views[static_cast<size_t>(t_slot::ramp)] = texture::_emplace(device, L".\\resources\\ramp.png");
 	shader_resource_views[static_cast<size_t>(t_slot::noise)] = texture::_emplace(device, L".\\resources\\tv noise.png");
 
-	geometric_substances[static_cast<size_t>(model::terrain)] = std::make_unique<geometric_substance>(device, ".\\resources\\Tr\\ST.fbx");
+	// n`͒_̂ŁA_l߂`ŏĂ
+	geometric_substances[static_cast<size_t>(model::terrain)] = std::make_unique<geometric_substance>(device, ".\\resources\\Tr\\ST.fbx", std::vector<std::string>{}, false, 0.0f, false, geometric_substance::vertex_format::compact);
 
 	//gȂ
 	geometric_substances[static_cast<size_t>(model::sky_cube)] = std::make_unique<geometric_substance>(device, ".\\resources\\cube.000.fbx");
 
+	// }bvĂƂ̌̔ɂ[J[XbhĝŁAɍĂ
+	jobs = std::make_unique<job_system>(); // UNIT.99
+
 	terrain_collision = std::make_unique<collision_mesh>(device, ".\\resources\\Tr\\ST.fbx");
+	terrain_collision->bake_heightfield(terrain_world_transform, 1.0f, 0.01f, jobs.get());
+
+	// n`͓Ȃ̂Ń[hԂAABB͈x߂Ă
+	{
+		const std::vector<geometric_substance::mesh>& terrain_meshes{ geometric_substances[static_cast<size_t>(model::terrain)]->meshes };
+		terrain_bounding_boxes.resize(terrain_meshes.size());
+		for (size_t mesh_index = 0; mesh_index < terrain_meshes.size(); ++mesh_index)
+		{
+			XMFLOAT3 bounding_box[2];
+			terrain_meshes.at(mesh_index).transform_bounding_box(terrain_world_transform, bounding_box);
+			terrain_bounding_boxes.set(mesh_index, bounding_box);
+		}
+	}
 
 
 	nico = actor::_emplace<avatar>("nico", device, XMFLOAT4{ -15.0f, 0.88f + 0.5f, 50.0f, 1.0f });
 	plantune = actor::_emplace<boss>("plantune", device);
+	animated_actors = { nico, plantune }; // UNIT.99
 
 
 	eye_view_camera = actor::_emplace<camera>("eye_view_camera", nico->name.c_str(), nico->position(), nico->forward(), 5.0f/*focal_length*/, 1.0f/*height_above_ground*/);
@@ -228,14 +247,27 @@ void main_scene::update(ID3D11DeviceContext* immediate_context, float delta_time
 
 	nico->collide_with(terrain_collision.get(), terrain_world_transform);
 	nico->update(delta_time);
-	nico->animation_transition(delta_time);
-	nico->audio_transition(delta_time);
 
 #if 0
 	plantune->collide_with(terrain_collision.get(), terrain_world_transform);
 #endif
 	plantune->update(delta_time);
-	plantune->animation_transition(delta_time);
+
+	// UNIT.99 Aj[V(V[PT[ApA{[s)̓AN^[ƂɓƗĂ̂ŁA
+	// [J[XbhŕɍXVAׂďIĂ`ɐiށB̓Aj[VŌ܂Ԃ̂ŌŖ炷
+	// Aj[VLOD͍XVÕJ(Õt[ŕ`_)I
+	XMFLOAT4X4 eye_view_projection;
+	XMStoreFloat4x4(&eye_view_projection, XMLoadFloat4x4(&eye_view_camera->view_matrix()) * XMLoadFloat4x4(&eye_view_camera->perspective_projection_matrix(eye_view_aspect_ratio)));
+	const view_frustum eye_view_frustum(eye_view_projection);
+	const XMFLOAT4 eye_position{ eye_view_camera->position() };
+	jobs->parallel_for(animated_actors.size(), ANIMATION_JOB_GRAIN, [&](size_t first, size_t last) {
+		for (size_t actor_index = first; actor_index < last; ++actor_index)
+		{
+			animated_actors.at(actor_index)->select_animation_lod(eye_position, eye_view_frustum);
+			animated_actors.at(actor_index)->animate(delta_time);
+		}
+		});
+	nico->audio_transition(delta_time);
 	plantune->audio_transition(delta_time);
 
 	
@@ -262,7 +294,7 @@ void main_scene::update(ID3D11DeviceContext* immediate_context, float delta_time
 	}
 
 
-	if (nico->current_location() == "collision_boss_area_mtl")
+	if (nico->current_location() == collision_boss_area_mtl)
 	{
 		_audios[0]->play();
 		_audios[0]->volume(0.5f);
@@ -319,18 +351,50 @@ void main_scene::update(ID3D11DeviceContext* immediate_context, float delta_time
 			ImGui::Text("avatar's scale %.2f, %.2f, %.2f, %.2f", nico->scale().x, nico->scale().y, nico->scale().z, nico->scale().w);
 			ImGui::Text("state : %d", nico->tell_state());
 			ImGui::Text("heart_point : %d", nico->heart_point());
-			ImGui::Text("current_location : %s", nico->current_location().c_str());
+			ImGui::Text("current_location : %s", nico->current_location() == string_table::INVALID_ID ? "" : string_table::name(nico->current_location()).c_str());
 
 			ImGui::Text("boss_heart_point : %d", plantune->health_point());
 		}
 		if (ImGui::CollapsingHeader("collision configuration"))
 		{
 			ImGui::Checkbox("visible_collision_shapes", &visible_collision_shapes);
+			ImGui::Checkbox("enable_bounding_volume_hierarchy", &terrain_collision->enable_bounding_volume_hierarchy);
+			ImGui::Checkbox("enable_simd", &terrain_collision->enable_simd);
+			ImGui::Checkbox("enable_heightfield", &terrain_collision->enable_heightfield);
+			ImGui::Text("ray-triangle kernel : %s", terrain_collision->enable_simd ? ray_triangles_kernel_isa() : "scalar");
+			if (ImGui::Button("raycast benchmark"))
+			{
+				benchmark_raycast();
+			}
+			ImGui::Text("raycast : %.0f rays/sec (bvh), %.0f rays/sec (brute force)", raycast_rays_per_second[0], raycast_rays_per_second[1]);
+			ImGui::Text("raycast : %.0f rays/sec (batch)", raycast_rays_per_second[2]);
+			ImGui::Text("(heightfield off, %s kernel)", ray_triangles_kernel_isa());
 			
 			ImGui::SliderFloat("nico_root_sphere_radius", &nico_root_sphere_radius, 0.0f, 24.0f);
 			ImGui::SliderFloat("plantune_right_paw_sphere_radius", &plantune_right_paw_sphere_radius, 0.0f, 24.0f);
 			ImGui::SliderFloat("plantune_core_sphere_radiuse", &plantune_core_sphere_radiuse, 0.0f, 24.0f);
 		}
+		if (ImGui::CollapsingHeader("asset configuration"))
+		{
+			if (ImGui::Button("asset loading benchmark"))
+			{
+				benchmark_asset_loading(immediate_context);
+			}
+			ImGui::Text("nico.fbx : %.2f ms (cereal), %.2f ms (substance)", asset_loading_seconds[0][0] * 1000.0f, asset_loading_seconds[0][1] * 1000.0f);
+			ImGui::Text("ST.fbx : %.2f ms (cereal), %.2f ms (substance)", asset_loading_seconds[1][0] * 1000.0f, asset_loading_seconds[1][1] * 1000.0f);
+
+			// Ăݎ̒_LbV̌(œKO -> œK)
+			ImGui::Separator();
+			auto vertex_cache_text{ [](const char* name, const geometric_substance& substance) {
+				const vertex_cache_statistics* statistics{ substance.baked_vertex_cache_statistics };
+				ImGui::Text("%s : ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", name, statistics[0].acmr(), statistics[1].acmr(), statistics[0].atvr(), statistics[1].atvr());
+			} };
+			vertex_cache_text("ST.fbx", *geometric_substances[static_cast<size_t>(model::terrain)]);
+			vertex_cache_text("cube.000.fbx", *geometric_substances[static_cast<size_t>(model::sky_cube)]);
+			geometric_substance::_enumerate([&](const std::string& name, const geometric_substance& substance) {
+				vertex_cache_text(name.c_str(), substance);
+			});
+		}
 		if (ImGui::CollapsingHeader("camera configuration"))
 		{
 			ImGui::Text("eye_view_camera's location %.2f, %.2f, %.2f, %.2f", eye_view_camera->position().x, eye_view_camera->position().y, eye_view_camera->position().z, eye_view_camera->position().w);
@@ -387,6 +451,11 @@ void main_scene::update(ID3D11DeviceContext* immediate_context, float delta_time
 			ImGui::SliderFloat("shadow_depth_bias", &cb_shadow_map->data.shadow_depth_bias, 0.0f, 0.005f, "%.8f");
 			ImGui::SliderFloat("shadow_filter_radius", &cb_shadow_map->data.shadow_filter_radius, 0.0f, 64.0f);
 			ImGui::SliderInt("shadow_sample_count", reinterpret_cast<int*>(&cb_shadow_map->data.shadow_sample_count), 0, 64);
+			ImGui::Text("shadow casters per cascade : %zu, %zu, %zu, %zu", shadow_caster_counts[0], shadow_caster_counts[1], shadow_caster_counts[2], shadow_caster_counts[3]);
+			ImGui::Checkbox("enable_static_shadow_cache", &enable_static_shadow_cache);
+			ImGui::DragFloat("static_cache_margin", &_cascaded_shadow_map->_static_cache_margin, 0.01f, 0.0f, 1.0f);
+			ImGui::DragFloat("static_cache_light_angle_threshold", &_cascaded_shadow_map->_static_cache_light_angle_threshold, 0.01f, 0.0f, 10.0f);
+			ImGui::Text("static cache refreshes : %zu", _cascaded_shadow_map->_static_cache_refresh_count);
 			ImGui::Image(_cascaded_shadow_map->_shader_resource_view.Get(), { 256, 256 });
 		}
 		
@@ -444,6 +513,7 @@ void main_scene::render(ID3D11DeviceContext* immediate_context, float delta_time
 	UINT num_viewports = 1;
 	immediate_context->RSGetViewports(&num_viewports, &viewport);
 	const float aspect_ratio{ viewport.Width / viewport.Height };
+	eye_view_aspect_ratio = aspect_ratio; // UNIT.99
 
 	XMMATRIX P = XMLoadFloat4x4(&eye_view_camera->perspective_projection_matrix(aspect_ratio));
 	XMMATRIX V = XMLoadFloat4x4(&eye_view_camera->view_matrix());
@@ -452,6 +522,9 @@ void main_scene::render(ID3D11DeviceContext* immediate_context, float delta_time
 	XMStoreFloat4x4(&cb_scene->data.view_projection, V * P);
 	XMStoreFloat4x4(&cb_scene->data.inverse_projection, XMMatrixInverse(NULL, P));
 	XMStoreFloat4x4(&cb_scene->data.inverse_view_projection, XMMatrixInverse(NULL, V * P));
+
+	// `̑Oɒn`bV̉܂Ƃ߂ċ߂
+	cull_frustum_aabbs(view_frustum(cb_scene->data.view_projection), terrain_bounding_boxes, terrain_visibility);
 	cb_scene->data.camera_position = eye_view_camera->position();
 	cb_scene->data.camera_focus = eye_view_camera->focus();
 	cb_scene->data.avatar_position = nico->position();
@@ -471,7 +544,7 @@ void main_scene::render(ID3D11DeviceContext* immediate_context, float delta_time
 	
 		cb_scene->data.omni_light_color[0].w = omni_light_intensity * (white_point - cb_scene->data.directional_light_color[0].w) * (cb_scene->data.snow_factor > 0.0f ? 0.5f : 1.0f);
 	}
-	if (nico->current_location() == "collision_cave_mtl")
+	if (nico->current_location() == collision_cave_mtl)
 	{
 		cb_scene->data.snow_factor = 0.0f;
 		cb_shadow_map->data.shadow_color = 1.0f;
@@ -491,15 +564,73 @@ void main_scene::render(ID3D11DeviceContext* immediate_context, float delta_time
 	rendering_state->bind_blend_state(immediate_context, blend_state::none);
 	rendering_state->bind_depth_stencil_state(immediate_context, depth_stencil_state::zt_on_zw_on);
 	rendering_state->bind_rasterizer_state(immediate_context, rasterizer_state::cull_front);
-	_cascaded_shadow_map->make(immediate_context, cb_scene->data.view, cb_scene->data.projection, cb_scene->data.directional_light_direction[0], _critical_depth_value, [&]() {
-		if (!has_amassed_husk_particles)
+	// JXP[h̃CgԂ̎ƏdȂVhELX^[`悵A`悵Ԃ
+	auto cast_character_shadows = [&](size_t cascade_index) {
+		const view_frustum& cascade_frustum{ _cascaded_shadow_map->_frustums.at(cascade_index) };
+		// LN^[͑_Ƃ~ŋߎB葫̐UlĐ͒a̕L
+		auto overlaps = [&](const XMFLOAT4& position, float breadth, float stature) {
+			const XMFLOAT3 bounding_box[2]{ { position.x - breadth, position.y, position.z - breadth }, { position.x + breadth, position.y + stature, position.z + breadth } };
+			return !intersect_frustum_aabb(cascade_frustum, bounding_box);
+		};
+		size_t caster_count{ 0 };
+		if (!has_amassed_husk_particles && overlaps(nico->position(), nico_breadth, nico_stature))
+		{
+			nico->cast_shadow(immediate_context, 1);
+			++caster_count;
+		}
+		if (overlaps(plantune->position(), plantune_breadth, plantune_stature))
 		{
-			nico->cast_shadow(immediate_context);
+			plantune->cast_shadow(immediate_context, 1);
+			++caster_count;
 		}
+		return caster_count;
+	};
+	auto cast_terrain_shadow = [&](size_t cascade_index) {
+		cull_frustum_aabbs(_cascaded_shadow_map->_frustums.at(cascade_index), terrain_bounding_boxes, terrain_shadow_visibility);
+		size_t caster_count{ 0 };
+		for (size_t mesh_index = 0; mesh_index < terrain_bounding_boxes.count; ++mesh_index)
+		{
+			caster_count += is_visible(terrain_shadow_visibility, mesh_index) ? 1 : 0;
+		}
+		geometric_substances[static_cast<size_t>(model::terrain)]->cast_shadow(immediate_context, terrain_world_transform, nullptr, &terrain_shadow_visibility, 1);
+		return caster_count;
+	};
+	if (enable_static_shadow_cache)
+	{
+		// n`̓LbVɂȂJXP[h`ALN^[͖t[̏ɏd˂
+		for (size_t& count : shadow_caster_counts)
+		{
+			count = 0;
+		}
+		_cascaded_shadow_map->make_cached(immediate_context, cb_scene->data.view, cb_scene->data.projection, cb_scene->data.directional_light_direction[0], _critical_depth_value, [&](size_t cascade_index) {
+			shadow_caster_counts[cascade_index] += cast_terrain_shadow(cascade_index);
+			}, [&](size_t cascade_index) {
+			shadow_caster_counts[cascade_index] += cast_character_shadows(cascade_index);
+			});
+	}
+	else if (enable_frustum_culling)
+	{
+		_cascaded_shadow_map->make_per_cascade(immediate_context, cb_scene->data.view, cb_scene->data.projection, cb_scene->data.directional_light_direction[0], _critical_depth_value, [&](size_t cascade_index) {
+			shadow_caster_counts[cascade_index] = cast_character_shadows(cascade_index) + cast_terrain_shadow(cascade_index);
+			});
+	}
+	else
+	{
+		_cascaded_shadow_map->make(immediate_context, cb_scene->data.view, cb_scene->data.projection, cb_scene->data.directional_light_direction[0], _critical_depth_value, [&]() {
+			if (!has_amassed_husk_particles)
+			{
+				nico->cast_shadow(immediate_context);
+			}
 
-		plantune->cast_shadow(immediate_context);
-		geometric_substances[static_cast<size_t>(model::terrain)]->cast_shadow(immediate_context, terrain_world_transform, nullptr);
-		});
+			plantune->cast_shadow(immediate_context);
+			geometric_substances[static_cast<size_t>(model::terrain)]->cast_shadow(immediate_context, terrain_world_transform, nullptr);
+			});
+		const size_t caster_count{ terrain_bounding_boxes.count + (has_amassed_husk_particles ? 1 : 2) };
+		for (size_t& count : shadow_caster_counts)
+		{
+			count = caster_count;
+		}
+	}
 
 #ifdef ENABLE_MSAA
 	framebuffers[static_cast<size_t>(offscreen::scene_msaa)]->clear(immediate_context);
@@ -721,7 +852,7 @@ bool main_scene::on_size_changed(ID3D11Device* device, UINT64 width, UINT height
 
 void main_scene::draw_terrain(ID3D11DeviceContext* immediate_context, float delta_time)
 {
-	view_frustum view_frustum(cb_scene->data.view_projection);
+	const geometric_substance::mesh* terrain_meshes{ geometric_substances[static_cast<size_t>(model::terrain)]->meshes.data() };
 
 	rendering_state->bind_blend_state(immediate_context, blend_state::alpha);
 	rendering_state->bind_depth_stencil_state(immediate_context, depth_stencil_state::zt_on_zw_on);
@@ -730,9 +861,7 @@ void main_scene::draw_terrain(ID3D11DeviceContext* immediate_context, float delt
 		[&](const geometric_substance::mesh& mesh, const geometric_substance::material& material, geometric_substance::shader_resources& shader_resources, geometric_substance::pipeline_state& pipeline_state) {
 
 #if 1
-			XMFLOAT3 bounding_box[2];
-			mesh.transform_bounding_box(terrain_world_transform, bounding_box);
-			if (enable_frustum_culling && intersect_frustum_aabb(view_frustum, bounding_box))
+			if (enable_frustum_culling && !is_visible(terrain_visibility, static_cast<size_t>(&mesh - terrain_meshes)))
 			{
 				return -1;
 			}
@@ -850,7 +979,7 @@ void main_scene::draw_ui(ID3D11DeviceContext* immediate_context, float delta_tim
 		}
 	}
 
-	if (nico->current_location() == "collision_boss_area_mtl")
+	if (nico->current_location() == collision_boss_area_mtl)
 	{
 		{
 			float w = 256;
@@ -892,4 +1021,75 @@ void main_scene::draw_collision_shape(ID3D11DeviceContext* immediate_context, fl
 	cylinder->draw(immediate_context, nico->position(), { nico_breadth * 0.5f, nico_stature, nico_breadth * 0.5f, 1.0f }, { 0, 0, 0, 0 }, { 1, 1, 1, 0.2f });
 	cylinder->draw(immediate_context, plantune->position(), { plantune_breadth * 0.5f, plantune_stature, plantune_breadth * 0.5f, 1.0f }, { 0, 0, 0, 0 }, { 1, 1, 1, 0.2f });
 #endif
-}
\ No newline at end of file
+}
+
+// n`RWɑ΂郌CLXg̐\BVH̗LŔr
+void main_scene::benchmark_raycast()
+{
+	const size_t ray_count{ 1000 };
+	std::vector<XMFLOAT4> ray_positions(ray_count);
+	std::vector<XMFLOAT4> ray_directions(ray_count);
+
+	std::mt19937 random_engine(0);
+	std::uniform_real_distribution<float> spread(-30.0f, +30.0f);
+	std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+	for (size_t ray_index = 0; ray_index < ray_count; ++ray_index)
+	{
+		// avatar::collide_withƓA͐^A͐ɔ΂
+		ray_positions.at(ray_index) = { nico->position().x + spread(random_engine), nico->position().y + 1.75f, nico->position().z + spread(random_engine), 1.0f };
+		const float theta{ angle(random_engine) };
+		ray_directions.at(ray_index) = ray_index % 2 == 0 ? XMFLOAT4{ 0.0f, -1.0f, 0.0f, 0.0f } : XMFLOAT4{ cosf(theta), 0.0f, sinf(theta), 0.0f };
+	}
+
+	// Op`Ƃ̌肾ׂ邽߁Aǂ̃pX}bv͎g킸AJ[lSIMDłɂ낦
+	const bool enable_bounding_volume_hierarchy{ terrain_collision->enable_bounding_volume_hierarchy };
+	const bool enable_simd{ terrain_collision->enable_simd };
+	const bool enable_heightfield{ terrain_collision->enable_heightfield };
+	terrain_collision->enable_simd = true;
+	terrain_collision->enable_heightfield = false;
+	for (size_t pass = 0; pass < 2; ++pass)
+	{
+		terrain_collision->enable_bounding_volume_hierarchy = pass == 0;
+
+		XMFLOAT4 intersection;
+		std::string mesh;
+		std::string material;
+		benchmark stopwatch;
+		stopwatch.begin();
+		for (size_t ray_index = 0; ray_index < ray_count; ++ray_index)
+		{
+			terrain_collision->raycast(ray_positions.at(ray_index), ray_directions.at(ray_index), terrain_world_transform, intersection, mesh, material, false);
+		}
+		raycast_rays_per_second[pass] = ray_count / std::max<float>(stopwatch.end(), FLT_EPSILON);
+	}
+	terrain_collision->enable_bounding_volume_hierarchy = true;
+
+	collision_mesh::ray_batch rays;
+	rays.resize(ray_count);
+	for (size_t ray_index = 0; ray_index < ray_count; ++ray_index)
+	{
+		rays.set(ray_index, ray_positions.at(ray_index), ray_directions.at(ray_index));
+	}
+	std::vector<collision_mesh::raycast_hit> hits;
+	benchmark stopwatch;
+	stopwatch.begin();
+	terrain_collision->raycast(rays, terrain_world_transform, hits, false, jobs.get());
+	raycast_rays_per_second[2] = ray_count / std::max<float>(stopwatch.end(), FLT_EPSILON);
+
+	terrain_collision->enable_bounding_volume_hierarchy = enable_bounding_volume_hierarchy;
+	terrain_collision->enable_simd = enable_simd;
+	terrain_collision->enable_heightfield = enable_heightfield;
+}
+
+void main_scene::benchmark_asset_loading(ID3D11DeviceContext* immediate_context)
+{
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	immediate_context->GetDevice(device.GetAddressOf());
+
+	const char* fbx_filenames[]{ ".\\resources\\nico.fbx", ".\\resources\\Tr\\ST.fbx" };
+	const geometric_substance::vertex_format vertex_formats[]{ geometric_substance::vertex_format::standard, geometric_substance::vertex_format::compact };
+	for (size_t asset_index = 0; asset_index < 2; ++asset_index)
+	{
+		geometric_substance::benchmark_loading(device.Get(), fbx_filenames[asset_index], asset_loading_seconds[asset_index], vertex_formats[asset_index]);
+	}
+}
@@ -31,6 +31,7 @@
 #include "camera.h"
 
 #include "geometric_primitive.h"
+#include "job_system.h"
 #include "gamepad.h"
 #include "rendering_state.h"
 
@@ -154,6 +155,7 @@ class main_scene : public scene
 
 	std::unique_ptr<cascaded_shadow_map> _cascaded_shadow_map;
 	float _critical_depth_value = 300;
+	bool enable_static_shadow_cache = true; // n`̉eLbVALN^[𖈃t[`悷
 
 	std::unique_ptr<bloom> bloom_effect;
 
@@ -162,6 +164,16 @@ class main_scene : public scene
 																			0.01f, 0.0f, 0.0f, 0.0f, 0.0f, 
 																			1.0f };
 	std::unique_ptr<collision_mesh> terrain_collision;
+	// n`̃}eAIDBavatar::current_locationƐŔׂ
+	const int32_t collision_boss_area_mtl{ string_table::intern("collision_boss_area_mtl") };
+	const int32_t collision_cave_mtl{ string_table::intern("collision_cave_mtl") };
+
+	bounding_box_soa terrain_bounding_boxes; // n`̊ebV(geometric_substance::meshes̏)̃[hAABB
+	std::vector<uint64_t> terrain_visibility; // t[Ƃɕ`O1񋁂߂rbg}XN
+	std::vector<uint64_t> terrain_shadow_visibility; // JXP[hƂɋߒVhELX^[̉rbg}XN
+	size_t shadow_caster_counts[4]{}; // JXP[hƂɕ`悵VhELX^[(bV)̐
+	float raycast_rays_per_second[3]{}; // 0:BVHA1:A2:ꊇ(BVH)Bǂ}bvȂASIMD̃J[l
+	float asset_loading_seconds[2][2]{}; // [nico.fbx, ST.fbx][cereal, substance]
 
 
 	bool enable_cast_shadow = true;
@@ -188,7 +200,13 @@ class main_scene : public scene
 
 	std::shared_ptr<avatar> nico;
 	std::shared_ptr<boss> plantune;
+	// UNIT.99 t[animateĂԃAN^[Bjob_systemANIMATION_JOB_GRAIN̂[J[XbhɔzB
+	// AN^[͐̂Ȃ1̂̎p̕]d̂ŁA1̂z
+	std::vector<std::shared_ptr<actor>> animated_actors;
+	static const size_t ANIMATION_JOB_GRAIN{ 1 };
+	std::unique_ptr<job_system> jobs;
 	std::shared_ptr<camera> eye_view_camera;
+	float eye_view_aspect_ratio{ 16.0f / 9.0f }; // UNIT.99 Õt[ŕ`r[|[g̏c(updateŃAj[VLODIԂ̂Ɏg)
 	int detected_latha_count = 0;
 
 	float nico_magic_wand_sphere_radius = 0.2f;
@@ -224,4 +242,6 @@ class main_scene : public scene
 	void draw_terrain(ID3D11DeviceContext* immediate_context, float delta_time);
 	void draw_ui(ID3D11DeviceContext* immediate_context, float delta_time);
 	void draw_collision_shape(ID3D11DeviceContext* immediate_context, float delta_time);
+	void benchmark_raycast();
+	void benchmark_asset_loading(ID3D11DeviceContext* immediate_context);
 };
@@ -0,0 +1,92 @@
+#include "mapped_file.h"
+
+#include <cstring>
+
+mapped_file::mapped_file(const std::filesystem::path& filename)
+{
+	_file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_file == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	LARGE_INTEGER file_size{};
+	if (!GetFileSizeEx(_file, &file_size) || file_size.QuadPart == 0)
+	{
+		// 傫0̃t@C̓}bvłȂ
+		return;
+	}
+	_mapping = CreateFileMappingW(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping == NULL)
+	{
+		return;
+	}
+	_data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	_size = _data ? static_cast<size_t>(file_size.QuadPart) : 0;
+}
+
+mapped_file::~mapped_file()
+{
+	if (_data)
+	{
+		UnmapViewOfFile(_data);
+	}
+	if (_mapping != NULL)
+	{
+		CloseHandle(_mapping);
+	}
+	if (_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_file);
+	}
+}
+
+// xxHash64Ɠ\4[̏ŁA132oCgǂ(t@CŜǂނ̂Ń̑шŗx̑v)
+inline uint64_t rotate_left(uint64_t value, int count)
+{
+	return (value << count) | (value >> (64 - count));
+}
+uint64_t content_hash(const uint8_t* data, size_t size)
+{
+	const uint64_t prime1{ 0x9E3779B185EBCA87ull };
+	const uint64_t prime2{ 0xC2B2AE3D27D4EB4Full };
+	const uint64_t prime3{ 0x165667B19E3779F9ull };
+	auto round = [&](uint64_t accumulator, uint64_t input) {
+		return rotate_left(accumulator + input * prime2, 31) * prime1;
+	};
+	auto read = [](const uint8_t* p) {
+		uint64_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	};
+
+	uint64_t lanes[4]{ prime1 + prime2, prime2, 0, 0 - prime1 };
+	const uint8_t* p{ data };
+	const uint8_t* const end{ data + size };
+	for (; end - p >= 32; p += 32)
+	{
+		lanes[0] = round(lanes[0], read(p));
+		lanes[1] = round(lanes[1], read(p + 8));
+		lanes[2] = round(lanes[2], read(p + 16));
+		lanes[3] = round(lanes[3], read(p + 24));
+	}
+	uint64_t hash{ rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) + rotate_left(lanes[3], 18) };
+	for (uint64_t lane : lanes)
+	{
+		hash = (hash ^ round(0, lane)) * prime1 + prime3;
+	}
+	hash += size;
+	for (; end - p >= 8; p += 8)
+	{
+		hash = rotate_left(hash ^ round(0, read(p)), 27) * prime1 + prime3;
+	}
+	for (; p < end; ++p)
+	{
+		hash = rotate_left(hash ^ (*p * prime3), 11) * prime1;
+	}
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// UNIT.99
+#include <windows.h>
+
+#include <cstdint>
+#include <filesystem>
+
+// ǂݎpŃ}bvt@CB
+// e̓y[WtH[gŕKvȕǂݍ܂̂ŁAJȂt@C̑傫Ɋ֌WȂB
+class mapped_file
+{
+public:
+	mapped_file(const std::filesystem::path& filename);
+	virtual ~mapped_file();
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator =(const mapped_file&) = delete;
+	mapped_file(mapped_file&&) noexcept = delete;
+	mapped_file& operator =(mapped_file&&) noexcept = delete;
+
+	// JȂꍇnullptr
+	const uint8_t* data() const { return _data; }
+	size_t size() const { return _size; }
+
+private:
+	HANDLE _file{ INVALID_HANDLE_VALUE };
+	HANDLE _mapping{ NULL };
+	const uint8_t* _data{ nullptr };
+	size_t _size{ 0 };
+};
+
+// oCg64rbgnbVBLbṼt@Cꂽ̂m߂邽߂̂̂ŁAÍwIȋx͂Ȃ
+uint64_t content_hash(const uint8_t* data, size_t size);
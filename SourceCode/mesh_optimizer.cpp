@@ -0,0 +1,378 @@
+#include "misc.h"
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+// _ƂFIFOLbV̖͋[BLbV~X̂тɎi߁AŌɓcache_sizeȓȂLbVɂ
+class fifo_vertex_cache
+{
+public:
+	fifo_vertex_cache(size_t vertex_count, uint32_t cache_size) : timestamps(vertex_count, 0), cache_size(cache_size), timestamp(cache_size + 1) {}
+
+	// _QƂALbV~XȂ1Ԃ
+	uint32_t touch(uint32_t vertex)
+	{
+		if (timestamp - timestamps[vertex] > cache_size)
+		{
+			timestamps[vertex] = timestamp++;
+			return 1;
+		}
+		return 0;
+	}
+	// LbVɂ
+	void flush()
+	{
+		timestamp += cache_size + 1;
+	}
+
+private:
+	std::vector<uint32_t> timestamps;
+	const uint32_t cache_size;
+	uint32_t timestamp;
+};
+
+vertex_cache_statistics analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size)
+{
+	vertex_cache_statistics statistics;
+	statistics.triangle_count = index_count / 3;
+
+	fifo_vertex_cache cache(vertex_count, cache_size);
+	std::vector<bool> referenced(vertex_count, false);
+	for (size_t i = 0; i < statistics.triangle_count * 3; ++i)
+	{
+		_ASSERT_EXPR(indices[i] < vertex_count, L"Index out of range.");
+		statistics.transformed_vertex_count += cache.touch(indices[i]);
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			statistics.vertex_count++;
+		}
+	}
+	return statistics;
+}
+
+// Forsyth̕]֐BLbV̑傫͎@傫߂Ɍς
+static const uint32_t FORSYTH_CACHE_SIZE{ 32 };
+static const uint32_t FORSYTH_MAX_VALENCE{ 32 }; // ȏ̎c艿͕\g킸ɌvZ
+inline float forsyth_vertex_score(int cache_position, uint32_t remaining_valence)
+{
+	if (remaining_valence == 0)
+	{
+		// gȂ_
+		return -1.0f;
+	}
+	float score{ 0.0f };
+	if (cache_position >= 0)
+	{
+		// O̎Op`3_͂킴ƒ߂ɂāAӂ̎΂Ȃ悤ɂ
+		score = cache_position < 3 ? 0.75f : std::pow(1.0f - (cache_position - 3) * (1.0f / (FORSYTH_CACHE_SIZE - 3)), 1.5f);
+	}
+	// c̎Op`Ȃ_D悵ĕЕt
+	score += 2.0f / std::sqrt(static_cast<float>(remaining_valence));
+	return score;
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+	const size_t triangle_count{ index_count / 3 };
+	if (triangle_count < 2)
+	{
+		return;
+	}
+
+	float score_table[FORSYTH_CACHE_SIZE + 1][FORSYTH_MAX_VALENCE + 1];
+	for (uint32_t cache_position = 0; cache_position <= FORSYTH_CACHE_SIZE; ++cache_position)
+	{
+		for (uint32_t valence = 0; valence <= FORSYTH_MAX_VALENCE; ++valence)
+		{
+			// YFORSYTH_CACHE_SIZE̓LbV̊O
+			score_table[cache_position][valence] = forsyth_vertex_score(cache_position < FORSYTH_CACHE_SIZE ? static_cast<int>(cache_position) : -1, valence);
+		}
+	}
+	auto vertex_score{ [&](int cache_position, uint32_t remaining_valence) {
+		return remaining_valence <= FORSYTH_MAX_VALENCE ?
+			score_table[cache_position < 0 ? FORSYTH_CACHE_SIZE : cache_position][remaining_valence] : forsyth_vertex_score(cache_position, remaining_valence);
+	} };
+
+	// _Ƃ̗אڎOp`(܂o͂ĂȂ̂e͈͂̑Oɋl߂Ă)
+	std::vector<uint32_t> remaining_valences(vertex_count, 0);
+	for (size_t i = 0; i < triangle_count * 3; ++i)
+	{
+		_ASSERT_EXPR(indices[i] < vertex_count, L"Index out of range.");
+		remaining_valences[indices[i]]++;
+	}
+	std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+	for (size_t vertex = 0; vertex < vertex_count; ++vertex)
+	{
+		adjacency_offsets[vertex + 1] = adjacency_offsets[vertex] + remaining_valences[vertex];
+	}
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	{
+		std::vector<uint32_t> fill_counts(vertex_count, 0);
+		for (size_t i = 0; i < triangle_count * 3; ++i)
+		{
+			adjacency[adjacency_offsets[indices[i]] + fill_counts[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	std::vector<int> cache_positions(vertex_count, -1);
+	std::vector<float> vertex_scores(vertex_count);
+	for (size_t vertex = 0; vertex < vertex_count; ++vertex)
+	{
+		vertex_scores[vertex] = vertex_score(-1, remaining_valences[vertex]);
+	}
+	std::vector<float> triangle_scores(triangle_count);
+	for (size_t triangle = 0; triangle < triangle_count; ++triangle)
+	{
+		triangle_scores[triangle] = vertex_scores[indices[triangle * 3]] + vertex_scores[indices[triangle * 3 + 1]] + vertex_scores[indices[triangle * 3 + 2]];
+	}
+	std::vector<bool> emitted(triangle_count, false);
+
+	const uint32_t none{ UINT32_MAX };
+	uint32_t best_triangle{ static_cast<uint32_t>(std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin()) };
+	size_t cursor{ 0 }; // LbV₪ȂꍇɁAo͂̎Op`擪Tʒu
+
+	std::vector<uint32_t> cache, next_cache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	next_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	std::vector<uint32_t> output(triangle_count * 3);
+	for (size_t output_triangle = 0; output_triangle < triangle_count; ++output_triangle)
+	{
+		if (best_triangle == none)
+		{
+			while (emitted[cursor])
+			{
+				++cursor;
+			}
+			best_triangle = static_cast<uint32_t>(cursor);
+		}
+
+		const uint32_t* triangle_vertices{ indices + best_triangle * 3LL };
+		emitted[best_triangle] = true;
+		next_cache.clear();
+		for (size_t corner = 0; corner < 3; ++corner)
+		{
+			const uint32_t vertex{ triangle_vertices[corner] };
+			output[output_triangle * 3 + corner] = vertex;
+
+			// o͂Op`אڃXǧ㔼ֈڂ
+			uint32_t* first{ adjacency.data() + adjacency_offsets[vertex] };
+			uint32_t* last{ first + remaining_valences[vertex] - 1 };
+			std::iter_swap(std::find(first, last + 1, best_triangle), last);
+			remaining_valences[vertex]--;
+
+			if (std::find(next_cache.begin(), next_cache.end(), vertex) == next_cache.end())
+			{
+				next_cache.push_back(vertex);
+			}
+		}
+		for (uint32_t vertex : cache)
+		{
+			if (std::find(next_cache.begin(), next_cache.end(), vertex) == next_cache.end())
+			{
+				next_cache.push_back(vertex);
+			}
+		}
+
+		// LbV̈ʒuς_(oꂽ_܂)̕]XVAאڎOp`ɍ`
+		for (size_t i = 0; i < next_cache.size(); ++i)
+		{
+			const uint32_t vertex{ next_cache[i] };
+			cache_positions[vertex] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+			const float score{ vertex_score(cache_positions[vertex], remaining_valences[vertex]) };
+			const float delta{ score - vertex_scores[vertex] };
+			vertex_scores[vertex] = score;
+			for (uint32_t k = 0; k < remaining_valences[vertex]; ++k)
+			{
+				triangle_scores[adjacency[adjacency_offsets[vertex] + k]] += delta;
+			}
+		}
+
+		// ̎Op`̓LbV̒_̗אڎOp`I
+		best_triangle = none;
+		float best_score{ -FLT_MAX };
+		const size_t cache_size{ std::min<size_t>(next_cache.size(), FORSYTH_CACHE_SIZE) };
+		for (size_t i = 0; i < cache_size; ++i)
+		{
+			const uint32_t vertex{ next_cache[i] };
+			for (uint32_t k = 0; k < remaining_valences[vertex]; ++k)
+			{
+				const uint32_t triangle{ adjacency[adjacency_offsets[vertex] + k] };
+				if (triangle_scores[triangle] > best_score)
+				{
+					best_score = triangle_scores[triangle];
+					best_triangle = triangle;
+				}
+			}
+		}
+
+		next_cache.resize(cache_size);
+		std::swap(cache, next_cache);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count, float threshold)
+{
+	const size_t triangle_count{ index_count / 3 };
+	if (triangle_count < 2)
+	{
+		return;
+	}
+	const uint32_t cache_size{ 16 };
+
+	// 3_ƂLbV~XɂȂOp`ŃLbV̗ꂪr؂̂ŁANX^̋Eɂ
+	std::vector<uint32_t> hard_boundaries;
+	{
+		fifo_vertex_cache cache(vertex_count, cache_size);
+		for (size_t triangle = 0; triangle < triangle_count; ++triangle)
+		{
+			const uint32_t misses{ cache.touch(indices[triangle * 3]) + cache.touch(indices[triangle * 3 + 1]) + cache.touch(indices[triangle * 3 + 2]) };
+			if (triangle == 0 || misses == 3)
+			{
+				hard_boundaries.push_back(static_cast<uint32_t>(triangle));
+			}
+		}
+		hard_boundaries.push_back(static_cast<uint32_t>(triangle_count));
+	}
+
+	// eNX^ɁALbVɂĂACMRthreshold{ȓɎ܂ʒuōׂ
+	std::vector<uint32_t> boundaries;
+	{
+		fifo_vertex_cache cache(vertex_count, cache_size);
+		auto misses_of{ [&](size_t triangle) {
+			return cache.touch(indices[triangle * 3]) + cache.touch(indices[triangle * 3 + 1]) + cache.touch(indices[triangle * 3 + 2]);
+		} };
+		for (size_t cluster = 0; cluster + 1 < hard_boundaries.size(); ++cluster)
+		{
+			const uint32_t first{ hard_boundaries[cluster] };
+			const uint32_t last{ hard_boundaries[cluster + 1] };
+
+			cache.flush();
+			uint32_t cluster_misses{ 0 };
+			for (uint32_t triangle = first; triangle < last; ++triangle)
+			{
+				cluster_misses += misses_of(triangle);
+			}
+			const float cluster_threshold{ threshold * cluster_misses / (last - first) };
+
+			boundaries.push_back(first);
+			cache.flush();
+			uint32_t start{ first };
+			uint32_t misses{ 0 };
+			for (uint32_t triangle = first; triangle + 1 < last; ++triangle)
+			{
+				misses += misses_of(triangle);
+				if (misses <= cluster_threshold * (triangle + 1 - start))
+				{
+					boundaries.push_back(triangle + 1);
+					start = triangle + 1;
+					misses = 0;
+					cache.flush();
+				}
+			}
+		}
+		boundaries.push_back(static_cast<uint32_t>(triangle_count));
+	}
+	const size_t cluster_count{ boundaries.size() - 1 };
+	if (cluster_count < 2)
+	{
+		return;
+	}
+
+	auto position{ [&](uint32_t vertex) {
+		return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + position_stride * vertex);
+	} };
+
+	// bVŜ̏dS
+	float mesh_centroid[3]{};
+	for (size_t i = 0; i < triangle_count * 3; ++i)
+	{
+		const float* p{ position(indices[i]) };
+		mesh_centroid[0] += p[0];
+		mesh_centroid[1] += p[1];
+		mesh_centroid[2] += p[2];
+	}
+	for (float& c : mesh_centroid)
+	{
+		c /= triangle_count * 3;
+	}
+
+	// NX^̖ʐςŏdݕt@ƏdSAOĂx߂
+	std::vector<float> sort_keys(cluster_count);
+	for (size_t cluster = 0; cluster < cluster_count; ++cluster)
+	{
+		float centroid[3]{};
+		float normal[3]{};
+		float area{ 0.0f };
+		for (uint32_t triangle = boundaries[cluster]; triangle < boundaries[cluster + 1]; ++triangle)
+		{
+			const float* a{ position(indices[triangle * 3LL]) };
+			const float* b{ position(indices[triangle * 3LL + 1]) };
+			const float* c{ position(indices[triangle * 3LL + 2]) };
+			const float ab[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			const float ac[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			// Oς͖̒ʐς2{
+			const float n[3]{ ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+			const float w{ std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				centroid[axis] += (a[axis] + b[axis] + c[axis]) * (w / 3.0f);
+				normal[axis] += n[axis];
+			}
+			area += w;
+		}
+		const float inverse_area{ area > 0.0f ? 1.0f / area : 0.0f };
+		const float normal_length{ std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]) };
+		const float inverse_normal_length{ normal_length > 0.0f ? 1.0f / normal_length : 0.0f };
+		float key{ 0.0f };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			key += (centroid[axis] * inverse_area - mesh_centroid[axis]) * normal[axis] * inverse_normal_length;
+		}
+		sort_keys[cluster] = key;
+	}
+
+	// ONX^قǎO̖ʂɂȂ₷̂Őɕ`
+	std::vector<uint32_t> cluster_order(cluster_count);
+	for (uint32_t cluster = 0; cluster < cluster_count; ++cluster)
+	{
+		cluster_order[cluster] = cluster;
+	}
+	std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(triangle_count * 3);
+	for (uint32_t cluster : cluster_order)
+	{
+		output.insert(output.end(), indices + boundaries[cluster] * 3LL, indices + boundaries[cluster + 1] * 3LL);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+std::vector<uint32_t> optimize_vertex_fetch(uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+	const uint32_t unassigned{ UINT32_MAX };
+	std::vector<uint32_t> remap(vertex_count, unassigned);
+	uint32_t next_vertex{ 0 };
+	for (size_t i = 0; i < index_count; ++i)
+	{
+		_ASSERT_EXPR(indices[i] < vertex_count, L"Index out of range.");
+		uint32_t& new_vertex{ remap[indices[i]] };
+		if (new_vertex == unassigned)
+		{
+			new_vertex = next_vertex++;
+		}
+		indices[i] = new_vertex;
+	}
+	for (uint32_t& new_vertex : remap)
+	{
+		if (new_vertex == unassigned)
+		{
+			new_vertex = next_vertex++;
+		}
+	}
+	return remap;
+}
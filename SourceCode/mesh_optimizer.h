@@ -0,0 +1,45 @@
+#pragma once
+
+// UNIT.99
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Ăݎ̃CfbNX/_̕בւBCfbNX̒l(_ԍ)A_z񂻂̂̂ɂ͐GȂB
+// TuZbgƂɌĂׂ΁A}eAƂ̃CfbNX͈͂͘A܂ܕۂB
+
+// _LbV̌
+// ACMR(Average Cache Miss Ratio):Op`̒_VF[_[s񐔁B0.53͈̔͂ŁAقǗǂ
+// ATVR(Average Transformed Vertex Ratio):_̎s񐔁B1z
+struct vertex_cache_statistics
+{
+	uint64_t triangle_count{ 0 };
+	uint64_t vertex_count{ 0 }; // CfbNXQƂĂ钸_̐
+	uint64_t transformed_vertex_count{ 0 }; // LbV~X̉
+
+	float acmr() const { return triangle_count > 0 ? static_cast<float>(transformed_vertex_count) / triangle_count : 0.0f; }
+	float atvr() const { return vertex_count > 0 ? static_cast<float>(transformed_vertex_count) / vertex_count : 0.0f; }
+
+	vertex_cache_statistics& operator+=(const vertex_cache_statistics& rhs)
+	{
+		triangle_count += rhs.triangle_count;
+		vertex_count += rhs.vertex_count;
+		transformed_vertex_count += rhs.transformed_vertex_count;
+		return *this;
+	}
+};
+
+// w肵傫FIFOLbV͋[Č߂
+vertex_cache_statistics analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count, uint32_t cache_size = 16);
+
+// Forsyth̐`ԃASYŎOp`בւA_LbṼqbgグ
+// (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006)
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count);
+
+// LbV̌threshold{܂ňĂ悢͈͂ŎOp`NX^ɕAONX^`悤ɕבւB
+// optimize_vertex_cachěɌĂ(Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007)
+void optimize_overdraw(uint32_t* indices, size_t index_count, const float* positions, size_t position_stride, size_t vertex_count, float threshold = 1.05f);
+
+// CfbNX̏oɒ_ԍU蒼ACfbNXB
+// ߂l͋ԍVԍւ̑Ή\ŁAQƂĂȂ_͖Ɍ̏ŕԁB
+std::vector<uint32_t> optimize_vertex_fetch(uint32_t* indices, size_t index_count, size_t vertex_count);
@@ -9,7 +9,7 @@ using namespace DirectX;
 
 #include <algorithm>
 
-boss::boss(const char* name, ID3D11Device* device) : actor(name)
+boss::boss(const char* name, ID3D11Device* device) : animated_actor(name)
 {
 	_state = state::idle;
 
@@ -23,6 +23,11 @@ boss::boss(const char* name, ID3D11Device* device) : actor(name)
 	_health_point = _max_health_point;
 
 	model = geometric_substance::_emplace(device, ".\\resources\\Slime\\Slime.fbx");
+	// UNIT.99 ił͖[2i̍(wA̐Ȃ)]Ȃ
+	model->mask_lod_bones([](const skeleton::bone&, size_t height) { return height >= 2; });
+	_right_paw_joint = model->resolve_joint("Slime_1", "Spine01");
+	_core_joint = model->resolve_joint("Slime_1", "Spine01");
+	build_animation_graph({ animation_clip::idle, animation_clip::run });
 	_audios[0] = audio::_emplace(L".\\resources\\monster.wav");
 	_audios[1] = audio::_emplace(L".\\resources\\monster-growl.wav");
 
@@ -160,7 +165,7 @@ void boss::render(ID3D11DeviceContext* immediate_context, ID3D11PixelShader* rep
 				pipeline_state.pixel_shader = replacement_pixel_shader;
 			}
 			return 0;
-		});
+		}, &_skinning_palette);
 }
 
 void boss::animation_transition(float delta_time)
@@ -187,7 +192,7 @@ void boss::animation_transition(float delta_time)
 		break;
 	}
 
-	if (animation_sequencer.tictac(model->animation_clips, delta_time))
+	if (animation_sequencer.tictac(model->compressed_animation_clips, delta_time))
 	{
 		switch (animation_sequencer.clip())
 		{
@@ -222,27 +227,29 @@ void boss::animation_transition(float delta_time)
 
 void boss::collide_with(const collision_mesh* collision_mesh, DirectX::XMFLOAT4X4 transform)
 {
-	XMFLOAT4 intersection;
-	std::string mesh;
-	std::string material;
-
 	float raycast_lift_up = 10.0f;
-	if (collision_mesh->raycast({ _position.x, _position.y + raycast_lift_up, _position.z, 1 }, { 0, -1, 0, 0 }, transform, intersection, mesh, material))
+	::collision_mesh::raycast_hit ground;
+	if (collision_mesh->raycast({ _position.x, _position.y + raycast_lift_up, _position.z, 1 }, { 0, -1, 0, 0 }, transform, ground))
 	{
-		if (_position.y < intersection.y)
+		if (_position.y < ground.closest_point.y)
 		{
-			_position.x = intersection.x;
-			_position.y = intersection.y;
-			_position.z = intersection.z;
+			_position.x = ground.closest_point.x;
+			_position.y = ground.closest_point.y;
+			_position.z = ground.closest_point.z;
 			_position.w = 1;
 			_velocity.y = 0;
 		}
 	}
 }
 
-buddy::buddy(const char* name, ID3D11Device* device, DirectX::XMFLOAT4 initial_position) : actor(name)
+buddy::buddy(const char* name, ID3D11Device* device, DirectX::XMFLOAT4 initial_position) : animated_actor(name)
 {
 	model = geometric_substance::_emplace(device, ".\\resources\\latha.fbx");
+	// UNIT.99 ił͖[2i̍(wA̐Ȃ)]Ȃ
+	model->mask_lod_bones([](const skeleton::bone&, size_t height) { return height >= 2; });
+	// UNIT.99 V[PT[ƓANbv͐؂ւuԂɈڂ
+	_cross_fade_duration = 0.0f;
+	build_animation_graph({ animation_clip::idle, animation_clip::run, animation_clip::attack });
 	_position = initial_position;
 	_scale = { 1.5f, 1.5f, 1.5f, 1.0f };
 	_state = state::idle;
@@ -256,10 +263,38 @@ buddy::buddy(const char* name, ID3D11Device* device, DirectX::XMFLOAT4 initial_p
 		}
 		});
 }
+void buddy::collide_with(const std::vector<std::shared_ptr<buddy>>& buddies, const collision_mesh* collision_mesh, DirectX::XMFLOAT4X4 transform)
+{
+	const float raycast_lift_up = 1.75f;
+
+	::collision_mesh::ray_batch rays;
+	rays.resize(buddies.size());
+	for (size_t buddy_index = 0; buddy_index < buddies.size(); ++buddy_index)
+	{
+		const XMFLOAT4& position{ buddies.at(buddy_index)->_position };
+		rays.set(buddy_index, { position.x, position.y + raycast_lift_up, position.z, 1 }, { 0, -1, 0, 0 });
+	}
+
+	std::vector<::collision_mesh::raycast_hit> hits;
+	collision_mesh->raycast(rays, transform, hits);
+
+	for (size_t buddy_index = 0; buddy_index < buddies.size(); ++buddy_index)
+	{
+		const ::collision_mesh::raycast_hit& hit{ hits.at(buddy_index) };
+		XMFLOAT4& position{ buddies.at(buddy_index)->_position };
+		if (hit.mesh_index >= 0 && position.y < hit.closest_point.y)
+		{
+			position.x = hit.closest_point.x;
+			position.y = hit.closest_point.y;
+			position.z = hit.closest_point.z;
+			position.w = 1;
+		}
+	}
+}
 void buddy::update(float delta_time)
 {
 	_compose_transform();
-	animation_transition(delta_time);
+	// Aj[VanimateōXV
 }
 void buddy::render(ID3D11DeviceContext* immediate_context, ID3D11PixelShader* replacement_pixel_shader)
 {
@@ -270,7 +305,7 @@ void buddy::render(ID3D11DeviceContext* immediate_context, ID3D11PixelShader* re
 				pipeline_state.pixel_shader = replacement_pixel_shader;
 			}
 			return 0;
-		});
+		}, &_skinning_palette);
 }
 
 void buddy::animation_transition(float delta_time)
@@ -292,7 +327,7 @@ void buddy::animation_transition(float delta_time)
 		break;
 	}
 
-	if (animation_sequencer.tictac(model->animation_clips, delta_time))
+	if (animation_sequencer.tictac(model->compressed_animation_clips, delta_time))
 	{
 		switch (animation_sequencer.clip())
 		{
@@ -5,24 +5,23 @@
 #include <memory>
 #include <directxmath.h>
 
-#include "actor.h"
-#include "geometric_substance.h"
+#include "animated_actor.h"
 #include "collision_mesh.h"
 #include "audio.h"
 
-class boss : public actor
+class boss : public animated_actor
 {
 public:
 	boss(const char* name, ID3D11Device* device);
 	~boss() = default;
 	void update(float delta_time);
 	void render(ID3D11DeviceContext* immediate_context, ID3D11PixelShader* replacement_pixel_shader = NULL);
-	void cast_shadow(ID3D11DeviceContext* immediate_context)
+	void cast_shadow(ID3D11DeviceContext* immediate_context, UINT instance_count = 4)
 	{
-		model->cast_shadow(immediate_context, transform(), keyframe());
+		model->cast_shadow(immediate_context, transform(), keyframe(), nullptr, instance_count, &_skinning_palette);
 	}
 
-	void animation_transition(float elapsed_time);
+	void animation_transition(float elapsed_time) override;
 	void audio_transition(float delta_time);
 	void collide_with(const collision_mesh* collision_mesh, DirectX::XMFLOAT4X4 transform);
 
@@ -31,27 +30,21 @@ public:
 	enum class animation_clip { idle, run_b, run, run_e, attack, damaged, death };
 	animation_sequencer<animation_clip> animation_sequencer = { animation_clip::idle };
 
-	const animation::keyframe* keyframe() const
-	{
-		return animation_sequencer.keyframe(model->animation_clips);
-	}
 	const DirectX::XMFLOAT4& forward() const { return _forward; }
 	const DirectX::XMFLOAT4& velocity() const { return _velocity; };
 
-	DirectX::XMFLOAT4 right_paw_joint() const
+	DirectX::XMFLOAT4 right_paw_joint()
 	{
-		return model->joint("Slime_1", "Spine01", transform(), keyframe());
+		return model->joint(_right_paw_joint, transform(), posed_keyframe());
 	}
-	DirectX::XMFLOAT4 core_joint() const
+	DirectX::XMFLOAT4 core_joint()
 	{
-		return model->joint("Slime_1", "Spine01", transform(), keyframe());
+		return model->joint(_core_joint, transform(), posed_keyframe());
 	}
 	float health_point() const { return _health_point; }
 	float health_percentage() const { return _health_point / _max_health_point; }
 
 private:
-	std::shared_ptr<geometric_substance> model;
-
 	DirectX::XMFLOAT4 _forward = { 0, 0, 1, 0 };
 	DirectX::XMFLOAT4 _velocity = { 0, 0, 0, 0 };
 
@@ -72,31 +65,33 @@ private:
 	const DirectX::XMFLOAT4 spawn_position = { -15.0f, 0.88f + 0.5f, 0.0f, 1.0f };
 
 	std::shared_ptr<audio> _audios[8];
+
+	// UNIT.99 RXgN^ňxO狁߂
+	geometric_substance::joint_handle _right_paw_joint;
+	geometric_substance::joint_handle _core_joint;
+	// UNIT.99 animation_clip̒l̂܂܃Xe[g̈ʒu
+	size_t animation_state() const override { return static_cast<size_t>(animation_sequencer.clip()); }
 };
 
-class buddy : public actor
+class buddy : public animated_actor
 {
-	std::shared_ptr<geometric_substance> model;
-
 public:
 	buddy(const char* name, ID3D11Device* device, DirectX::XMFLOAT4 initial_position);
 	~buddy() = default;
 	void update(float delta_time);
+	// Sbuddy̐^ւ̌܂Ƃ߂Ĕ肵Anʂɐڒn
+	static void collide_with(const std::vector<std::shared_ptr<buddy>>& buddies, const collision_mesh* collision_mesh, DirectX::XMFLOAT4X4 transform);
 	void render(ID3D11DeviceContext* immediate_context, ID3D11PixelShader* replacement_pixel_shader = NULL);
-	void cast_shadow(ID3D11DeviceContext* immediate_context)
+	void cast_shadow(ID3D11DeviceContext* immediate_context, UINT instance_count = 4)
 	{
-		model->cast_shadow(immediate_context, transform(), keyframe());
+		model->cast_shadow(immediate_context, transform(), keyframe(), nullptr, instance_count, &_skinning_palette);
 	}
-	void animation_transition(float elapsed_time);
+	void animation_transition(float elapsed_time) override;
 
 	enum class state { idle, run, run_stop, attack };
 	enum class state state() const { return _state; }
 	enum animation_clip { idle, run_b, run, run_e, attack };
 	animation_sequencer<animation_clip> animation_sequencer = { animation_clip::idle };
-	const animation::keyframe* keyframe() const
-	{
-		return animation_sequencer.keyframe(model->animation_clips);
-	}
 
 	bool detected() const { return _detected; }
 
@@ -104,4 +99,6 @@ private:
 	bool _detected = false;
 	enum class state _state = state::idle;
 
+	// UNIT.99 animation_clip̒l̂܂܃Xe[g̈ʒu
+	size_t animation_state() const override { return static_cast<size_t>(animation_sequencer.clip()); }
 };
\ No newline at end of file
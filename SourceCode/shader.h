@@ -133,6 +133,24 @@ public:
 		}
 		return vertex_shader;
 	}
+	// _VF[_[ʂ̒_`Ŏgꍇ̓̓CAEgBlayout_nameŋʂăLbV
+	static HRESULT _emplace_input_layout(ID3D11Device* device, const char* name, const char* layout_name, ID3D11InputLayout** input_layout, D3D11_INPUT_ELEMENT_DESC* input_element_desc, UINT num_elements)
+	{
+		const std::string key{ std::string(name) + ':' + layout_name };
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_input_layouts.find(key) != _input_layouts.end())
+		{
+			*input_layout = _input_layouts.at(key).Get();
+			(*input_layout)->AddRef();
+			return S_OK;
+		}
+
+		blob cso(name);
+		HRESULT hr = device->CreateInputLayout(input_element_desc, num_elements, cso.data.get(), cso.size, input_layout);
+		_ASSERT_EXPR(SUCCEEDED(hr), hr_trace(hr));
+		_input_layouts.emplace(std::make_pair(key, *input_layout));
+		return hr;
+	}
 	static HRESULT _auto_generate_input_layout(ID3D11Device* device, const char* name, ID3D11InputLayout** input_layout, D3D11_INPUT_ELEMENT_DESC* input_element_desc, size_t num_elements)
 	{
 		if (_input_layouts.find(name) != _input_layouts.end())
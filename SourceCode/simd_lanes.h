@@ -0,0 +1,54 @@
+#pragma once
+
+// UNIT.99
+// SoA`̃f[^4(SSE)܂8(AVX)J[lpɁASIMDƂ̖߂̈ႢzB
+// J[ltemplate<class lanes>ŏAsupports_avx()̌ʂłǂ炩̎̂I
+#include <intrin.h>
+#include <immintrin.h>
+
+struct sse_lanes
+{
+	using type = __m128;
+	static const int width{ 4 };
+	static type load(const float* p) { return _mm_loadu_ps(p); }
+	static void store(float* p, type v) { _mm_storeu_ps(p, v); }
+	static type set1(float s) { return _mm_set1_ps(s); }
+	static type add(type a, type b) { return _mm_add_ps(a, b); }
+	static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+	static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+	static type div(type a, type b) { return _mm_div_ps(a, b); }
+	static type logical_and(type a, type b) { return _mm_and_ps(a, b); }
+	static type logical_or(type a, type b) { return _mm_or_ps(a, b); }
+	static type logical_xor(type a, type b) { return _mm_xor_ps(a, b); }
+	static type less(type a, type b) { return _mm_cmplt_ps(a, b); }
+	static type not_less(type a, type b) { return _mm_cmpnlt_ps(a, b); } // NaN̏ꍇ^
+	static int movemask(type v) { return _mm_movemask_ps(v); }
+};
+struct avx_lanes
+{
+	using type = __m256;
+	static const int width{ 8 };
+	static type load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, type v) { _mm256_storeu_ps(p, v); }
+	static type set1(float s) { return _mm256_set1_ps(s); }
+	static type add(type a, type b) { return _mm256_add_ps(a, b); }
+	static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+	static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+	static type div(type a, type b) { return _mm256_div_ps(a, b); }
+	static type logical_and(type a, type b) { return _mm256_and_ps(a, b); }
+	static type logical_or(type a, type b) { return _mm256_or_ps(a, b); }
+	static type logical_xor(type a, type b) { return _mm256_xor_ps(a, b); }
+	static type less(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static type not_less(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_NLT_UQ); } // NaN̏ꍇ^
+	static int movemask(type v) { return _mm256_movemask_ps(v); }
+};
+
+inline bool supports_avx()
+{
+	int cpu_info[4]{};
+	__cpuid(cpu_info, 1);
+	const bool osxsave{ (cpu_info[2] & (1 << 27)) != 0 };
+	const bool avx{ (cpu_info[2] & (1 << 28)) != 0 };
+	// OSYMMWX^ޔE邩ǂmF
+	return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+}
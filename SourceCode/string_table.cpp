@@ -0,0 +1,50 @@
+#include "string_table.h"
+
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+
+#include "misc.h"
+
+namespace
+{
+	struct table
+	{
+		std::mutex mutex;
+		std::unordered_map<std::string, int32_t> ids;
+		std::deque<std::string> names; // ɒǉĂ̗vfւ̎QƂ͖ɂȂȂ
+	};
+	table& instance()
+	{
+		static table table;
+		return table;
+	}
+}
+
+int32_t string_table::intern(const std::string& string)
+{
+	table& table{ instance() };
+	std::lock_guard<std::mutex> lock(table.mutex);
+	const auto result{ table.ids.try_emplace(string, static_cast<int32_t>(table.names.size())) };
+	if (result.second)
+	{
+		table.names.push_back(string);
+	}
+	return result.first->second;
+}
+
+int32_t string_table::find(const std::string& string)
+{
+	table& table{ instance() };
+	std::lock_guard<std::mutex> lock(table.mutex);
+	const auto found{ table.ids.find(string) };
+	return found == table.ids.end() ? INVALID_ID : found->second;
+}
+
+const std::string& string_table::name(int32_t id)
+{
+	table& table{ instance() };
+	std::lock_guard<std::mutex> lock(table.mutex);
+	_ASSERT_EXPR(id >= 0 && static_cast<size_t>(id) < table.names.size(), L"Invalid string id");
+	return table.names.at(id);
+}
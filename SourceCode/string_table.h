@@ -0,0 +1,17 @@
+#pragma once
+
+// UNIT.99
+#include <string>
+#include <cstdint>
+
+// vZXňӂȐIDɒu(C^[)B
+// ɂ͏ɓIDԂ̂ŁAt[̔r͐̔rōςށBID͎sƂɕς蓾邽ߕۑĂ͂ȂȂB
+namespace string_table
+{
+	const int32_t INVALID_ID{ -1 };
+
+	int32_t intern(const std::string& string);
+	// o^ĂȂINVALID_IDԂ
+	int32_t find(const std::string& string);
+	const std::string& name(int32_t id);
+}